@@ -0,0 +1,219 @@
+//
+// Batch mode: independent simulations of many traces on a fixed pool of worker threads
+//
+#include <dirent.h> // Include directory listing functions
+#include <sys/stat.h> // Include file status functions
+#include <time.h> // Include clock_gettime
+#include "batch.h" // Include the batch header file
+
+// Define the BatchPool structure (state shared by the workers of one batch)
+typedef struct BatchPool {
+    const SchedulerArgs *args; // Configuration every simulation starts from
+    const BatchInputs *inputs; // Traces to simulate
+    BatchResult *results; // One result per trace
+    int next; // Index of the next unclaimed trace (claimed atomically)
+    int failed; // Number of failed runs (updated atomically)
+} BatchPool;
+
+// Read the monotonic clock in seconds
+static double wall_now(void) {
+    struct timespec now; // Current real time
+    clock_gettime(CLOCK_MONOTONIC, &now); // Read the monotonic clock
+    return now.tv_sec + now.tv_nsec / 1e9; // Convert to seconds
+}
+
+// Append a copy of a path to the inputs
+static int add_input(BatchInputs *inputs, const char *path) {
+    if ((inputs->count & (inputs->count - 1)) == 0) { // If the array is full (capacity doubles at powers of two)
+        char **files = realloc(inputs->files, (inputs->count ? inputs->count * 2 : 1) * sizeof(char *)); // Grow the array
+        if (!files) { // If the allocation failed
+            perror("Failed to allocate memory for batch inputs"); // Print an error message
+            return -1; // Report the failure
+        }
+        inputs->files = files; // Keep the grown array
+    }
+    if (!(inputs->files[inputs->count] = strdup(path))) { // Copy the path
+        perror("Failed to allocate memory for batch inputs"); // Print an error message
+        return -1; // Report the failure
+    }
+    inputs->count++; // Count the path
+    return 0; // Return success
+}
+
+// Order paths by name
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b); // Plain byte order keeps runs reproducible
+}
+
+// List the regular files of a directory in name order (hidden files are skipped)
+int batch_collect_dir(BatchInputs *inputs, const char *dir) {
+    DIR *handle = opendir(dir); // Open the directory
+    if (!handle) { // If the directory cannot be opened
+        perror("Failed to open input directory"); // Print an error message
+        return -1; // Report the failure
+    }
+    int first = inputs->count; // Only sort the paths added here
+    struct dirent *entry; // Current directory entry
+    while ((entry = readdir(handle)) != NULL) { // Read each entry
+        if (entry->d_name[0] == '.') { // Skip ".", ".." and hidden files
+            continue;
+        }
+        char path[4096]; // Path of the entry
+        struct stat info; // Status of the entry
+        if (snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) >= (int)sizeof(path) || stat(path, &info) != 0 || !S_ISREG(info.st_mode)) { // Skip directories and anything unreadable
+            continue;
+        }
+        if (add_input(inputs, path) != 0) { // Add the trace
+            closedir(handle); // Close the directory
+            return -1; // Report the failure
+        }
+    }
+    closedir(handle); // Close the directory
+    qsort(inputs->files + first, inputs->count - first, sizeof(char *), compare_paths); // Report results in name order
+    return 0; // Return success
+}
+
+// Read trace paths from a list file (one per line; blank lines and # comments are skipped)
+int batch_collect_list(BatchInputs *inputs, const char *list_file) {
+    FILE *file = fopen(list_file, "r"); // Open the list for reading
+    if (!file) { // If the list cannot be opened
+        perror("Failed to open input list"); // Print an error message
+        return -1; // Report the failure
+    }
+    char line[4096]; // Buffer to store each line of the list
+    while (fgets(line, sizeof(line), file)) { // Read each line of the list
+        char *path = line + strspn(line, " \t"); // Skip leading blanks
+        size_t length = strcspn(path, "\r\n"); // Drop the line ending
+        while (length > 0 && (path[length - 1] == ' ' || path[length - 1] == '\t')) { // Drop trailing blanks
+            length--;
+        }
+        path[length] = '\0'; // Terminate the path
+        if (length == 0 || path[0] == '#') { // Skip blank lines and comments
+            continue;
+        }
+        if (add_input(inputs, path) != 0) { // Add the trace
+            fclose(file); // Close the list
+            return -1; // Report the failure
+        }
+    }
+    fclose(file); // Close the list
+    return 0; // Return success
+}
+
+// Release the collected paths
+void batch_inputs_free(BatchInputs *inputs) {
+    for (int i = 0; i < inputs->count; i++) { // Loop through each path
+        free(inputs->files[i]); // Free the path
+    }
+    free(inputs->files); // Free the array
+    inputs->files = NULL; // Leave the inputs empty
+    inputs->count = 0; // No paths left
+}
+
+// Size the pool to the online CPUs
+int batch_default_workers(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN); // Online CPUs
+    return cpus > 0 ? (int)cpus : 1; // Fall back to one worker when unknown
+}
+
+// Simulate one trace in a context of its own and summarize it
+static void run_one(const SchedulerArgs *args, const char *input_file, BatchResult *result) {
+    memset(result, 0, sizeof(*result)); // Start from an empty result
+    result->input_file = input_file; // Name the run
+    result->status = -1; // Failed until the run completes
+    SchedulerContext *ctx = malloc(sizeof(SchedulerContext)); // The simulation (too large for a worker stack)
+    if (!ctx) { // If the allocation failed
+        perror("Failed to allocate memory for simulation"); // Print an error message
+        return;
+    }
+    SchedulerArgs run_args = *args; // Per-run copy of the configuration
+    run_args.input_file = (char *)input_file; // Replay this trace
+    double start = wall_now(); // Real time the run starts
+    scheduler_init(ctx, &run_args); // Create empty queues, clock and metrics
+    if (scheduler_run(ctx) == 0) { // Run the simulation to completion
+        result->status = 0; // The run succeeded
+    } else {
+        fprintf(stderr, "Batch run of %s failed\n", input_file); // Name the trace the error above belongs to
+    }
+    result->wall_seconds = wall_now() - start; // Real time the run took
+    result->process_count = ctx->process_count; // Copy the completion metrics
+    result->measured_completions = ctx->measured_completions;
+    result->total_time = ctx->total_time;
+    result->busy_time = ctx->busy_time;
+    result->total_turnaround_time = ctx->total_turnaround_time;
+    result->total_waiting_time = ctx->total_waiting_time;
+    result->turnaround_hist = ctx->turnaround_hist;
+    scheduler_destroy(ctx); // Release the simulation
+    free(ctx); // Free the context
+}
+
+// Batch worker thread function: claim traces until none are left
+static void *batch_worker_thread(void *arg) {
+    BatchPool *pool = (BatchPool *)arg; // Get the shared pool state from the argument
+    int index; // Index of the claimed trace
+    while ((index = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->inputs->count) { // Claim the next trace
+        run_one(pool->args, pool->inputs->files[index], &pool->results[index]); // Simulate it
+        if (pool->results[index].status != 0) { // If the run failed
+            __atomic_fetch_add(&pool->failed, 1, __ATOMIC_RELAXED); // Count the failure
+        }
+    }
+    return NULL; // Exit the thread
+}
+
+// Run every trace on a pool of worker threads, one isolated simulation at a time per worker
+int batch_run(const SchedulerArgs *args, const BatchInputs *inputs, int workers, BatchResult *results, double *wall_seconds) {
+    BatchPool pool = {args, inputs, results, 0, 0}; // Shared pool state
+    double start = wall_now(); // Real time the batch starts
+    if (workers > inputs->count) { // Never start idle workers
+        workers = inputs->count;
+    }
+    pthread_t *threads = malloc((workers > 0 ? workers : 1) * sizeof(pthread_t)); // Worker threads
+    if (!threads) { // If the allocation failed
+        perror("Failed to allocate memory for batch workers"); // Print an error message
+        *wall_seconds = 0; // Nothing ran
+        return inputs->count; // Every run failed
+    }
+    int started = 0; // Number of workers running
+    while (started < workers && pthread_create(&threads[started], NULL, batch_worker_thread, &pool) == 0) { // Create each worker
+        started++;
+    }
+    if (started == 0) { // If no worker could be created
+        batch_worker_thread(&pool); // Run the batch on the calling thread
+    }
+    for (int i = 0; i < started; i++) { // Loop through each worker
+        pthread_join(threads[i], NULL); // Wait for it to run out of traces
+    }
+    free(threads); // Free the worker threads
+    *wall_seconds = wall_now() - start; // Real time the whole batch took
+    return pool.failed; // Report the number of failed runs
+}
+
+// Print the consolidated results table, one row per trace in input order
+void batch_print_results(const SchedulerArgs *args, const BatchResult *results, int count, int workers, double wall_seconds, FILE *out) {
+    int width = 10; // Width of the trace column
+    for (int i = 0; i < count; i++) { // Loop through each result
+        int length = (int)strlen(results[i].input_file); // Length of the trace path
+        width = length > width ? length : width; // Fit the longest path
+    }
+    const SchedPolicy *policy = args->policy ? args->policy : policy_find(args->algorithm); // Policy every run used
+    fprintf(out, "CPU Scheduling Alg           : %s\n", policy ? policy->name : args->algorithm);
+    fprintf(out, "I/O Scheduling Alg           : %s\n", args->io_algorithm ? args->io_algorithm : "FIFO");
+    fprintf(out, "%-*s %6s %9s %14s %8s %12s %14s %14s %9s\n", width, "Input File", "Status", "Processes",
+            "Total (ms)", "CPU %", "Thru (/ms)", "Avg TAT (ms)", "Avg wait (ms)", "Wall (s)");
+    int failed = 0; // Number of failed runs
+    for (int i = 0; i < count; i++) { // Loop through each result
+        const BatchResult *result = &results[i]; // Current result
+        failed += result->status != 0; // Count the failure
+        if (result->status != 0 || result->process_count == 0 || result->total_time == 0) { // Nothing to average
+            fprintf(out, "%-*s %6s %9d %14.3f %8s %12s %14s %14s %9.3f\n", width, result->input_file, result->status ? "FAILED" : "ok",
+                    result->process_count, SIM_TIME_TO_MS(result->total_time), "-", "-", "-", "-", result->wall_seconds);
+            continue;
+        }
+        fprintf(out, "%-*s %6s %9d %14.3f %8.3f %12.3f %14.3f %14.3f %9.3f\n", width, result->input_file, "ok", result->process_count,
+                SIM_TIME_TO_MS(result->total_time), (double)result->busy_time / result->total_time * 100,
+                result->process_count / SIM_TIME_TO_MS(result->total_time),
+                SIM_TIME_TO_MS(result->total_turnaround_time) / result->process_count,
+                SIM_TIME_TO_MS(result->total_waiting_time) / result->process_count, result->wall_seconds);
+    }
+    fprintf(out, "Batch: %d runs (%d failed) on %d workers in %.3f s\n", count, failed, workers < count ? workers : count, wall_seconds);
+}
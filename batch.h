@@ -0,0 +1,36 @@
+//
+// Batch mode: independent simulations of many traces on a fixed pool of worker threads
+//
+#ifndef BATCH_H // If not defined, define BATCH_H to prevent multiple inclusions
+#define BATCH_H // Define BATCH_H
+
+#include "scheduler.h" // Include the scheduler header file
+
+// Define the BatchResult structure (the summary of one simulation)
+typedef struct BatchResult {
+    const char *input_file; // Trace the simulation replayed
+    int status; // 0 on success, -1 when the run failed
+    int process_count; // Number of processes that finished
+    int measured_completions; // Processes that finished in the interval args->measure_from to args->measure_until
+    sim_time_t total_time; // Total simulated time
+    sim_time_t busy_time; // Time the CPU was busy
+    sim_time_t total_turnaround_time; // Sum of turnaround times
+    sim_time_t total_waiting_time; // Sum of ready-queue waiting times
+    Histogram turnaround_hist; // Distribution of turnaround times
+    double wall_seconds; // Real time the simulation took
+} BatchResult;
+
+// Define the BatchInputs structure (the traces of a batch)
+typedef struct BatchInputs {
+    char **files; // Trace paths, in the order the results are reported
+    int count; // Number of traces
+} BatchInputs;
+
+int batch_collect_dir(BatchInputs *inputs, const char *dir); // Function prototype for listing the regular files of a directory in name order
+int batch_collect_list(BatchInputs *inputs, const char *list_file); // Function prototype for reading trace paths from a list file (one per line, # comments)
+void batch_inputs_free(BatchInputs *inputs); // Function prototype for releasing the collected paths
+int batch_default_workers(void); // Function prototype for sizing the pool to the online CPUs
+int batch_run(const SchedulerArgs *args, const BatchInputs *inputs, int workers, BatchResult *results, double *wall_seconds); // Function prototype for running every trace on a worker pool (returns the number of failed runs)
+void batch_print_results(const SchedulerArgs *args, const BatchResult *results, int count, int workers, double wall_seconds, FILE *out); // Function prototype for printing the consolidated results table
+
+#endif // BATCH_H // End of include guard
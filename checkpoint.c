@@ -0,0 +1,314 @@
+//
+// Binary snapshots of the full simulation state for checkpoint and resume
+//
+#include "checkpoint.h" // Include the checkpoint header file
+#include <stdint.h> // Include fixed-width integer types
+
+// Write one 64-bit field
+static int write_i64(FILE *file, int64_t value) {
+    return fwrite(&value, sizeof(value), 1, file) == 1 ? 0 : -1; // Report short writes
+}
+
+// Read one 64-bit field
+static int read_i64(FILE *file, int64_t *value) {
+    return fread(value, sizeof(*value), 1, file) == 1 ? 0 : -1; // Report short reads
+}
+
+// Write the buckets, sum and count of a histogram
+static int write_histogram(FILE *file, const Histogram *histogram) {
+    int rc = 0; // Accumulated status
+    for (int i = 0; i <= HISTOGRAM_BUCKETS; i++) { // Loop through each bucket, +Inf included
+        rc |= write_i64(file, (int64_t)histogram->buckets[i]);
+    }
+    rc |= write_i64(file, histogram->sum); // Sum of the observations
+    rc |= write_i64(file, (int64_t)histogram->count); // Number of observations
+    return rc; // Return the status
+}
+
+// Read the buckets, sum and count of a histogram
+static int read_histogram(FILE *file, Histogram *histogram) {
+    int64_t value; // Field being read
+    for (int i = 0; i <= HISTOGRAM_BUCKETS; i++) { // Loop through each bucket, +Inf included
+        if (read_i64(file, &value) != 0) { // Read the bucket
+            return -1; // Truncated snapshot
+        }
+        histogram->buckets[i] = (unsigned long long)value;
+    }
+    if (read_i64(file, &histogram->sum) != 0 || read_i64(file, &value) != 0) { // Read the sum and count
+        return -1; // Truncated snapshot
+    }
+    histogram->count = (unsigned long long)value;
+    return 0; // Success
+}
+
+// Write the counters and distributions the exporters report, so they continue across a resume
+static int write_counters(FILE *file, const SchedulerContext *ctx) {
+    int rc = write_i64(file, (int64_t)ctx->dispatches); // PCBs dispatched
+    rc |= write_i64(file, (int64_t)ctx->preemptions); // Expired time slices
+    for (int write = 0; write < 2; write++) { // Loop through each I/O direction
+        rc |= write_i64(file, (int64_t)ctx->io_requests[write]); // Requests admitted
+        rc |= write_i64(file, ctx->io_wait_total[write]); // Sum of their waits
+        rc |= write_i64(file, ctx->io_wait_max[write]); // Longest wait
+    }
+    rc |= write_histogram(file, &ctx->turnaround_hist); // Turnaround distribution
+    rc |= write_histogram(file, &ctx->waiting_hist); // Ready-queue waiting distribution
+    rc |= write_histogram(file, &ctx->io_wait_hist); // I/O queue waiting distribution
+    return rc; // Return the status
+}
+
+// Restore the counters and distributions the exporters report
+static int read_counters(FILE *file, SchedulerContext *ctx) {
+    int64_t fields[8]; // Dispatches, preemptions and the I/O counters
+    for (int i = 0; i < 8; i++) { // Loop through each field
+        if (read_i64(file, &fields[i]) != 0) { // Read the field
+            return -1; // Truncated snapshot
+        }
+    }
+    ctx->dispatches = (unsigned long long)fields[0]; // PCBs dispatched
+    ctx->preemptions = (unsigned long long)fields[1]; // Expired time slices
+    for (int write = 0; write < 2; write++) { // Loop through each I/O direction
+        ctx->io_requests[write] = (unsigned long long)fields[2 + write * 3]; // Requests admitted
+        ctx->io_wait_total[write] = fields[3 + write * 3]; // Sum of their waits
+        ctx->io_wait_max[write] = fields[4 + write * 3]; // Longest wait
+    }
+    if (read_histogram(file, &ctx->turnaround_hist) != 0 || read_histogram(file, &ctx->waiting_hist) != 0 || read_histogram(file, &ctx->io_wait_hist) != 0) { // Read the distributions
+        return -1; // Truncated snapshot
+    }
+    return 0; // Success
+}
+
+// Write one PCB record; due is the completion time of an in-flight I/O burst (0 otherwise)
+static int write_pcb(FILE *file, const PCB *pcb, sim_time_t due) {
+    int rc = 0; // Accumulated status
+    rc |= write_i64(file, pcb->priority); // Process priority
+    rc |= write_i64(file, pcb->burst_count); // Number of bursts
+    rc |= write_i64(file, pcb->current_burst); // Index of the current burst
+    rc |= write_i64(file, pcb->arrival_time); // Arrival time
+    rc |= write_i64(file, pcb->waiting_time); // Accumulated ready-queue wait
+    rc |= write_i64(file, pcb->ready_time); // Time the PCB entered its queue
+    rc |= write_i64(file, due); // Completion time of an in-flight I/O burst
+    rc |= write_i64(file, pcb->id); // Admission order
+    rc |= write_i64(file, pcb->preemptions); // Expired time slices
+    size_t bitmap_size = (pcb->burst_count + 7) / 8; // Bytes in the write bitmap
+    sim_time_t *bursts = malloc(pcb->burst_count * sizeof(sim_time_t)); // Decoded bursts
+    unsigned char *writes = malloc(bitmap_size); // Decoded write bitmap
+    if (bursts == NULL || writes == NULL) { // If memory allocation fails
+        rc = -1; // Report the failure
+    } else {
+        pcb_get_bursts(pcb, bursts, writes); // Decode the bursts
+        if (due == 0) { // In-flight PCBs are restored from due (the compact layout reuses remaining for the wheel tick)
+            bursts[pcb->current_burst] = pcb->remaining; // A preempted burst resumes with the time it has left
+        }
+        if (fwrite(bursts, sizeof(sim_time_t), pcb->burst_count, file) != (size_t)pcb->burst_count ||
+            fwrite(writes, 1, bitmap_size, file) != bitmap_size) { // Bursts and write bitmap
+            rc = -1; // Report short writes
+        }
+    }
+    free(bursts); // Free the decoded bursts
+    free(writes); // Free the decoded bitmap
+    return rc; // Return the status
+}
+
+// Read one PCB record into a newly allocated PCB
+static PCB *read_pcb(FILE *file, sim_time_t *due) {
+    int64_t fields[9]; // Fixed fields of the record
+    for (int i = 0; i < 9; i++) { // Loop through each field
+        if (read_i64(file, &fields[i]) != 0) { // Read the field
+            return NULL; // Truncated snapshot
+        }
+    }
+    if (fields[0] < PCB_PRIORITY_MIN || fields[0] > PCB_PRIORITY_MAX || fields[1] <= 0 || fields[1] > PCB_BURSTS_MAX || fields[2] < 0 || fields[2] >= fields[1]) { // Validate the priority and burst counters
+        return NULL; // Corrupt snapshot
+    }
+    size_t bitmap_size = (fields[1] + 7) / 8; // Bytes in the write bitmap
+    sim_time_t *bursts = malloc(fields[1] * sizeof(sim_time_t)); // Bursts of the record
+    unsigned char *writes = malloc(bitmap_size); // Write bitmap of the record
+    PCB *pcb = NULL; // Restored PCB
+    if (bursts != NULL && writes != NULL &&
+        fread(bursts, sizeof(sim_time_t), fields[1], file) == (size_t)fields[1] &&
+        fread(writes, 1, bitmap_size, file) == bitmap_size) { // Read the bursts and the write bitmap
+        pcb = pcb_alloc(); // Allocate a zeroed PCB
+        if (pcb != NULL && pcb_set_bursts(pcb, bursts, writes, (int)fields[1]) != 0) { // Store the bursts
+            pcb_free(pcb); // Free the PCB
+            pcb = NULL;
+        }
+    }
+    free(bursts); // Free the record's bursts
+    free(writes); // Free the record's bitmap
+    if (pcb == NULL) { // If the record is truncated or memory ran out
+        return NULL; // Report the failure
+    }
+    pcb->priority = (int)fields[0]; // Process priority
+    pcb_seek(pcb, (int)fields[2]); // Make the saved burst current with the time it had left
+    pcb->arrival_time = fields[3]; // Arrival time
+    pcb->waiting_time = fields[4]; // Accumulated ready-queue wait
+    pcb->ready_time = fields[5]; // Time the PCB entered its queue
+    *due = fields[6]; // Completion time of an in-flight I/O burst
+    pcb->id = fields[7]; // Admission order
+    pcb->preemptions = fields[8]; // Expired time slices
+    return pcb; // Return the restored PCB
+}
+
+// Write every PCB of a queue, preceded by their count
+static int write_queue(FILE *file, Queue *queue) {
+    int64_t count = 0; // Number of PCBs in the queue
+    for (PCB *pcb = queue->head; pcb != NULL; pcb = PCB_NEXT(pcb)) { // Count the PCBs
+        count++;
+    }
+    int rc = write_i64(file, count); // Section length
+    for (PCB *pcb = queue->head; pcb != NULL && rc == 0; pcb = PCB_NEXT(pcb)) { // Loop through the queue in order
+        rc = write_pcb(file, pcb, 0); // Write the PCB
+    }
+    return rc; // Return the status
+}
+
+// Write a snapshot of the queues, the I/O wheel, the clocks and the metrics
+int checkpoint_save(SchedulerContext *ctx, const char *path, const CheckpointPosition *position) {
+    char tmp_path[4096]; // Snapshot is written next to the target and renamed into place
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path); // Build the temporary file name
+    FILE *file = fopen(tmp_path, "wb"); // Open the temporary file for writing
+    if (!file) { // If the file cannot be opened
+        perror("Failed to open checkpoint file"); // Print an error message
+        return -1; // Report the failure
+    }
+
+    int rc = fwrite(CHECKPOINT_MAGIC, 4, 1, file) == 1 ? 0 : -1; // Magic bytes
+    rc |= write_i64(file, CHECKPOINT_VERSION); // Format version
+    rc |= write_i64(file, SIM_TIME_PER_US); // Tick resolution the times are stored in
+    rc |= write_i64(file, position->trace_offset); // Trace file offset
+    rc |= write_i64(file, position->read_time); // Trace time
+    rc |= write_i64(file, ctx->cpus[0].cpu_time); // CPU timeline (snapshots cover one CPU)
+    rc |= write_i64(file, ctx->current_time); // Latest simulated time
+    rc |= write_i64(file, ctx->busy_time); // Busy time
+    rc |= write_i64(file, ctx->process_count); // Finished processes
+    rc |= write_i64(file, ctx->total_turnaround_time); // Sum of turnaround times
+    rc |= write_i64(file, ctx->total_waiting_time); // Sum of waiting times
+    rc |= write_i64(file, ctx->active_processes); // Live processes
+    rc |= write_i64(file, ctx->io_wheel.now * ctx->args.io_tick); // Time of the I/O device
+    rc |= write_i64(file, ctx->args.quantum); // RR quantum (policy lines may have changed it)
+    rc |= write_i64(file, ctx->policy_switches); // Policy lines applied so far
+    rc |= write_i64(file, position->results_offset); // Length of the results file
+    char policy[CHECKPOINT_POLICY_NAME] = {0}; // Name of the active policy, NUL-padded
+    strncpy(policy, ctx->policy->name, sizeof(policy) - 1);
+    rc |= fwrite(policy, sizeof(policy), 1, file) == 1 ? 0 : -1;
+    rc |= write_counters(file, ctx); // Counters and histograms section
+    rc |= write_queue(file, &ctx->ready_queue); // Ready queue section
+    rc |= write_queue(file, &ctx->io_queue); // I/O queue section
+
+    rc |= write_i64(file, ctx->io_wheel.count); // In-flight I/O section
+    for (int level = 0; level < TW_LEVELS; level++) { // Loop through each wheel level
+        for (int slot = 0; slot < TW_SLOTS; slot++) { // Loop through each slot
+            for (PCB *pcb = ctx->io_wheel.slots[level][slot].head; pcb != NULL; pcb = PCB_NEXT(pcb)) { // Loop through the slot
+                rc |= write_pcb(file, pcb, pcb->io_done_time * ctx->args.io_tick); // Write the PCB with its completion time
+            }
+        }
+    }
+
+    if (fclose(file) != 0) { // Flush and close the file
+        rc = -1; // Report the failure
+    }
+    if (rc == 0 && rename(tmp_path, path) != 0) { // Atomically replace the previous snapshot
+        rc = -1; // Report the failure
+    }
+    if (rc != 0) { // If anything went wrong
+        fprintf(stderr, "Failed to write checkpoint %s\n", path); // Print an error message
+        remove(tmp_path); // Drop the partial snapshot
+    }
+    return rc; // Return the status
+}
+
+// Restore a section of PCBs into a queue
+static int read_queue(SchedulerContext *ctx, FILE *file, Queue *queue) {
+    int64_t count; // Number of PCBs in the section
+    if (read_i64(file, &count) != 0 || count < 0) { // Read the section length
+        return -1; // Truncated snapshot
+    }
+    for (int64_t i = 0; i < count; i++) { // Loop through each PCB
+        sim_time_t due; // Unused for queued PCBs
+        PCB *pcb = read_pcb(file, &due); // Read the PCB
+        if (pcb == NULL) { // If the record is bad
+            return -1; // Report the failure
+        }
+        if (queue == &ctx->ready_queue) { // If the PCB is ready
+            enqueue_ready(ctx, pcb); // Append in the saved order and let the policy index it
+        } else {
+            enqueue(queue, pcb); // Append in the saved order
+        }
+    }
+    return 0; // Success
+}
+
+// Restore a snapshot into the global state; the trace reader resumes from position
+int checkpoint_load(SchedulerContext *ctx, const char *path, CheckpointPosition *position) {
+    FILE *file = fopen(path, "rb"); // Open the snapshot for reading
+    if (!file) { // If the file cannot be opened
+        perror("Failed to open checkpoint file"); // Print an error message
+        return -1; // Report the failure
+    }
+
+    char magic[4]; // Magic bytes
+    int64_t header[15]; // Fixed header fields
+    char policy[CHECKPOINT_POLICY_NAME]; // Name of the active policy
+    int rc = fread(magic, 4, 1, file) == 1 && memcmp(magic, CHECKPOINT_MAGIC, 4) == 0 ? 0 : -1; // Check the magic bytes
+    for (int i = 0; i < 15 && rc == 0; i++) { // Loop through each header field
+        rc = read_i64(file, &header[i]); // Read the field
+    }
+    if (rc == 0 && fread(policy, sizeof(policy), 1, file) != 1) { // Read the policy name
+        rc = -1; // Truncated snapshot
+    }
+    if (rc == 0 && (header[0] != CHECKPOINT_VERSION || header[1] != SIM_TIME_PER_US)) { // Check version and resolution
+        fprintf(stderr, "Checkpoint %s has an incompatible version or time resolution\n", path); // Print an error message
+        rc = -1; // Report the failure
+    }
+    if (rc == 0) { // If the header is valid
+        policy[sizeof(policy) - 1] = '\0'; // Terminate the name
+        if (strcmp(policy, ctx->policy->name) != 0 && policy_find(policy) == NULL) { // Keep a custom policy of the same name, else look up a built-in
+            fprintf(stderr, "Checkpoint %s uses an unknown policy %s\n", path, policy); // Print an error message
+            rc = -1; // Report the failure
+        } else if (strcmp(policy, ctx->policy->name) != 0) { // If a policy line switched it before the snapshot
+            ctx->policy = policy_find(policy); // Resume under the switched policy (the threads have not started)
+        }
+    }
+    if (rc == 0) { // If the header is valid
+        position->trace_offset = (long)header[2]; // Trace file offset
+        position->read_time = header[3]; // Trace time
+        ctx->cpus[0].cpu_time = header[4]; // CPU timeline (snapshots cover one CPU)
+        ctx->current_time = header[5]; // Latest simulated time
+        ctx->busy_time = ctx->cpus[0].busy_time = header[6]; // Busy time
+        ctx->process_count = (int)header[7]; // Finished processes
+        ctx->total_turnaround_time = header[8]; // Sum of turnaround times
+        ctx->total_waiting_time = header[9]; // Sum of waiting times
+        ctx->active_processes = (int)header[10]; // Live processes
+        tw_init(&ctx->io_wheel, (long)(header[11] / ctx->args.io_tick)); // Restart the wheel at the device time
+        if (header[12] > 0) { // If the snapshot has a quantum
+            ctx->args.quantum = header[12]; // RR quantum in effect when it was taken
+        }
+        ctx->policy_switches = (unsigned long long)header[13]; // Policy lines applied so far
+        position->results_offset = (long)header[14]; // Length of the results file
+        rc = read_counters(file, ctx); // Counters and histograms section
+    }
+    if (rc == 0) { // If the counters were restored
+        rc = read_queue(ctx, file, &ctx->ready_queue); // Ready queue section
+    }
+    if (rc == 0) { // If the ready queue was restored
+        rc = read_queue(ctx, file, &ctx->io_queue); // I/O queue section
+    }
+    int64_t in_flight = 0; // Number of in-flight I/O bursts
+    if (rc == 0 && (read_i64(file, &in_flight) != 0 || in_flight < 0)) { // Read the section length
+        rc = -1; // Truncated snapshot
+    }
+    for (int64_t i = 0; i < in_flight && rc == 0; i++) { // Loop through each in-flight PCB
+        sim_time_t due; // Completion time of the I/O burst
+        PCB *pcb = read_pcb(file, &due); // Read the PCB
+        if (pcb == NULL) { // If the record is bad
+            rc = -1; // Report the failure
+            break;
+        }
+        tw_insert(&ctx->io_wheel, pcb, (long)((due + ctx->args.io_tick - 1) / ctx->args.io_tick)); // Put the burst back on the device
+    }
+    fclose(file); // Close the file
+    if (rc != 0) { // If anything went wrong
+        fprintf(stderr, "Failed to load checkpoint %s\n", path); // Print an error message
+    }
+    return rc; // Return the status
+}
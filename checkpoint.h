@@ -0,0 +1,23 @@
+//
+// Binary snapshots of the full simulation state for checkpoint and resume
+//
+#ifndef CHECKPOINT_H // If not defined, define CHECKPOINT_H to prevent multiple inclusions
+#define CHECKPOINT_H // Define CHECKPOINT_H
+
+#include "scheduler.h" // Include the scheduler header file
+
+#define CHECKPOINT_MAGIC "SCHK" // Magic bytes at the start of every snapshot
+#define CHECKPOINT_VERSION 6 // Snapshot format version (2 adds the write bitmap of every PCB, 3 the active policy and quantum, 4 the id and preemptions of every PCB, 5 the dispatch, preemption and I/O counters and histograms, 6 the length of the results file)
+#define CHECKPOINT_POLICY_NAME 16 // Bytes holding the name of the active policy
+
+// Define the CheckpointPosition structure (where the trace reader stood when the snapshot was taken)
+typedef struct CheckpointPosition {
+    long trace_offset; // Byte offset of the next unread trace line
+    sim_time_t read_time; // Simulated time reached by the trace
+    long results_offset; // Length of the results file, covering the processes finished so far (-1 = no results file)
+} CheckpointPosition;
+
+int checkpoint_save(SchedulerContext *ctx, const char *path, const CheckpointPosition *position); // Function prototype for writing a snapshot (workers must be paused)
+int checkpoint_load(SchedulerContext *ctx, const char *path, CheckpointPosition *position); // Function prototype for restoring a snapshot before the threads start
+
+#endif // CHECKPOINT_H // End of include guard
@@ -0,0 +1,797 @@
+//
+// Virtual-time engine: conservative parallel discrete-event simulation over CPU partitions
+//
+// The CPUs are split into partitions, each with its own ready queue, and the I/O device is one more
+// logical process (LP). LPs only interact through timestamped messages: a partition sends a PCB to the
+// device when it dispatches the run that ends its CPU burst, and the device sends it back when it starts
+// the I/O burst. A message therefore arrives at least one lookahead (the shortest such run or I/O burst)
+// after it is sent, so every LP can simulate the window [start, start + lookahead) on its own. Messages
+// are exchanged at a barrier between windows and merged in (time, sender, sequence) order, which makes
+// the results identical for any number of worker threads.
+//
+#include "des.h" // Include the virtual-time engine header file
+#include "trace.h" // Include the trace parsing header file
+
+#define DES_NEVER INT64_MAX // Time of an event that never happens
+
+// What a CPU does when its current run ends
+enum {
+    DES_CPU_IDLE, // Nothing is running
+    DES_CPU_REQUEUE, // The slice expires: the PCB goes back to the ready queue
+    DES_CPU_FINISH, // The last burst ends: the process finishes
+    DES_CPU_SENT // The CPU burst ends: the PCB was already sent to the I/O device
+};
+
+// Define the DesMessage structure (a PCB handed to another LP at a simulated time)
+typedef struct DesMessage {
+    sim_time_t time; // Simulated time the PCB arrives
+    int source; // Sending LP
+    long long seq; // Send order within the sending LP
+    PCB *pcb; // PCB being handed over (owned by the receiver from now on)
+} DesMessage;
+
+// Define the DesMailbox structure (growable array of messages)
+typedef struct DesMailbox {
+    DesMessage *items; // Messages
+    int count; // Number of messages
+    int capacity; // Allocated length of items
+} DesMailbox;
+
+// Define the DesLp structure (one CPU partition, or the I/O device)
+typedef struct DesLp {
+    int id; // Index of the LP (the device is the last one)
+    SchedulerContext *ctx; // Ready queue, policy state and metrics of a partition; the simulation itself for the device
+    Cpu *cpus; // CPUs of the partition (a slice of the simulation's CPUs; NULL for the device)
+    int cpu_count; // Number of CPUs of the partition
+    int *order; // CPUs of the partition from the fastest to the slowest (idle CPUs are filled in this order)
+    double capacity; // Total speed of the partition's CPUs
+    PCB **running; // PCB on each CPU (NULL once sent to the device)
+    unsigned char *action; // DES_CPU_* taken when the run on each CPU ends (at Cpu.burst_end)
+    PCB **arrivals; // Processes arriving at the partition, in trace order
+    int arrival_count; // Number of arrivals
+    int next_arrival; // Index of the next arrival
+    sim_time_t *in_flight; // Completion times of the I/O bursts on the device (min-heap)
+    int in_flight_count; // Number of I/O bursts on the device
+    DesMailbox inbox; // Messages received, sorted by (time, source, seq)
+    int inbox_next; // Index of the next unprocessed message
+    DesMailbox *outboxes; // Messages sent during the current window, per destination LP
+    long long sent; // Messages sent so far (sequence numbers)
+    sim_time_t next_event; // Time of the earliest pending event (valid between windows)
+    int failed; // Set when a message could not be queued
+} DesLp;
+
+// Define the DesEngine structure (state shared by the workers)
+typedef struct DesEngine {
+    SchedulerContext *ctx; // Simulation being run
+    DesLp *lps; // Partitions, then the device
+    int lp_count; // Number of LPs
+    int threads; // Number of worker threads
+    pthread_barrier_t barrier; // Separates simulating a window from exchanging its messages
+    pthread_mutex_t gate_mutex; // Mutex protecting gate
+    pthread_cond_t gate_cond; // Signalled when gate opens or aborts
+    int gate; // Workers wait here until every one started (0 = waiting, 1 = run, -1 = abort)
+    sim_time_t lookahead; // Window length
+    sim_time_t trace_end; // Trace time reached by the last sleep
+    int *load; // Ready and running PCBs per partition at the last barrier (SCHED_BALANCE_LOAD)
+    int *placed; // PCBs the device sent to each partition during the current window (SCHED_BALANCE_LOAD)
+    DesMailbox *moved; // PCBs migrated at the current barrier, per destination partition
+    long long moves; // PCBs migrated so far (sequence numbers)
+} DesEngine;
+
+static const char *balance_names[] = {"NONE", "SPEED", "LOAD"}; // -balance names, indexed by SCHED_BALANCE_*
+
+// Look up a load-balancing policy by its -balance name (-1 if unknown)
+int des_balance_find(const char *name) {
+    for (int i = 0; name != NULL && i < (int)(sizeof(balance_names) / sizeof(balance_names[0])); i++) { // Loop through each policy
+        if (strcmp(name, balance_names[i]) == 0) { // If the name matches
+            return i; // Return the policy
+        }
+    }
+    return -1; // Unknown policy
+}
+
+// The -balance name of a load-balancing policy
+const char *des_balance_name(int balance) {
+    return balance >= 0 && balance < (int)(sizeof(balance_names) / sizeof(balance_names[0])) ? balance_names[balance] : "?";
+}
+
+// Define the DesWorker structure (argument of one worker thread)
+typedef struct DesWorker {
+    DesEngine *engine; // Shared engine state
+    int index; // Worker number (simulates LPs index, index + threads, ...)
+} DesWorker;
+
+// Append a message to a mailbox; returns 0 on success
+static int mailbox_push(DesMailbox *box, DesMessage message) {
+    if (box->count == box->capacity) { // If the mailbox is full
+        int capacity = box->capacity ? box->capacity * 2 : 64; // Double the capacity
+        DesMessage *items = realloc(box->items, capacity * sizeof(DesMessage)); // Grow the array
+        if (!items) { // If the allocation failed
+            return -1; // Report the failure
+        }
+        box->items = items; // Keep the grown array
+        box->capacity = capacity; // Record the new capacity
+    }
+    box->items[box->count++] = message; // Store the message
+    return 0; // Return success
+}
+
+// Order messages by time, then sender, then send order
+static int compare_messages(const void *a, const void *b) {
+    const DesMessage *x = a, *y = b; // Messages being compared
+    if (x->time != y->time) { // Earlier messages first
+        return x->time < y->time ? -1 : 1;
+    }
+    if (x->source != y->source) { // Then by sender
+        return x->source - y->source;
+    }
+    return x->seq < y->seq ? -1 : x->seq > y->seq; // Then in send order
+}
+
+// Hand a PCB to another LP at a simulated time (at least one lookahead ahead)
+static void des_send(DesLp *lp, int destination, sim_time_t time, PCB *pcb) {
+    DesMessage message = {time, lp->id, lp->sent++, pcb}; // Stamp the message
+    if (mailbox_push(&lp->outboxes[destination], message) != 0) { // Queue it for the barrier
+        perror("Failed to queue simulation message"); // Print an error message
+        pcb_free(pcb); // Drop the process
+        lp->failed = 1; // Fail the run
+    }
+}
+
+// Record the metrics of a finished process in the LP's context and release it
+static void des_finish(SchedulerContext *ctx, PCB *pcb, sim_time_t finish_time) {
+    sim_time_t turnaround_time = finish_time - pcb->arrival_time; // Calculate turnaround time
+    ctx->total_turnaround_time += turnaround_time; // Update total turnaround time
+    ctx->total_waiting_time += pcb->waiting_time; // Update total waiting time
+    ctx->process_count++; // Increment process count
+    if (finish_time >= ctx->args.measure_from && finish_time < ctx->args.measure_until) { // If it finished in the measured interval
+        ctx->measured_completions++;
+    }
+    histogram_observe(&ctx->turnaround_hist, turnaround_time); // Record the turnaround distribution
+    histogram_observe(&ctx->waiting_hist, pcb->waiting_time); // Record the waiting distribution
+    if (finish_time > ctx->current_time) { // A process finishing during I/O may end the run
+        ctx->current_time = finish_time;
+    }
+    if (ctx->args.results) { // If per-process rows are written
+        results_record(ctx->args.results, pcb, finish_time); // Queue the row for the writer thread
+    }
+    pcb_free(pcb); // Free the PCB
+}
+
+// Time of the earliest pending event of a partition
+static sim_time_t partition_next_event(DesLp *lp) {
+    sim_time_t next = DES_NEVER; // Earliest event so far
+    for (int c = 0; c < lp->cpu_count; c++) { // Loop through each CPU
+        if (lp->action[c] != DES_CPU_IDLE && lp->cpus[c].burst_end < next) { // If its run ends first
+            next = lp->cpus[c].burst_end;
+        }
+    }
+    if (lp->inbox_next < lp->inbox.count && lp->inbox.items[lp->inbox_next].time < next) { // If an I/O completion comes first
+        next = lp->inbox.items[lp->inbox_next].time;
+    }
+    if (lp->next_arrival < lp->arrival_count && lp->arrivals[lp->next_arrival]->arrival_time < next) { // If an arrival comes first
+        next = lp->arrivals[lp->next_arrival]->arrival_time;
+    }
+    return next; // Return the earliest event
+}
+
+// Start the PCB picked by the policy on an idle CPU of a partition
+static void partition_dispatch(DesLp *lp, int c, sim_time_t now, int device) {
+    SchedulerContext *ctx = lp->ctx; // Context of the partition
+    const SchedPolicy *policy = ctx->policy; // Policy ordering the ready queue
+    pthread_mutex_lock(&ctx->ready_queue.mutex); // pick_next expects the mutex held
+    PCB *pcb = policy->pick_next(ctx); // Let the policy pick and unlink a PCB
+    pthread_mutex_unlock(&ctx->ready_queue.mutex); // Unlock the ready queue mutex
+    Cpu *cpu = &lp->cpus[c]; // CPU running the PCB
+    ctx->dispatches++; // Count the dispatch
+    sim_time_t overhead = cpu_take(cpu, pcb, &cpu->ctx->args); // Count a migration if it last ran elsewhere, and price the dispatch
+    sim_time_t run = cpu_run_time(cpu, pcb->remaining); // Time this CPU needs for the rest of the current burst
+    sim_time_t slice = policy->on_tick ? policy->on_tick(ctx, pcb) : 0; // Time the PCB may run before preemption
+    lp->action[c] = DES_CPU_FINISH; // Finish the process unless an I/O burst follows
+    if (slice > 0 && run > slice) { // If the burst outlasts its slice
+        run = slice; // Run the slice only
+        pcb->remaining -= cpu_work_in(cpu, slice); // Decrement the work left
+        pcb->flags |= PCB_FLAG_PREEMPTED; // Its next run starts with cold caches
+        pcb->preemptions++; // Count the preemption on the process
+        ctx->preemptions++; // Count the preemption
+        lp->action[c] = DES_CPU_REQUEUE; // Requeue it when the slice ends
+    }
+    pcb->waiting_time += now - pcb->ready_time; // Accumulate the time spent in the ready queue
+    cpu->burst_start = now + overhead; // Record the run, which starts once the dispatch overhead is paid
+    cpu->burst_end = cpu->cpu_time = pcb->ready_time = now + overhead + run; // The CPU and the PCB are free again at its end
+    cpu->busy_time += run; // Account the run
+    ctx->busy_time += run;
+    cpu->overhead_time += overhead; // Account the overhead separately
+    ctx->overhead_time += overhead;
+    if (policy->on_ran) { // If the policy tracks runs
+        policy->on_ran(ctx, pcb, cpu->burst_start, run); // The whole run is known at dispatch
+    }
+    lp->running[c] = pcb; // Occupy the CPU
+    if (lp->action[c] == DES_CPU_FINISH && pcb_advance(pcb)) { // If an I/O burst follows
+        lp->action[c] = DES_CPU_SENT; // The CPU only has to become idle
+        lp->running[c] = NULL; // The partition no longer owns the PCB
+        des_send(lp, device, cpu->burst_end, pcb); // Send it now: the device receives it no earlier than the end of the run
+    }
+}
+
+// Simulate a partition up to (excluding) the end of the window
+static void partition_run(DesLp *lp, sim_time_t end, int device) {
+    SchedulerContext *ctx = lp->ctx; // Context of the partition
+    const SchedPolicy *policy = ctx->policy; // Policy ordering the ready queue
+    sim_time_t now; // Time of the event being processed
+    while ((now = partition_next_event(lp)) < end) { // Process events in time order until the end of the window
+        ctx->current_time = now; // Update the current time
+        for (int c = 0; c < lp->cpu_count; c++) { // Runs ending now, in CPU order
+            if (lp->action[c] == DES_CPU_IDLE || lp->cpus[c].burst_end != now) { // If nothing ends on this CPU
+                continue;
+            }
+            PCB *pcb = lp->running[c]; // PCB leaving the CPU (NULL if it went to the device)
+            if (lp->action[c] == DES_CPU_REQUEUE) { // If its slice expired
+                if (policy->on_preempt) { // If the policy tracks preemptions
+                    policy->on_preempt(ctx, pcb, now - lp->cpus[c].burst_start); // Tell it the slice expired
+                }
+                enqueue_ready(ctx, pcb); // Put it back in the ready queue
+            } else if (lp->action[c] == DES_CPU_FINISH) { // If its last burst ended
+                des_finish(ctx, pcb, now); // Record metrics and free the PCB
+            }
+            lp->running[c] = NULL; // The CPU is idle
+            lp->action[c] = DES_CPU_IDLE;
+        }
+        while (lp->inbox_next < lp->inbox.count && lp->inbox.items[lp->inbox_next].time == now) { // I/O completions, in message order
+            enqueue_ready(ctx, lp->inbox.items[lp->inbox_next++].pcb); // The PCB is ready again
+        }
+        while (lp->next_arrival < lp->arrival_count && lp->arrivals[lp->next_arrival]->arrival_time == now) { // Arrivals, in trace order
+            enqueue_ready(ctx, lp->arrivals[lp->next_arrival++]); // The process is ready on arrival
+        }
+        for (int k = 0; k < lp->cpu_count && ctx->ready_queue.head; k++) { // Idle CPUs, fastest first
+            if (lp->action[lp->order[k]] == DES_CPU_IDLE) { // If the CPU is idle
+                partition_dispatch(lp, lp->order[k], now, device); // Start the next PCB
+            }
+        }
+    }
+}
+
+// Add an I/O completion time to the device's heap
+static void in_flight_push(DesLp *lp, sim_time_t time) {
+    int child = lp->in_flight_count++; // Start at the new leaf
+    while (child > 0 && lp->in_flight[(child - 1) / 2] > time) { // Sift up
+        lp->in_flight[child] = lp->in_flight[(child - 1) / 2]; // Move the parent down
+        child = (child - 1) / 2; // Continue from the parent
+    }
+    lp->in_flight[child] = time; // Place the time
+}
+
+// Remove the earliest completion time from the device's heap
+static void in_flight_pop(DesLp *lp) {
+    sim_time_t last = lp->in_flight[--lp->in_flight_count]; // Leaf refilling the root
+    int parent = 0; // Start at the root
+    while (2 * parent + 1 < lp->in_flight_count) { // Sift down
+        int child = 2 * parent + 1; // Left child
+        if (child + 1 < lp->in_flight_count && lp->in_flight[child + 1] < lp->in_flight[child]) { // Pick the earlier child
+            child++;
+        }
+        if (last <= lp->in_flight[child]) { // If the leaf belongs here
+            break;
+        }
+        lp->in_flight[parent] = lp->in_flight[child]; // Move the child up
+        parent = child; // Continue from the child
+    }
+    lp->in_flight[parent] = last; // Place the leaf (harmless when the heap became empty)
+}
+
+// Time of the earliest pending event of the device
+static sim_time_t device_next_event(DesLp *lp) {
+    sim_time_t next = lp->in_flight_count ? lp->in_flight[0] : DES_NEVER; // Earliest completion
+    if (lp->inbox_next < lp->inbox.count && lp->inbox.items[lp->inbox_next].time < next) { // If a request comes first
+        next = lp->inbox.items[lp->inbox_next].time;
+    }
+    return next; // Return the earliest event
+}
+
+// Partition a PCB returns to after its I/O burst: its own, or the least loaded per unit of speed under SCHED_BALANCE_LOAD
+static int device_place(DesEngine *engine, PCB *pcb) {
+    if (engine->ctx->args.balance != SCHED_BALANCE_LOAD) { // If processes stay where they were dealt
+        return pcb->partition;
+    }
+    int best = pcb->partition; // Prefer the partition it ran on (ties keep it there)
+    double best_load = (engine->load[best] + engine->placed[best] + 1) / engine->lps[best].capacity; // Its load with the PCB back
+    for (int p = 0; p < engine->lp_count - 1; p++) { // Loop through each partition
+        double load = (engine->load[p] + engine->placed[p] + 1) / engine->lps[p].capacity; // Its load with the PCB added
+        if (load < best_load) { // If it would be less loaded
+            best = p;
+            best_load = load;
+        }
+    }
+    engine->placed[best]++; // Account the PCB until the next barrier refreshes the loads
+    pcb->partition = best; // The PCB now belongs there
+    return best; // Return the partition
+}
+
+// Simulate the I/O device up to (excluding) the end of the window
+static void device_run(DesEngine *engine, DesLp *lp, sim_time_t end) {
+    SchedulerContext *ctx = lp->ctx; // The simulation (owns the I/O queue, policy and metrics)
+    SchedulerArgs *args = &ctx->args; // Configuration of the simulation
+    sim_time_t tick = args->io_tick; // Completions land on whole ticks, as on the timing wheel
+    sim_time_t now; // Time of the event being processed
+    memset(engine->placed, 0, (engine->lp_count - 1) * sizeof(int)); // The loads were refreshed at the barrier
+    while ((now = device_next_event(lp)) < end) { // Process events in time order until the end of the window
+        if (now > ctx->current_time) { // A completion may precede a finish recorded earlier
+            ctx->current_time = now; // Update the current time
+        }
+        while (lp->in_flight_count && lp->in_flight[0] == now) { // Bursts completing now free the device
+            in_flight_pop(lp);
+        }
+        while (lp->inbox_next < lp->inbox.count && lp->inbox.items[lp->inbox_next].time == now) { // Requests arriving now, in message order
+            enqueue(&ctx->io_queue, lp->inbox.items[lp->inbox_next++].pcb); // Queue the request
+        }
+        while (ctx->io_queue.head && (args->io_depth == 0 || lp->in_flight_count < args->io_depth)) { // Admit requests while the device has capacity
+            pthread_mutex_lock(&ctx->io_queue.mutex); // pick_next expects the mutex held
+            PCB *pcb = ctx->io_policy->pick_next(ctx, now); // Let the policy pick and unlink
+            pthread_mutex_unlock(&ctx->io_queue.mutex); // Unlock the I/O queue mutex
+            sim_time_t waited = now - pcb->ready_time; // Time the request spent in the I/O queue
+            int write = PCB_IS_WRITE(pcb); // Direction of the request
+            ctx->io_requests[write]++; // Count the request
+            ctx->io_wait_total[write] += waited; // Add its wait
+            if (waited > ctx->io_wait_max[write]) { // If no request of this direction waited longer
+                ctx->io_wait_max[write] = waited;
+            }
+            histogram_observe(&ctx->io_wait_hist, waited); // Record the wait distribution
+            sim_time_t done = (now + pcb->remaining + tick - 1) / tick * tick; // Complete on the first tick at or after the end of the burst
+            in_flight_push(lp, done); // Occupy the device until then
+            pcb->ready_time = done; // The I/O burst completes at that tick
+            if (pcb_advance(pcb)) { // If there are more bursts
+                des_send(lp, device_place(engine, pcb), done, pcb); // Send it back now: it arrives no earlier than the end of the burst
+            } else {
+                des_finish(ctx, pcb, done); // The process finishes during I/O
+            }
+        }
+    }
+}
+
+// Ready and running PCBs of a partition (between windows)
+static int partition_load(DesLp *lp) {
+    int load = lp->ctx->ready_queue.length; // Ready PCBs
+    for (int c = 0; c < lp->cpu_count; c++) { // Loop through each CPU
+        load += lp->action[c] != DES_CPU_IDLE; // Count the busy ones
+    }
+    return load; // Return the load
+}
+
+// Migrate ready PCBs from the most to the least loaded partitions (per unit of speed) while that evens them out
+static void des_migrate(DesEngine *engine, sim_time_t end) {
+    int partitions = engine->lp_count - 1; // Number of partitions
+    int *load = engine->load; // Loads, updated as PCBs move (refreshed again at delivery)
+    for (int p = 0; p < partitions; p++) { // Loop through each partition
+        load[p] = partition_load(&engine->lps[p]);
+    }
+    while (1) { // One PCB per iteration
+        int from = -1, to = 0; // Most loaded partition with a ready PCB, least loaded partition
+        for (int p = 0; p < partitions; p++) { // Loop through each partition
+            DesLp *lp = &engine->lps[p]; // Partition to compare
+            if (lp->ctx->ready_queue.head && (from < 0 || load[p] / lp->capacity > load[from] / engine->lps[from].capacity)) {
+                from = p;
+            }
+            if (load[p] / lp->capacity < load[to] / engine->lps[to].capacity) {
+                to = p;
+            }
+        }
+        if (from < 0 || (load[to] + 1) / engine->lps[to].capacity > (load[from] - 1) / engine->lps[from].capacity) { // If a move would not even them out
+            break;
+        }
+        SchedulerContext *source = engine->lps[from].ctx; // Context the PCB leaves
+        pthread_mutex_lock(&source->ready_queue.mutex); // pick_next expects the mutex held
+        PCB *pcb = source->policy->pick_next(source); // Take the PCB the source would run next
+        pthread_mutex_unlock(&source->ready_queue.mutex); // Unlock the ready queue mutex
+        pcb->partition = to; // The PCB now belongs to the destination
+        DesMessage message = {end, engine->lp_count, engine->moves++, pcb}; // It is ready there from the end of the window
+        if (mailbox_push(&engine->moved[to], message) != 0) { // Queue it for delivery
+            perror("Failed to queue simulation message"); // Print an error message
+            pcb_free(pcb); // Drop the process
+            engine->lps[to].failed = 1; // Fail the run
+        }
+        load[from]--; // Update the loads
+        load[to]++;
+    }
+}
+
+// Move the messages addressed to an LP into its inbox, in (time, source, seq) order, and find its next event
+static void des_deliver(DesEngine *engine, DesLp *lp) {
+    DesMailbox *inbox = &lp->inbox; // Messages received
+    int pending = inbox->count - lp->inbox_next; // Messages not processed yet
+    memmove(inbox->items, inbox->items + lp->inbox_next, pending * sizeof(DesMessage)); // Drop the processed ones
+    inbox->count = pending;
+    lp->inbox_next = 0;
+    int received = 0; // New messages
+    for (int source = 0; source < engine->lp_count; source++) { // Loop through each sender
+        DesMailbox *outbox = &engine->lps[source].outboxes[lp->id]; // Messages it sent to this LP
+        for (int i = 0; i < outbox->count; i++) { // Loop through each message
+            if (mailbox_push(inbox, outbox->items[i]) != 0) { // Take it
+                perror("Failed to deliver simulation message"); // Print an error message
+                pcb_free(outbox->items[i].pcb); // Drop the process
+                lp->failed = 1; // Fail the run
+                continue;
+            }
+            received++; // Count it
+        }
+    }
+    DesMailbox *moved = &engine->moved[lp->id]; // PCBs migrated to this LP at the barrier
+    for (int i = 0; i < moved->count; i++) { // Loop through each migrated PCB
+        if (mailbox_push(inbox, moved->items[i]) != 0) { // Take it
+            perror("Failed to deliver simulation message"); // Print an error message
+            pcb_free(moved->items[i].pcb); // Drop the process
+            lp->failed = 1; // Fail the run
+            continue;
+        }
+        received++; // Count it
+    }
+    if (received > 0) { // If anything arrived
+        qsort(inbox->items, inbox->count, sizeof(DesMessage), compare_messages); // Merge with the pending messages
+    }
+    lp->next_event = lp->cpus ? partition_next_event(lp) : device_next_event(lp); // Earliest pending event
+    if (lp->cpus) { // Publish the partition's load for the device's placements in the next window
+        engine->load[lp->id] = partition_load(lp);
+    }
+}
+
+// Worker thread function: simulate this worker's LPs window by window
+static void *des_worker_thread(void *arg) {
+    DesWorker *worker = (DesWorker *)arg; // Get the worker from the argument
+    DesEngine *engine = worker->engine; // Shared engine state
+    int device = engine->lp_count - 1; // Index of the device LP
+    sim_time_t balance_every = engine->ctx->args.balance == SCHED_BALANCE_LOAD ? engine->ctx->args.balance_every : 0; // Time between migration passes (0 = none)
+    sim_time_t next_balance = balance_every; // Every worker tracks the same schedule
+    pthread_mutex_lock(&engine->gate_mutex); // Lock the start gate
+    while (engine->gate == 0) { // Wait until every worker started, or one could not be
+        pthread_cond_wait(&engine->gate_cond, &engine->gate_mutex); // Wait for a condition signal
+    }
+    int run = engine->gate > 0; // Whether the barriers can be passed
+    pthread_mutex_unlock(&engine->gate_mutex); // Unlock the start gate
+    while (run) { // One iteration per window
+        sim_time_t start = DES_NEVER; // Start of the window: the earliest pending event anywhere
+        for (int i = 0; i < engine->lp_count; i++) { // Every worker computes the same start
+            if (engine->lps[i].next_event < start) {
+                start = engine->lps[i].next_event;
+            }
+        }
+        if (start == DES_NEVER) { // If nothing is pending anywhere
+            break; // The simulation is over
+        }
+        sim_time_t end = start < DES_NEVER - engine->lookahead ? start + engine->lookahead : DES_NEVER; // Nothing sent in the window arrives before its end
+        for (int i = worker->index; i < engine->lp_count; i += engine->threads) { // Loop through this worker's LPs
+            DesLp *lp = &engine->lps[i]; // LP to simulate
+            for (int destination = 0; destination < engine->lp_count; destination++) { // Its messages of the previous window were delivered
+                lp->outboxes[destination].count = 0; // Empty the outbox
+            }
+            if (i == device) {
+                device_run(engine, lp, end); // Simulate the device
+            } else {
+                partition_run(lp, end, device); // Simulate the partition
+            }
+        }
+        pthread_barrier_wait(&engine->barrier); // Every LP finished the window
+        if (balance_every > 0 && end != DES_NEVER && end >= next_balance) { // If a migration pass is due
+            if (worker->index == 0) { // One worker moves the PCBs
+                des_migrate(engine, end);
+            }
+            next_balance = (end / balance_every + 1) * balance_every; // Schedule the next pass
+            pthread_barrier_wait(&engine->barrier); // The moves are queued before anyone delivers
+        }
+        for (int i = worker->index; i < engine->lp_count; i += engine->threads) { // Loop through this worker's LPs
+            des_deliver(engine, &engine->lps[i]); // Collect the messages sent to it
+        }
+        if (worker->index == 0) { // One worker keeps the statistics
+            engine->ctx->des_windows++; // Count the window
+            for (int i = 0; i < engine->lp_count; i++) { // Loop through each LP
+                for (int destination = 0; destination < engine->lp_count; destination++) { // Count the messages it sent
+                    engine->ctx->des_messages += engine->lps[i].outboxes[destination].count;
+                }
+            }
+        }
+        pthread_barrier_wait(&engine->barrier); // Every inbox is ready for the next window
+        for (int p = 0; worker->index == 0 && p < device; p++) { // The migrated PCBs were delivered
+            engine->moved[p].count = 0; // Empty the migration mailbox
+        }
+    }
+    return NULL; // Exit the thread
+}
+
+// Shortest time between sending a PCB and its delivery for one process (DES_NEVER if it never leaves its LP)
+static sim_time_t process_lookahead(const PCB *pcb, const SchedPolicy *policy, sim_time_t quantum, const Cpu *fastest, const Cpu *slowest) {
+    static __thread sim_time_t bursts[TRACE_LINE_MAX / 2]; // Bursts of the process (a trace line holds fewer)
+    static __thread unsigned char writes[TRACE_LINE_MAX / 16]; // Write bitmap of the process
+    pcb_get_bursts(pcb, bursts, writes); // Decode every burst
+    sim_time_t shortest = DES_NEVER; // Shortest send-to-delivery time so far
+    for (int i = 0; i + 1 < pcb->burst_count; i++) { // Every burst but the last hands the PCB over
+        sim_time_t gap = bursts[i]; // An I/O burst is sent whole
+        if (i % 2 == 0) { // A CPU burst run in one go takes least time on the fastest CPU
+            gap = cpu_run_time(fastest, bursts[i]);
+        }
+        if (i % 2 == 0 && policy == &rr_policy && cpu_run_time(slowest, bursts[i]) > quantum) { // A sliced CPU burst is sent when its final slice starts
+            if (fastest->speed == slowest->speed) { // Every slice does the same work
+                sim_time_t work = cpu_work_in(fastest, quantum); // Work per slice
+                gap = cpu_run_time(fastest, bursts[i] % work ? bursts[i] % work : work); // Time of the final slice
+            } else {
+                gap = gap < 1 ? gap : 1; // Slices on CPUs of different speeds may leave any remainder
+            }
+        } else if (i % 2 == 0 && policy->on_tick && policy != &rr_policy) { // Slices of other policies are not known ahead of time
+            gap = gap < 1 ? gap : 1;
+        }
+        if (gap < shortest) { // If this handover is the quickest
+            shortest = gap;
+        }
+    }
+    return shortest; // Return the shortest gap
+}
+
+// Read the whole trace ahead of time, dealing the processes round-robin to the partitions; returns the number of processes
+static int des_load_trace(DesEngine *engine) {
+    SchedulerContext *ctx = engine->ctx; // Simulation being run
+    const Workload *workload = ctx->args.workload; // Parsed image of the trace (NULL = parse the file)
+    FILE *file = workload ? NULL : fopen(ctx->args.input_file, "r"); // Open the file for reading
+    if (!workload && !file) { // If the file cannot be opened
+        perror("Failed to open input file"); // Print an error message
+        return -1; // Report the failure
+    }
+    int partitions = engine->lp_count - 1; // Number of partitions
+    double *credit = calloc(partitions, sizeof(double)); // Smooth weighted round-robin credit of each partition
+    if (!credit) { // If the allocation failed
+        perror("Failed to allocate memory for partitions"); // Print an error message
+        if (file) { // If the trace was read from the file
+            fclose(file); // Close the file
+        }
+        return -1; // Report the failure
+    }
+    const Cpu *fastest = &ctx->cpus[0], *slowest = &ctx->cpus[0]; // CPUs bounding the run times
+    double capacity = 0; // Total speed of every CPU
+    for (int i = 0; i < ctx->cpu_count; i++) { // Loop through each CPU
+        fastest = ctx->cpus[i].speed > fastest->speed ? &ctx->cpus[i] : fastest;
+        slowest = ctx->cpus[i].speed < slowest->speed ? &ctx->cpus[i] : slowest;
+        capacity += ctx->cpus[i].speed;
+    }
+    int loaded = 0; // Processes read so far
+    sim_time_t read_time = 0; // Simulated time reached by the trace
+    char line[TRACE_LINE_MAX]; // Buffer to store each line of the file
+    for (long record = 0; workload ? record < workload->header->record_count : fgets(line, sizeof(line), file) != NULL; record++) { // Read each record or line
+        TraceEvent event; // Parsed line
+        TraceEventKind kind = workload ? workload_event(workload, record, &event) : trace_parse_line(line, strlen(line), &event); // Replay or parse it
+        if (kind == TRACE_SLEEP) { // The trace time advances
+            read_time += event.sleep_time;
+        } else if (kind == TRACE_STOP) { // The trace ends
+            break;
+        } else if (kind == TRACE_POLICY) { // The lookahead was derived from one policy
+            fprintf(stderr, "Policy switches need the real-time engine\n"); // Print an error message
+            free(credit); // Free the credits
+            if (file) { // If the trace was read from the file
+                fclose(file); // Close the file
+            }
+            return -1; // Report the failure
+        } else if (kind == TRACE_PROC) { // A new process arrives
+            PCB *pcb = event.pcb; // Take ownership of the parsed PCB
+            int home = loaded % partitions; // Deal the processes in turn
+            if (ctx->args.balance != SCHED_BALANCE_NONE) { // Deal them in proportion to the partitions' speed instead
+                for (int p = 0; p < partitions; p++) { // Every partition earns credit for its speed
+                    credit[p] += engine->lps[p].capacity;
+                    home = credit[p] > credit[home] ? p : home; // The one with the most credit gets the process
+                }
+                credit[home] -= capacity; // It pays for the process
+            }
+            DesLp *lp = &engine->lps[home]; // Partition owning it
+            if (lp->arrival_count % 256 == 0) { // If its arrival array is full
+                PCB **arrivals = realloc(lp->arrivals, (lp->arrival_count + 256) * sizeof(PCB *)); // Grow it
+                if (!arrivals) { // If the allocation failed
+                    perror("Failed to allocate memory for arrivals"); // Print an error message
+                    pcb_free(pcb); // Drop the process
+                    free(credit); // Free the credits
+                    if (file) { // If the trace was read from the file
+                        fclose(file); // Close the file
+                    }
+                    return -1; // Report the failure
+                }
+                lp->arrivals = arrivals; // Keep the grown array
+            }
+            pcb->arrival_time = pcb->ready_time = read_time; // The process is ready on arrival
+            pcb->partition = home; // Remember where it returns after I/O
+            pcb->id = loaded + 1; // Number it in admission order
+            lp->arrivals[lp->arrival_count++] = pcb; // Add it to the partition
+            sim_time_t gap = process_lookahead(pcb, ctx->policy, ctx->args.quantum, fastest, slowest); // Its quickest handover
+            if (gap < engine->lookahead) { // If it is the quickest so far
+                engine->lookahead = gap;
+            }
+            loaded++; // Count the process
+        }
+    }
+    free(credit); // Free the credits
+    if (file) { // If the trace was read from the file
+        fclose(file); // Close the file
+    }
+    engine->trace_end = read_time; // The run lasts at least until the trace ends
+    if (engine->lookahead <= 0) { // A handover taking no time would leave every window empty
+        fprintf(stderr, "The virtual-time engine needs every burst before the last to be longer than 0\n"); // Print an error message
+        return -1; // Report the failure
+    }
+    return loaded; // Return the number of processes
+}
+
+// Set up one partition owning the CPUs [first, first + count) of the simulation
+static int des_partition_init(DesEngine *engine, DesLp *lp, int first, int count) {
+    SchedulerArgs args = engine->ctx->args; // Partitions share the configuration
+    args.cpus = 1; // The CPUs themselves stay in the simulation
+    args.cpu_speeds = NULL;
+    if (!(lp->ctx = malloc(sizeof(SchedulerContext)))) { // Allocate the partition's context
+        return -1; // Report the failure
+    }
+    scheduler_init(lp->ctx, &args); // Own ready queue and policy state
+    lp->running = calloc(count, sizeof(PCB *)); // Nothing is running yet
+    lp->action = calloc(count, sizeof(unsigned char)); // Every CPU is idle
+    lp->order = malloc(count * sizeof(int)); // Dispatch order
+    if (!lp->running || !lp->action || !lp->order) { // If the allocation failed
+        return -1; // Report the failure
+    }
+    lp->cpus = &engine->ctx->cpus[first]; // Slice of the simulation's CPUs
+    lp->cpu_count = count; // Number of CPUs
+    for (int c = 0; c < count; c++) { // Insert each CPU, keeping equally fast CPUs in id order
+        int k = c; // Position of the CPU
+        while (k > 0 && lp->cpus[lp->order[k - 1]].speed < lp->cpus[c].speed) { // Faster CPUs move ahead
+            lp->order[k] = lp->order[k - 1];
+            k--;
+        }
+        lp->order[k] = c; // Place the CPU
+        lp->capacity += lp->cpus[c].speed; // Add its speed
+    }
+    return 0; // Return success
+}
+
+// Release the LPs and the PCBs they still hold, adding the partitions' metrics to the simulation
+static void des_release(DesEngine *engine) {
+    SchedulerContext *ctx = engine->ctx; // Simulation being run
+    for (int i = 0; i < engine->lp_count; i++) { // Loop through each LP
+        DesLp *lp = &engine->lps[i]; // LP to release
+        for (int m = lp->inbox_next; m < lp->inbox.count; m++) { // Messages never processed
+            pcb_free(lp->inbox.items[m].pcb);
+        }
+        free(lp->inbox.items); // Free the inbox
+        for (int destination = 0; lp->outboxes && destination < engine->lp_count; destination++) { // Loop through each outbox
+            free(lp->outboxes[destination].items); // Free it (its messages were delivered)
+        }
+        free(lp->outboxes);
+        free(lp->in_flight); // Free the device heap
+        for (int a = lp->next_arrival; a < lp->arrival_count; a++) { // Processes that never arrived
+            pcb_free(lp->arrivals[a]);
+        }
+        free(lp->arrivals); // Free the arrival array
+        for (int c = 0; c < lp->cpu_count; c++) { // PCBs still on a CPU
+            pcb_free(lp->running[c]);
+        }
+        free(lp->running); // Free the per-CPU state
+        free(lp->action);
+        free(lp->order);
+        SchedulerContext *part = lp->ctx; // Context of a partition
+        if (part == NULL || part == ctx) { // The device keeps its metrics in the simulation itself
+            continue;
+        }
+        ctx->busy_time += part->busy_time; // Merge the partition's metrics
+        ctx->process_count += part->process_count;
+        ctx->measured_completions += part->measured_completions;
+        ctx->total_turnaround_time += part->total_turnaround_time;
+        ctx->total_waiting_time += part->total_waiting_time;
+        ctx->overhead_time += part->overhead_time;
+        ctx->dispatches += part->dispatches;
+        ctx->preemptions += part->preemptions;
+        if (part->current_time > ctx->current_time) { // If the partition had the last event
+            ctx->current_time = part->current_time;
+        }
+        histogram_merge(&ctx->turnaround_hist, &part->turnaround_hist);
+        histogram_merge(&ctx->waiting_hist, &part->waiting_hist);
+        scheduler_destroy(part); // Release the partition's queues and PCBs
+        free(part);
+    }
+    for (int p = 0; engine->moved && p < engine->lp_count; p++) { // Loop through each migration mailbox
+        free(engine->moved[p].items); // Free it (its PCBs were delivered)
+    }
+    free(engine->moved);
+    free(engine->load); // Free the balancing state
+    free(engine->placed);
+    free(engine->lps); // Free the LPs
+}
+
+// Run a simulation in virtual time on ctx->args.des_threads workers
+int des_run(SchedulerContext *ctx) {
+    if (ctx->policy == NULL) { // If the algorithm is unknown
+        fprintf(stderr, "Unknown scheduling algorithm %s\n", ctx->args.algorithm ? ctx->args.algorithm : "(none)"); // Print an error message
+        return -1; // Report the failure
+    }
+    if (ctx->io_policy == NULL) { // If the I/O algorithm is unknown
+        fprintf(stderr, "Unknown I/O scheduling algorithm %s\n", ctx->args.io_algorithm); // Print an error message
+        return -1; // Report the failure
+    }
+    if (ctx->groups) { // If processes share the CPUs by group
+        fprintf(stderr, "Fair-share groups need the real-time engine\n"); // Print an error message
+        return -1; // Report the failure
+    }
+    int partitions = ctx->args.des_partitions > 0 ? ctx->args.des_partitions : 1; // Number of partitions
+    if (partitions > ctx->cpu_count) { // Every partition needs a CPU
+        fprintf(stderr, "Cannot split %d simulated CPUs into %d partitions\n", ctx->cpu_count, partitions); // Print an error message
+        return -1; // Report the failure
+    }
+    DesEngine engine = {.ctx = ctx, .lp_count = partitions + 1, .threads = ctx->args.des_threads, .lookahead = DES_NEVER}; // Partitions, then the device
+    if (engine.threads > engine.lp_count) { // Extra workers would only wait at the barriers
+        engine.threads = engine.lp_count;
+    }
+    engine.load = calloc(partitions, sizeof(int)); // Loads of the partitions
+    engine.placed = calloc(partitions, sizeof(int)); // Device placements of the current window
+    engine.moved = calloc(partitions + 1, sizeof(DesMailbox)); // Migration mailboxes (the device never receives any)
+    if (!(engine.lps = calloc(engine.lp_count, sizeof(DesLp))) || !engine.load || !engine.placed || !engine.moved) { // Allocate the LPs
+        perror("Failed to allocate memory for partitions"); // Print an error message
+        free(engine.load); // Free what was allocated
+        free(engine.placed);
+        free(engine.moved);
+        free(engine.lps);
+        return -1; // Report the failure
+    }
+    int status = 0; // Result of the setup
+    for (int i = 0; i < engine.lp_count && status == 0; i++) { // Loop through each LP
+        DesLp *lp = &engine.lps[i]; // LP to set up
+        lp->id = i; // Number the LP
+        int first = i * ctx->cpu_count / partitions; // First CPU of a partition
+        if (!(lp->outboxes = calloc(engine.lp_count, sizeof(DesMailbox)))) { // One outbox per destination
+            status = -1;
+        } else if (i == partitions) { // The device
+            lp->ctx = ctx; // It uses the simulation's I/O queue, policy and metrics
+        } else {
+            status = des_partition_init(&engine, lp, first, (i + 1) * ctx->cpu_count / partitions - first); // Spread the CPUs evenly
+        }
+    }
+    if (status != 0) { // If the setup failed
+        perror("Failed to set up the virtual-time engine"); // Print an error message
+        des_release(&engine); // Release what was set up
+        return -1; // Report the failure
+    }
+    int processes = des_load_trace(&engine); // Read every process up front
+    DesLp *device = &engine.lps[partitions]; // The device LP
+    if (processes < 0 || !(device->in_flight = malloc((processes + 1) * sizeof(sim_time_t)))) { // A process has at most one burst on the device
+        des_release(&engine); // Release what was loaded
+        return -1; // Report the failure
+    }
+    for (int i = 0; i < engine.lp_count; i++) { // Find every LP's first event
+        des_deliver(&engine, &engine.lps[i]);
+    }
+
+    pthread_t *threads = malloc(engine.threads * sizeof(pthread_t)); // Worker threads
+    DesWorker *workers = malloc(engine.threads * sizeof(DesWorker)); // Their arguments
+    int started = 0, error = 0; // Number of workers started, and why the next one could not be
+    if (threads && workers && pthread_barrier_init(&engine.barrier, NULL, engine.threads) == 0) { // Every worker meets at the barriers
+        pthread_mutex_init(&engine.gate_mutex, NULL); // Initialize the start gate
+        pthread_cond_init(&engine.gate_cond, NULL);
+        for (; started < engine.threads; started++) { // Start the workers
+            workers[started] = (DesWorker){&engine, started}; // Give the worker its LPs
+            if ((error = pthread_create(&threads[started], NULL, des_worker_thread, &workers[started])) != 0) { // Start it
+                break; // The barrier can no longer be passed
+            }
+        }
+        if (started < engine.threads) { // A missing worker would block the others at the first barrier
+            fprintf(stderr, "Failed to start the virtual-time workers: %s\n", strerror(error)); // Print an error message
+        }
+        pthread_mutex_lock(&engine.gate_mutex); // Lock the start gate
+        engine.gate = started == engine.threads ? 1 : -1; // Run, or send the started workers home before any barrier
+        pthread_cond_broadcast(&engine.gate_cond); // Release the workers
+        pthread_mutex_unlock(&engine.gate_mutex); // Unlock the start gate
+        for (int i = 0; i < started; i++) { // Loop through each worker
+            pthread_join(threads[i], NULL); // Wait for it to finish
+        }
+        pthread_cond_destroy(&engine.gate_cond); // Release the start gate
+        pthread_mutex_destroy(&engine.gate_mutex);
+        pthread_barrier_destroy(&engine.barrier); // Release the barrier
+    }
+    free(threads); // Free the thread handles
+    free(workers); // Free the worker arguments
+    status = started == engine.threads ? 0 : -1; // The run completed only if every worker ran
+    for (int i = 0; i < engine.lp_count; i++) { // Loop through each LP
+        if (engine.lps[i].failed) { // If it lost a message
+            status = -1; // Fail the run
+        }
+    }
+    ctx->des_lookahead = engine.lookahead; // Record the window length
+    des_release(&engine); // Merge the partitions and release the engine
+    ctx->total_time = ctx->current_time > engine.trace_end ? ctx->current_time : engine.trace_end; // The run ends at the last event, or at the end of the trace
+    return status; // Return the result
+}
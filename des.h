@@ -0,0 +1,13 @@
+//
+// Virtual-time engine: conservative parallel discrete-event simulation over CPU partitions
+//
+#ifndef DES_H // If not defined, define DES_H to prevent multiple inclusions
+#define DES_H // Define DES_H
+
+#include "scheduler.h" // Include the scheduler header file
+
+int des_run(SchedulerContext *ctx); // Function prototype for running a simulation in virtual time on ctx->args.des_threads workers
+int des_balance_find(const char *name); // Function prototype for looking up a load-balancing policy by its -balance name (-1 if unknown)
+const char *des_balance_name(int balance); // Function prototype for the -balance name of a load-balancing policy
+
+#endif // DES_H // End of include guard
@@ -0,0 +1,349 @@
+//
+// User-level fibers multiplexed on a few carrier threads, with wait lists and deadline sleeps
+//
+#include <stdio.h> // Include standard I/O library
+#include <stdlib.h> // Include standard library
+#include <string.h> // Include string handling library
+#include <ucontext.h> // Include user-level context switching
+#include <sys/mman.h> // Include mmap for the fiber stacks
+#include <unistd.h> // Include sysconf for the page size
+#include "fiber.h" // Include the fiber header file
+
+#define NSEC_PER_SEC 1000000000LL // Nanoseconds per second
+
+typedef struct Carrier Carrier; // Carrier thread
+
+// Define the Fiber structure (a fiber never leaves the carrier it was pinned to)
+struct Fiber {
+    ucontext_t context; // Saved registers and stack of the fiber
+    void *(*entry)(void *); // Function the fiber runs
+    void *arg; // Argument of the function
+    void *stack; // Mapped stack, including the guard page
+    size_t stack_size; // Size of the mapping
+    Carrier *carrier; // Carrier thread the fiber runs on
+    Fiber *next; // Next fiber in a ready list or wait list
+    long long wake_ns; // CLOCK_MONOTONIC deadline while sleeping
+    int finished; // Set once the entry function returned
+};
+
+// Define the Carrier structure (one OS thread switching between its fibers)
+struct Carrier {
+    pthread_t thread; // OS thread running the fibers
+    pthread_mutex_t mutex; // Mutex protecting the ready list and the timers
+    pthread_cond_t cond; // Signalled when a fiber becomes ready (CLOCK_MONOTONIC timeouts)
+    Fiber *ready_head; // First runnable fiber
+    Fiber *ready_tail; // Last runnable fiber
+    Fiber **timers; // Min-heap of sleeping fibers ordered by deadline
+    int timer_count; // Number of sleeping fibers
+    int fiber_count; // Number of fibers pinned to the carrier (the heap capacity)
+    int live; // Number of fibers that have not finished
+    ucontext_t context; // Scheduler context the fibers switch back to
+};
+
+// Define the FiberPool structure
+struct FiberPool {
+    Carrier *carriers; // Carrier threads
+    int threads; // Number of carrier threads
+    Fiber **fibers; // Every fiber, in spawn order
+    int count; // Number of fibers
+    int capacity; // Allocated length of fibers
+};
+
+static __thread Fiber *current_fiber = NULL; // Fiber running on this thread
+
+// Read the monotonic clock in nanoseconds
+static long long monotonic_ns(void) {
+    struct timespec now; // Current monotonic time
+    clock_gettime(CLOCK_MONOTONIC, &now); // Read the monotonic clock
+    return (long long)now.tv_sec * NSEC_PER_SEC + now.tv_nsec; // Combine seconds and nanoseconds
+}
+
+// Create a pool of carrier threads (they start in fiber_pool_run)
+FiberPool *fiber_pool_create(int threads) {
+    FiberPool *pool = calloc(1, sizeof(FiberPool)); // Empty pool
+    if (!pool || !(pool->carriers = calloc(threads > 0 ? threads : 1, sizeof(Carrier)))) { // Allocate the carriers
+        perror("Failed to allocate memory for fiber pool"); // Print an error message
+        free(pool); // Free the partial pool
+        return NULL; // Report the failure
+    }
+    pool->threads = threads > 0 ? threads : 1; // At least one carrier
+    pthread_condattr_t attr; // Attributes of the carrier condition variables
+    pthread_condattr_init(&attr); // Default attributes
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); // Timeouts are CLOCK_MONOTONIC deadlines
+    for (int i = 0; i < pool->threads; i++) { // Loop through each carrier
+        pthread_mutex_init(&pool->carriers[i].mutex, NULL); // Initialize the carrier mutex
+        pthread_cond_init(&pool->carriers[i].cond, &attr); // Initialize the carrier condition variable
+    }
+    pthread_condattr_destroy(&attr); // Release the attributes
+    return pool; // Return the pool
+}
+
+// Number of carrier threads
+int fiber_pool_threads(const FiberPool *pool) {
+    return pool->threads; // Fixed at creation
+}
+
+// First code every fiber runs: call the entry function, then return to the carrier for good
+static void fiber_trampoline(void) {
+    Fiber *fiber = current_fiber; // Fiber being started
+    fiber->entry(fiber->arg); // Run the fiber
+    fiber->finished = 1; // Let the carrier retire it
+    setcontext(&fiber->carrier->context); // Never resumed again
+}
+
+// Add a fiber, pinned round-robin to a carrier; returns 0 on success
+int fiber_spawn(FiberPool *pool, void *(*entry)(void *), void *arg) {
+    if (pool->count == pool->capacity) { // If the fiber array is full
+        int capacity = pool->capacity ? pool->capacity * 2 : 16; // Double the capacity
+        Fiber **fibers = realloc(pool->fibers, capacity * sizeof(Fiber *)); // Grow the array
+        if (!fibers) { // If the allocation failed
+            perror("Failed to allocate memory for fibers"); // Print an error message
+            return -1; // Report the failure
+        }
+        pool->fibers = fibers; // Keep the grown array
+        pool->capacity = capacity; // Record the new capacity
+    }
+    Carrier *carrier = &pool->carriers[pool->count % pool->threads]; // Carrier the fiber is pinned to
+    Fiber **timers = realloc(carrier->timers, (carrier->fiber_count + 1) * sizeof(Fiber *)); // Room for the fiber to sleep
+    Fiber *fiber = calloc(1, sizeof(Fiber)); // The fiber
+    if (!timers || !fiber) { // If an allocation failed
+        perror("Failed to allocate memory for fibers"); // Print an error message
+        if (timers) { // Keep the grown heap
+            carrier->timers = timers;
+        }
+        free(fiber); // Free the fiber
+        return -1; // Report the failure
+    }
+    carrier->timers = timers; // Keep the grown heap
+    long page = sysconf(_SC_PAGESIZE); // Size of the guard page
+    fiber->stack_size = FIBER_STACK_SIZE + page; // Stack plus guard page
+    fiber->stack = mmap(NULL, fiber->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0); // Map the stack
+    if (fiber->stack == MAP_FAILED) { // If the stack cannot be mapped
+        perror("Failed to map fiber stack"); // Print an error message
+        free(fiber); // Free the fiber
+        return -1; // Report the failure
+    }
+    mprotect(fiber->stack, page, PROT_NONE); // Overflowing the stack faults instead of corrupting memory
+    getcontext(&fiber->context); // Start from the current signal mask
+    fiber->context.uc_stack.ss_sp = (char *)fiber->stack + page; // Stack above the guard page
+    fiber->context.uc_stack.ss_size = FIBER_STACK_SIZE; // Usable stack size
+    fiber->context.uc_link = NULL; // The trampoline switches back explicitly
+    makecontext(&fiber->context, fiber_trampoline, 0); // Enter through the trampoline
+    fiber->entry = entry; // Function the fiber runs
+    fiber->arg = arg; // Argument of the function
+    fiber->carrier = carrier; // Pin the fiber
+    if (carrier->ready_tail) { // Every fiber starts runnable
+        carrier->ready_tail->next = fiber;
+    } else {
+        carrier->ready_head = fiber;
+    }
+    carrier->ready_tail = fiber; // Update the ready tail
+    carrier->fiber_count++; // Count the fiber on its carrier
+    carrier->live++; // The fiber has not finished
+    pool->fibers[pool->count++] = fiber; // Keep the fiber for destruction
+    return 0; // Return success
+}
+
+// Append a fiber to its carrier's ready list (carrier mutex held)
+static void ready_push(Carrier *carrier, Fiber *fiber) {
+    fiber->next = NULL; // The fiber becomes the tail
+    if (carrier->ready_tail) { // If the list is not empty
+        carrier->ready_tail->next = fiber; // Link after the tail
+    } else {
+        carrier->ready_head = fiber; // The fiber starts the list
+    }
+    carrier->ready_tail = fiber; // Update the tail
+}
+
+// Make a parked fiber runnable again; safe from any thread or fiber
+static void fiber_ready(Fiber *fiber) {
+    Carrier *carrier = fiber->carrier; // Carrier the fiber is pinned to
+    pthread_mutex_lock(&carrier->mutex); // Lock the carrier
+    ready_push(carrier, fiber); // Queue the fiber
+    pthread_cond_signal(&carrier->cond); // Wake the carrier if it is idle
+    pthread_mutex_unlock(&carrier->mutex); // Unlock the carrier
+}
+
+// Move a sleeping fiber into the timer heap (carrier mutex held)
+static void timer_push(Carrier *carrier, Fiber *fiber) {
+    int child = carrier->timer_count++; // Start at the new leaf
+    while (child > 0) { // Sift up
+        int parent = (child - 1) / 2; // Parent of the slot
+        if (carrier->timers[parent]->wake_ns <= fiber->wake_ns) { // If the parent is due first
+            break;
+        }
+        carrier->timers[child] = carrier->timers[parent]; // Move the parent down
+        child = parent; // Continue from the parent
+    }
+    carrier->timers[child] = fiber; // Place the fiber
+}
+
+// Remove the fiber with the earliest deadline from the timer heap (carrier mutex held)
+static Fiber *timer_pop(Carrier *carrier) {
+    Fiber *first = carrier->timers[0]; // Earliest deadline
+    Fiber *last = carrier->timers[--carrier->timer_count]; // Leaf refilling the root
+    int parent = 0; // Start at the root
+    while (1) { // Sift down
+        int child = 2 * parent + 1; // Left child
+        if (child >= carrier->timer_count) { // If the slot is a leaf
+            break;
+        }
+        if (child + 1 < carrier->timer_count && carrier->timers[child + 1]->wake_ns < carrier->timers[child]->wake_ns) { // Pick the earlier child
+            child++;
+        }
+        if (last->wake_ns <= carrier->timers[child]->wake_ns) { // If the leaf belongs here
+            break;
+        }
+        carrier->timers[parent] = carrier->timers[child]; // Move the child up
+        parent = child; // Continue from the child
+    }
+    if (carrier->timer_count > 0) { // If the heap is not empty
+        carrier->timers[parent] = last; // Place the leaf
+    }
+    return first; // Return the earliest sleeper
+}
+
+// Carrier thread function: run the pinned fibers until every one of them has finished
+static void *carrier_thread(void *arg) {
+    Carrier *carrier = (Carrier *)arg; // Get the carrier from the argument
+    pthread_mutex_lock(&carrier->mutex); // Lock the carrier
+    while (carrier->live > 0) { // Until every fiber finished
+        if (carrier->timer_count > 0 && carrier->timers[0]->wake_ns <= monotonic_ns()) { // If sleepers are due
+            long long now = monotonic_ns(); // Time the timers are judged at
+            while (carrier->timer_count > 0 && carrier->timers[0]->wake_ns <= now) { // Wake every due sleeper
+                ready_push(carrier, timer_pop(carrier)); // Make it runnable
+            }
+        }
+        Fiber *fiber = carrier->ready_head; // Next runnable fiber
+        if (fiber) { // If one is runnable
+            carrier->ready_head = fiber->next; // Remove it from the ready list
+            if (carrier->ready_head == NULL) { // If the list became empty
+                carrier->ready_tail = NULL;
+            }
+            fiber->next = NULL; // Detach the fiber
+            pthread_mutex_unlock(&carrier->mutex); // Wakers may queue it again while it runs
+            current_fiber = fiber; // The fiber is running
+            swapcontext(&carrier->context, &fiber->context); // Run until it parks or finishes
+            current_fiber = NULL; // Back on the carrier
+            pthread_mutex_lock(&carrier->mutex); // Lock the carrier
+            if (fiber->finished) { // If the fiber returned
+                carrier->live--; // Retire it
+            }
+            continue; // Pick again
+        }
+        if (carrier->timer_count > 0) { // If a fiber sleeps
+            long long wake = carrier->timers[0]->wake_ns; // Earliest deadline
+            struct timespec deadline = {wake / NSEC_PER_SEC, wake % NSEC_PER_SEC}; // Deadline as a timespec
+            pthread_cond_timedwait(&carrier->cond, &carrier->mutex, &deadline); // Idle until it or a wakeup is due
+        } else {
+            pthread_cond_wait(&carrier->cond, &carrier->mutex); // Idle until a fiber is woken
+        }
+    }
+    pthread_mutex_unlock(&carrier->mutex); // Unlock the carrier
+    return NULL; // Exit the thread
+}
+
+// Run every fiber to completion on the carrier threads; returns 0 on success
+int fiber_pool_run(FiberPool *pool) {
+    int started = 0; // Number of carriers running
+    for (; started < pool->threads; started++) { // Start each carrier
+        if (pthread_create(&pool->carriers[started].thread, NULL, carrier_thread, &pool->carriers[started]) != 0) { // If the thread cannot be created
+            perror("Failed to create fiber carrier thread"); // Print an error message
+            break;
+        }
+    }
+    if (started == 0) { // If no carrier could be started
+        return -1; // Report the failure
+    }
+    for (int i = started; i < pool->threads; i++) { // Carriers that could not start
+        Carrier *carrier = &pool->carriers[i]; // Carrier without a thread
+        while (carrier->ready_head) { // Move its fibers to a running carrier
+            Fiber *fiber = carrier->ready_head; // Take the first fiber
+            carrier->ready_head = fiber->next; // Remove it from the list
+            Carrier *target = &pool->carriers[i % started]; // Carrier that runs it instead
+            pthread_mutex_lock(&target->mutex); // Lock the target carrier
+            Fiber **timers = realloc(target->timers, (target->fiber_count + 1) * sizeof(Fiber *)); // Room for the fiber to sleep
+            if (timers) { // If the heap could grow
+                target->timers = timers; // Keep the grown heap
+                target->fiber_count++; // Count the fiber on the target
+                target->live++; // The target waits for it
+                fiber->carrier = target; // Re-pin the fiber
+                ready_push(target, fiber); // Queue it on the target
+                pthread_cond_signal(&target->cond); // Wake the target
+            }
+            pthread_mutex_unlock(&target->mutex); // Unlock the target carrier
+        }
+        carrier->ready_tail = NULL; // Nothing left on the carrier
+    }
+    for (int i = 0; i < started; i++) { // Loop through each running carrier
+        pthread_join(pool->carriers[i].thread, NULL); // Wait for its fibers to finish
+    }
+    return 0; // Return success
+}
+
+// Release the pool and the fiber stacks (after fiber_pool_run returned)
+void fiber_pool_destroy(FiberPool *pool) {
+    for (int i = 0; i < pool->count; i++) { // Loop through each fiber
+        munmap(pool->fibers[i]->stack, pool->fibers[i]->stack_size); // Unmap its stack
+        free(pool->fibers[i]); // Free the fiber
+    }
+    for (int i = 0; i < pool->threads; i++) { // Loop through each carrier
+        pthread_mutex_destroy(&pool->carriers[i].mutex); // Destroy the carrier mutex
+        pthread_cond_destroy(&pool->carriers[i].cond); // Destroy the carrier condition variable
+        free(pool->carriers[i].timers); // Free the timer heap
+    }
+    free(pool->fibers); // Free the fiber array
+    free(pool->carriers); // Free the carriers
+    free(pool); // Free the pool
+}
+
+// Fiber running on the calling thread (NULL on a plain thread)
+Fiber *fiber_current(void) {
+    return current_fiber; // Set by the carrier around every switch
+}
+
+// Park the current fiber on a wait list; the mutex protecting the list is released while parked and held again on return
+void fiber_wait(FiberWaitList *list, pthread_mutex_t *mutex) {
+    Fiber *fiber = current_fiber; // Fiber going to sleep
+    fiber->next = NULL; // The fiber becomes the tail
+    if (list->tail) { // If the list is not empty
+        list->tail->next = fiber; // Link after the tail
+    } else {
+        list->head = fiber; // The fiber starts the list
+    }
+    list->tail = fiber; // Update the tail
+    pthread_mutex_unlock(mutex); // A waker may now queue the fiber; its carrier only resumes it after the switch below
+    swapcontext(&fiber->context, &fiber->carrier->context); // Park until woken
+    pthread_mutex_lock(mutex); // Re-acquire the mutex like pthread_cond_wait
+}
+
+// Wake the first fiber of a wait list (list mutex held)
+void fiber_wake_one(FiberWaitList *list) {
+    Fiber *fiber = list->head; // First parked fiber
+    if (fiber == NULL) { // If nothing is parked
+        return;
+    }
+    list->head = fiber->next; // Remove it from the list
+    if (list->head == NULL) { // If the list became empty
+        list->tail = NULL;
+    }
+    fiber_ready(fiber); // Let its carrier run it
+}
+
+// Wake every fiber of a wait list (list mutex held)
+void fiber_wake_all(FiberWaitList *list) {
+    while (list->head) { // Until the list is empty
+        fiber_wake_one(list); // Wake the first fiber
+    }
+}
+
+// Park the current fiber until an absolute CLOCK_MONOTONIC time
+void fiber_sleep_until(const struct timespec *deadline) {
+    Fiber *fiber = current_fiber; // Fiber going to sleep
+    Carrier *carrier = fiber->carrier; // Carrier owning the timer heap
+    fiber->wake_ns = (long long)deadline->tv_sec * NSEC_PER_SEC + deadline->tv_nsec; // Deadline in nanoseconds
+    pthread_mutex_lock(&carrier->mutex); // Lock the carrier
+    timer_push(carrier, fiber); // Queue the fiber on the timer heap
+    pthread_mutex_unlock(&carrier->mutex); // Only this carrier pops its heap, and it is running this fiber
+    swapcontext(&fiber->context, &carrier->context); // Park until the deadline
+}
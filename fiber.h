@@ -0,0 +1,33 @@
+//
+// User-level fibers multiplexed on a few carrier threads, with wait lists and deadline sleeps
+//
+#ifndef FIBER_H // If not defined, define FIBER_H to prevent multiple inclusions
+#define FIBER_H // Define FIBER_H
+
+#include <pthread.h> // Include pthread library for threading
+#include <time.h> // Include time library for struct timespec
+
+#define FIBER_STACK_SIZE (256 * 1024) // Stack reserved per fiber (committed lazily by the kernel)
+
+typedef struct Fiber Fiber; // One fiber (opaque)
+typedef struct FiberPool FiberPool; // Carrier threads and the fibers pinned to them (opaque)
+
+// Define the FiberWaitList structure (fibers parked on a condition, protected by the caller's mutex)
+typedef struct FiberWaitList {
+    Fiber *head; // First parked fiber
+    Fiber *tail; // Last parked fiber
+} FiberWaitList;
+
+FiberPool *fiber_pool_create(int threads); // Function prototype for creating a pool of carrier threads (not started yet)
+int fiber_spawn(FiberPool *pool, void *(*entry)(void *), void *arg); // Function prototype for adding a fiber, pinned round-robin to a carrier
+int fiber_pool_run(FiberPool *pool); // Function prototype for running every fiber to completion on the carriers
+void fiber_pool_destroy(FiberPool *pool); // Function prototype for releasing the pool and the fiber stacks
+int fiber_pool_threads(const FiberPool *pool); // Function prototype for reading the number of carrier threads
+
+Fiber *fiber_current(void); // Function prototype for the fiber running on the calling thread (NULL on a plain thread)
+void fiber_wait(FiberWaitList *list, pthread_mutex_t *mutex); // Function prototype for parking the current fiber on a list (mutex held, re-acquired on wakeup)
+void fiber_wake_one(FiberWaitList *list); // Function prototype for waking the first fiber of a list (list mutex held)
+void fiber_wake_all(FiberWaitList *list); // Function prototype for waking every fiber of a list (list mutex held)
+void fiber_sleep_until(const struct timespec *deadline); // Function prototype for parking the current fiber until an absolute CLOCK_MONOTONIC time
+
+#endif // FIBER_H // End of include guard
@@ -0,0 +1,411 @@
+//
+// Hierarchical fair-share groups: CPU time is split between groups by weight, then any policy picks within a group
+//
+#include "group.h" // Include the group header file
+#include "scheduler.h" // Include the scheduler header file for the context and queues
+
+// Link two PCBs of the ready queue, or make one the head or tail when the other is NULL (mutex held)
+static void group_link(Queue *ready, PCB *left, PCB *right) {
+    if (left) { // If there is a left neighbour
+        PCB_SET_NEXT(left, right);
+    } else {
+        ready->head = right; // The right PCB starts the queue
+    }
+    if (right) { // If there is a right neighbour
+        PCB_SET_PREV(right, left);
+    } else {
+        ready->tail = left; // The left PCB ends the queue
+    }
+}
+
+// Swap the context's SoA ready set with a leaf's, so the inner policy indexes and searches only that leaf
+static void group_swap_set(SchedulerContext *ctx, SchedGroup *leaf) {
+    ReadySet set = ctx->ready_set; // Set of the context
+    ctx->ready_set = leaf->ready_set;
+    leaf->ready_set = set;
+}
+
+// Time a group gets its quota back, or 0 while it still has some in the current period
+static sim_time_t group_throttled_until(const SchedGroup *group, sim_time_t now) {
+    sim_time_t refill = (group->period_index + 1) * group->period; // End of the period the usage belongs to
+    if (group->quota == 0 || group->period_used < group->quota || refill <= now) { // If the group may still run
+        return 0;
+    }
+    return refill; // Return the start of the next period
+}
+
+// Whether a group should be picked over the best so far: runnable groups first, then the earliest refill, then the least virtual runtime
+static int group_better(const SchedGroup *group, sim_time_t until, const SchedGroup *best, sim_time_t best_until) {
+    if (best == NULL) { // If nothing was picked yet
+        return 1;
+    }
+    if ((until == 0) != (best_until == 0)) { // If only one of them is throttled
+        return until == 0;
+    }
+    if (until != best_until) { // If both are throttled until different times
+        return until < best_until;
+    }
+    return group->vruntime < best->vruntime; // The group that used less of its share
+}
+
+// Pick the leaf whose run of the ready queue the inner policy picks from, or the earliest-refilled one when every candidate is throttled
+static PCB *group_pick(SchedulerContext *ctx) {
+    GroupTable *table = ctx->groups; // Groups of the simulation
+    sim_time_t now = __atomic_load_n(&ctx->current_time, __ATOMIC_SEQ_CST); // Quotas are judged in the nominal time runs are charged in
+    sim_time_t release = 0; // Earliest time the picked PCB may start (0 = now)
+    int leaf = -1; // Leaf group picked
+    for (int parent = -1; leaf < 0;) { // Descend from the top level
+        int best = -1; // Child picked at this level
+        sim_time_t best_until = 0; // When the picked child gets its quota back (0 = not throttled)
+        for (int g = 0; g < table->count; g++) { // Loop through each group
+            SchedGroup *group = &table->groups[g]; // Candidate group
+            if (group->parent != parent || group->ready == 0) { // If it is not a child with ready work
+                continue;
+            }
+            sim_time_t until = group_throttled_until(group, now); // Throttled groups only run when nothing else can
+            if (group_better(group, until, best < 0 ? NULL : &table->groups[best], best_until)) { // If it should run before the best so far
+                best = g;
+                best_until = until;
+            }
+        }
+        SchedGroup *chosen = &table->groups[best]; // A group with ready work always has a child with ready work
+        sim_time_t *floor = parent < 0 ? &table->vruntime_floor : &table->groups[parent].vruntime_floor; // Virtual clock of the level
+        if (chosen->vruntime > *floor) { // Advance it to the child picked
+            *floor = chosen->vruntime;
+        }
+        if (best_until > release) { // If the group or an ancestor is out of quota
+            release = best_until; // The CPU idles until it refills
+        }
+        if (chosen->children == 0) { // If the group holds processes
+            leaf = best;
+        } else {
+            parent = best; // Pick among its children
+        }
+    }
+
+    // Present the leaf's run as the whole ready queue to the inner policy, then splice what is left back in place
+    SchedGroup *group = &table->groups[leaf]; // Leaf picked
+    Queue *ready = &ctx->ready_queue; // Ready queue holding every group's run
+    PCB *before = PCB_PREV(group->first), *after = PCB_NEXT(group->last); // Neighbours of the run
+    PCB *head = ready->head, *tail = ready->tail; // Ends of the whole queue
+    PCB_SET_PREV(group->first, NULL); // Cut the run out
+    PCB_SET_NEXT(group->last, NULL);
+    ready->head = group->first; // The length stays the total, which queue_unlink keeps right
+    ready->tail = group->last;
+    group_swap_set(ctx, group); // Let SoA policies search the leaf's set
+    PCB *pcb = table->inner->pick_next(ctx); // Let the inner policy pick and unlink a PCB
+    group_swap_set(ctx, group); // Restore the context's set
+    group->first = ready->head; // What is left of the run
+    group->last = ready->tail;
+    ready->head = head; // Restore the ends (group_link fixes them when the run was at an end)
+    ready->tail = tail;
+    if (group->first) { // If the run is not empty
+        group_link(ready, before, group->first); // Splice it back
+        group_link(ready, group->last, after);
+    } else {
+        group_link(ready, before, after); // Close the gap
+    }
+    for (int g = leaf; g >= 0; g = table->groups[g].parent) { // Uncount it up the tree
+        table->groups[g].ready--;
+    }
+    if (release > pcb->ready_time) { // If the group is throttled
+        pcb->waiting_time += release - pcb->ready_time; // It waits in the ready queue until the quota refills
+        pcb->ready_time = release; // The CPU starts it no earlier
+    }
+    return pcb; // Return the picked PCB
+}
+
+// Move a PCB appended at the tail into its leaf's run of the ready queue, index it and count it up the tree
+static void group_enqueue(SchedulerContext *ctx, PCB *pcb) {
+    GroupTable *table = ctx->groups; // Groups of the simulation
+    SchedGroup *leaf = &table->groups[pcb->group]; // Leaf the process belongs to
+    Queue *ready = &ctx->ready_queue; // Ready queue holding every group's run
+    if (leaf->last == NULL) { // If the leaf has no ready PCB
+        leaf->first = pcb; // The PCB starts a new run at the tail
+    } else if (leaf->last != PCB_PREV(pcb)) { // If the run ends elsewhere
+        PCB *after = PCB_NEXT(leaf->last); // PCB following the run
+        group_link(ready, PCB_PREV(pcb), NULL); // Take the PCB off the tail
+        group_link(ready, leaf->last, pcb); // Link it after the run
+        group_link(ready, pcb, after);
+    }
+    leaf->last = pcb; // The PCB ends the run
+    if (table->inner->on_enqueue) { // If the inner policy keeps its own ordering
+        group_swap_set(ctx, leaf); // Index the PCB in the leaf's set
+        table->inner->on_enqueue(ctx, pcb);
+        group_swap_set(ctx, leaf);
+    }
+    for (int g = pcb->group; g >= 0; g = table->groups[g].parent) { // Count it up the tree
+        SchedGroup *group = &table->groups[g]; // Group gaining a ready PCB
+        if (group->ready++ == 0) { // If the group wakes up from idle
+            sim_time_t floor = group->parent < 0 ? table->vruntime_floor : table->groups[group->parent].vruntime_floor; // Virtual clock of its level
+            if (group->vruntime < floor) { // It cannot claim the time it slept through
+                group->vruntime = floor;
+            }
+        }
+    }
+}
+
+// Pass a preemption on to the inner policy
+static void group_preempt(SchedulerContext *ctx, PCB *pcb, sim_time_t ran) {
+    const SchedPolicy *inner = __atomic_load_n(&ctx->groups->inner, __ATOMIC_ACQUIRE); // Policy picking within the groups (switches take the mutex)
+    if (inner->on_preempt) { // If it tracks preemptions
+        inner->on_preempt(ctx, pcb, ran);
+    }
+}
+
+// Cut the inner policy's slice to the quota left to the PCB's groups and reserve it, so CPUs dispatching at once share one quota
+static sim_time_t group_tick(SchedulerContext *ctx, PCB *pcb) {
+    GroupTable *table = ctx->groups; // Groups of the simulation
+    const SchedPolicy *inner = __atomic_load_n(&table->inner, __ATOMIC_ACQUIRE); // Policy picking within the groups (switches take the mutex)
+    sim_time_t slice = inner->on_tick ? inner->on_tick(ctx, pcb) : 0; // Slice of the inner policy
+    sim_time_t now = __atomic_load_n(&ctx->current_time, __ATOMIC_SEQ_CST); // Nominal time of the dispatch
+    if (pcb->ready_time > now) { // If the pick delayed it to a refill
+        now = pcb->ready_time;
+    }
+    pthread_mutex_lock(&ctx->ready_queue.mutex); // The quotas are guarded by the ready queue mutex
+    for (int g = pcb->group; g >= 0; g = table->groups[g].parent) { // Loop through the leaf and its ancestors
+        SchedGroup *group = &table->groups[g]; // Group whose quota applies
+        if (group->quota == 0) { // If the group is not limited
+            continue;
+        }
+        sim_time_t period = now / group->period; // Period the run starts in
+        if (period > group->period_index) { // If a new period began
+            group->period_index = period; // Start its usage afresh
+            group->period_used = 0;
+        }
+        sim_time_t left = group->quota - group->period_used; // Quota neither used nor reserved by runs in progress
+        if (left < 1) { // Another CPU used it up meanwhile
+            left = 1; // Still make progress
+        }
+        if (slice == 0 || left < slice) { // If the quota ends first
+            slice = left;
+        }
+    }
+    pcb->quota_reserved = 0; // Nothing is reserved unless a group is limited
+    for (int g = pcb->group; g >= 0; g = table->groups[g].parent) { // Loop through the leaf and its ancestors again
+        SchedGroup *group = &table->groups[g]; // Group whose quota applies
+        if (group->quota > 0) { // If the group is limited
+            group->period_used += slice; // Reserve the slice; group_ran replaces it with the time actually run
+            pcb->quota_reserved = slice;
+        }
+    }
+    pthread_mutex_unlock(&ctx->ready_queue.mutex); // Unlock the ready queue mutex
+    return slice; // Return the slice
+}
+
+// Charge a run to the PCB's groups: virtual runtime, quota and utilization
+static void group_ran(SchedulerContext *ctx, PCB *pcb, sim_time_t start, sim_time_t ran) {
+    GroupTable *table = ctx->groups; // Groups of the simulation
+    const SchedPolicy *inner = __atomic_load_n(&table->inner, __ATOMIC_ACQUIRE); // Policy picking within the groups (switches take the mutex)
+    if (inner->on_ran) { // If the inner policy tracks runs
+        inner->on_ran(ctx, pcb, start, ran);
+    }
+    pthread_mutex_lock(&ctx->ready_queue.mutex); // The groups are guarded by the ready queue mutex
+    for (int g = pcb->group; g >= 0; g = table->groups[g].parent) { // Loop through the leaf and its ancestors
+        SchedGroup *group = &table->groups[g]; // Group to charge
+        __atomic_store_n(&group->busy_time, group->busy_time + ran, __ATOMIC_RELAXED); // Written under the mutex, read without it
+        group->vruntime += ran * GROUP_WEIGHT_DEFAULT / group->weight; // Heavier groups age slower
+        if (group->quota == 0) { // If the group is not limited
+            continue;
+        }
+        sim_time_t period = start / group->period; // Period the run started in
+        if (period > group->period_index) { // If a new period began (the reservation went with the old one)
+            group->period_index = period; // Start its usage afresh
+            group->period_used = 0;
+        } else { // Release the reservation group_tick made
+            group->period_used = group->period_used > pcb->quota_reserved ? group->period_used - pcb->quota_reserved : 0;
+        }
+        int had_quota = group->period_used < group->quota; // Whether this run used the quota up
+        group->period_used += ran; // Account the run
+        if (had_quota && group->period_used >= group->quota) { // If the group is now throttled
+            sim_time_t refill = (group->period_index + 1) * group->period; // End of the period
+            __atomic_store_n(&group->throttles, group->throttles + 1, __ATOMIC_RELAXED); // Count the throttled period
+            if (refill > start + ran) { // If the period is not over yet
+                __atomic_store_n(&group->throttled_time, group->throttled_time + refill - (start + ran), __ATOMIC_RELAXED); // Account the time out of quota
+            }
+        }
+    }
+    pthread_mutex_unlock(&ctx->ready_queue.mutex); // Unlock the ready queue mutex
+}
+
+const SchedPolicy group_policy = {"GROUP", group_pick, group_enqueue, group_preempt, group_tick, group_ran}; // Fair-share groups over an inner policy
+
+// Check that a group name is a non-empty path of [A-Za-z0-9_.-] components
+static int group_name_valid(const char *name) {
+    if (*name == '\0' || *name == '/' || strlen(name) >= GROUP_NAME_MAX || name[strlen(name) - 1] == '/' || strstr(name, "//")) { // If a component is empty or the path too long
+        return 0;
+    }
+    for (const char *c = name; *c; c++) { // Loop through each character
+        if (!(*c >= 'a' && *c <= 'z') && !(*c >= 'A' && *c <= 'Z') && !(*c >= '0' && *c <= '9') && !strchr("_.-/", *c)) { // If it could break the report or a metric label
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Index of a group by its full path in a definition array (-1 if absent)
+static int group_index(const SchedGroup *groups, int count, const char *name, int length) {
+    for (int g = 0; g < count; g++) { // Loop through each group
+        if (strncmp(groups[g].name, name, length) == 0 && groups[g].name[length] == '\0') { // If the path matches
+            return g;
+        }
+    }
+    return -1; // Unknown group
+}
+
+// Parse one "name[:weight[:quota:period]]" entry into a group (0 on success)
+static int group_parse_entry(char *entry, SchedGroup *groups, int *count) {
+    char *fields[4] = {entry, NULL, NULL, NULL}; // Name, weight, quota and period
+    int field_count = 1; // Number of fields found
+    for (char *c = entry; *c; c++) { // Split at the colons
+        if (*c == ':') { // If a field ends
+            if (field_count == 4) { // Too many fields
+                return -1;
+            }
+            *c = '\0'; // Terminate the field
+            fields[field_count++] = c + 1;
+        }
+    }
+    if (field_count == 3 || !group_name_valid(fields[0])) { // A quota needs its period
+        return -1;
+    }
+    int g = group_index(groups, *count, fields[0], strlen(fields[0])); // Redefining "default" sets its weight and quota
+    if (g > 0) { // Any other group may only be defined once
+        return -1;
+    }
+    SchedGroup group = {.parent = -1, .weight = GROUP_WEIGHT_DEFAULT}; // Top-level group with the default weight
+    snprintf(group.name, sizeof(group.name), "%s", fields[0]); // Copy the path
+    char *slash = strrchr(fields[0], '/'); // Last separator of the path
+    if (slash && ((group.parent = group_index(groups, *count, fields[0], slash - fields[0])) <= 0)) { // The parent must come first and not be "default"
+        return -1;
+    }
+    if (fields[1]) { // If the weight is given
+        char *end; // End of the weight
+        long weight = strtol(fields[1], &end, 10); // Parse it
+        if (end == fields[1] || *end != '\0' || weight < 1 || weight > GROUP_WEIGHT_MAX) { // If it is malformed
+            return -1;
+        }
+        group.weight = (int)weight;
+    }
+    if (fields[2] && (sim_time_parse(fields[2], &group.quota) != 0 || sim_time_parse(fields[3], &group.period) != 0 || group.quota <= 0 || group.period <= 0)) { // Parse the quota and period
+        return -1;
+    }
+    if (g == 0) { // If redefining "default"
+        groups[0].weight = group.weight; // Keep its place at index 0
+        groups[0].quota = group.quota;
+        groups[0].period = group.period;
+        return 0;
+    }
+    if (*count >= GROUP_MAX) { // If PCBs could not name the group
+        return -1;
+    }
+    if (group.parent >= 0) { // If the group is nested
+        groups[group.parent].children++; // Its parent no longer holds processes
+    }
+    groups[(*count)++] = group; // Add the group
+    return 0;
+}
+
+// Parse "name[:weight[:quota:period]],..." into group definitions, led by the implicit "default" group (NULL if malformed)
+SchedGroup *group_parse(const char *spec, int *count) {
+    int entries = 1; // Entries in the list, plus "default"
+    for (const char *c = spec; *c; c++) { // Count the separators
+        entries += *c == ',';
+    }
+    SchedGroup *groups = calloc(entries + 1, sizeof(SchedGroup)); // One group per entry, plus "default"
+    char *copy = strdup(spec); // Writable copy to split
+    if (!groups || !copy) { // If the allocation failed
+        free(groups);
+        free(copy);
+        return NULL;
+    }
+    groups[0] = (SchedGroup){.name = "default", .parent = -1, .weight = GROUP_WEIGHT_DEFAULT}; // Processes naming no group land here
+    *count = 1; // Number of groups defined
+    char *save = NULL; // strtok_r state
+    for (char *entry = strtok_r(copy, ",", &save); entry; entry = strtok_r(NULL, ",", &save)) { // Loop through each entry
+        char text[GROUP_NAME_MAX * 2]; // Entry as given, for the diagnostic (parsing splits it)
+        snprintf(text, sizeof(text), "%s", entry);
+        if (group_parse_entry(entry, groups, count) != 0) { // If it is malformed
+            fprintf(stderr, "Invalid group definition: %s\n", text); // Print an error message
+            free(groups);
+            free(copy);
+            return NULL;
+        }
+    }
+    free(copy); // Free the copy
+    return groups; // Return the definitions
+}
+
+// Switch the policy picking within the groups and rebuild every leaf's SoA set from its run, in queue order (mutex held)
+void group_set_inner(SchedulerContext *ctx, const SchedPolicy *inner) {
+    GroupTable *table = ctx->groups; // Groups of the simulation
+    __atomic_store_n(&table->inner, inner, __ATOMIC_RELEASE); // Hooks called outside the mutex read it atomically
+    for (int g = 0; g < table->count; g++) { // Loop through each group
+        SchedGroup *leaf = &table->groups[g]; // Candidate leaf
+        rs_clear(&leaf->ready_set); // Drop the old policy's index
+        if (leaf->first == NULL || !inner->on_enqueue) { // If there is nothing to index
+            continue;
+        }
+        group_swap_set(ctx, leaf); // Index the run in the leaf's set
+        for (PCB *pcb = leaf->first;; pcb = PCB_NEXT(pcb)) { // Walk the run
+            inner->on_enqueue(ctx, pcb);
+            if (pcb == leaf->last) { // The run ends here
+                break;
+            }
+        }
+        group_swap_set(ctx, leaf);
+    }
+}
+
+// Give a simulation its own copy of the groups, with empty runs and SoA sets
+GroupTable *group_table_create(const SchedGroup *groups, int count, const SchedPolicy *inner) {
+    GroupTable *table = calloc(1, sizeof(GroupTable)); // The table
+    if (!table || !(table->groups = malloc(count * sizeof(SchedGroup)))) { // If the allocation failed
+        free(table);
+        return NULL;
+    }
+    memcpy(table->groups, groups, count * sizeof(SchedGroup)); // Copy the definitions
+    table->count = count;
+    table->inner = inner; // Policy picking within the groups
+    for (int g = 0; g < count; g++) { // Loop through each group
+        rs_init(&table->groups[g].ready_set); // Start with an empty SoA set
+    }
+    return table; // Return the table
+}
+
+// Release a group table (the PCBs belong to the ready queue)
+void group_table_destroy(GroupTable *table) {
+    if (!table) { // If there is nothing to release
+        return;
+    }
+    for (int g = 0; g < table->count; g++) { // Loop through each group
+        rs_destroy(&table->groups[g].ready_set); // Release its SoA set
+    }
+    free(table->groups); // Free the groups
+    free(table); // Free the table
+}
+
+// Look up a leaf group by its full path (-1 if unknown or not a leaf)
+int group_find(const GroupTable *table, const char *name, int length) {
+    int g = group_index(table->groups, table->count, name, length); // Group with that path
+    return g >= 0 && table->groups[g].children == 0 ? g : -1; // Only leaves hold processes
+}
+
+// Print the utilization and throttling of every group
+void group_report(const SchedulerContext *ctx, FILE *out) {
+    const GroupTable *table = ctx->groups; // Groups of the simulation
+    double capacity = (double)ctx->total_time * (ctx->cpu_count ? ctx->cpu_count : 1); // CPU time available over the run
+    fprintf(out, "Fair-share groups            : %d\n", table->count);
+    for (int g = 0; g < table->count; g++) { // One line per group
+        const SchedGroup *group = &table->groups[g]; // Group to report
+        char label[GROUP_NAME_MAX + 16]; // Path and weight of the group
+        snprintf(label, sizeof(label), "Group %s (w%d)", group->name, group->weight);
+        fprintf(out, "%-29s: %.3f%% CPU, %.3f%% of busy time", label, capacity > 0 ? group->busy_time / capacity * 100 : 0.0,
+                ctx->busy_time > 0 ? (double)group->busy_time / ctx->busy_time * 100 : 0.0);
+        if (group->quota > 0) { // If the group is limited
+            fprintf(out, ", quota %.3f / %.3f ms, %llu throttled periods (%.3f ms)", SIM_TIME_TO_MS(group->quota), SIM_TIME_TO_MS(group->period),
+                    group->throttles, SIM_TIME_TO_MS(group->throttled_time));
+        }
+        fprintf(out, "\n");
+    }
+}
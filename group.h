@@ -0,0 +1,62 @@
+//
+// Hierarchical fair-share groups: CPU time is split between groups by weight, then any policy picks within a group
+//
+#ifndef GROUP_H // If not defined, define GROUP_H to prevent multiple inclusions
+#define GROUP_H // Define GROUP_H
+
+#include <stdio.h> // Include standard I/O library
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+#include "pcb.h" // Include the process control block header file
+#include "policy.h" // Include the scheduling policy header file
+#include "ready_set.h" // Include the structure-of-arrays ready set header file
+
+#define GROUP_NAME_MAX 64 // Longest group path accepted (including the NUL)
+#define GROUP_MAX 65535 // Most groups a PCB can name (the compact layout stores the index in 16 bits)
+#define GROUP_WEIGHT_DEFAULT 100 // Weight of a group that does not set one (as cgroup cpu.weight)
+#define GROUP_WEIGHT_MAX 10000 // Largest weight accepted
+
+struct SchedulerContext; // Simulation the groups belong to
+
+// Define the SchedGroup structure (definition from -groups, then per-simulation state guarded by the ready queue mutex)
+typedef struct SchedGroup {
+    char name[GROUP_NAME_MAX]; // Path of the group ("parent/child"); group 0 is "default"
+    int parent; // Index of the parent group (-1 = top level)
+    int children; // Number of child groups (0 = leaf, the only groups that hold processes)
+    int weight; // Share of the parent's CPU time relative to the siblings
+    sim_time_t quota; // CPU time the group and its descendants may use per period (0 = unlimited)
+    sim_time_t period; // Length of a quota period
+
+    // Scheduling state
+    int ready; // Ready PCBs in the group and its descendants
+    sim_time_t vruntime; // CPU time used, scaled by GROUP_WEIGHT_DEFAULT / weight (compared between siblings)
+    sim_time_t vruntime_floor; // Virtual runtime of the child picked last (where a child waking up from idle starts)
+    PCB *first; // First ready PCB of the group's run of the ready queue (leaf only)
+    PCB *last; // Last ready PCB of that run
+    ReadySet ready_set; // SoA index of the group's ready PCBs (SJF-SOA and PR-SOA only)
+    sim_time_t period_index; // Quota period the usage below belongs to
+    sim_time_t period_used; // CPU time used in that period
+
+    // Metrics (written under the ready queue mutex, readable without it)
+    sim_time_t busy_time; // CPU time used by the group and its descendants
+    unsigned long long throttles; // Periods in which the group ran out of quota
+    sim_time_t throttled_time; // Time from running out of quota to the end of those periods
+} SchedGroup;
+
+// Define the GroupTable structure (the groups of one simulation)
+typedef struct GroupTable {
+    SchedGroup *groups; // Groups, parents before their children
+    int count; // Number of groups
+    const SchedPolicy *inner; // Policy picking a process within a leaf group
+    sim_time_t vruntime_floor; // Virtual runtime of the top-level group picked last
+} GroupTable;
+
+extern const SchedPolicy group_policy; // Picks a leaf group by weight and quota, then delegates to the inner policy
+
+SchedGroup *group_parse(const char *spec, int *count); // Function prototype for parsing "name[:weight[:quota:period]],..." into group definitions (NULL if malformed)
+GroupTable *group_table_create(const SchedGroup *groups, int count, const SchedPolicy *inner); // Function prototype for giving a simulation its own copy of the groups
+void group_table_destroy(GroupTable *table); // Function prototype for releasing a group table
+void group_set_inner(struct SchedulerContext *ctx, const SchedPolicy *inner); // Function prototype for switching the policy within the groups (ready queue mutex held)
+int group_find(const GroupTable *table, const char *name, int length); // Function prototype for looking up a leaf group by path (-1 if unknown or not a leaf)
+void group_report(const struct SchedulerContext *ctx, FILE *out); // Function prototype for printing the utilization and throttling of every group
+
+#endif // GROUP_H // End of include guard
@@ -0,0 +1,82 @@
+//
+// Pluggable I/O scheduling policies deciding the order io_queue requests reach the device
+//
+#include "io_policy.h" // Include the I/O policy header file
+#include "scheduler.h" // Include the scheduler header file
+
+// Serve the oldest request (FIFO)
+static PCB *io_pick_head(SchedulerContext *ctx, sim_time_t now) {
+    (void)now; // Arrival order does not depend on the device time
+    PCB *pcb = ctx->io_queue.head; // Oldest request
+    queue_unlink(&ctx->io_queue, pcb); // Remove it from the queue
+    return pcb; // Return the picked PCB
+}
+
+// Serve the request with the shortest I/O burst (SIOF)
+static PCB *io_pick_shortest(SchedulerContext *ctx, sim_time_t now) {
+    (void)now; // Burst lengths do not depend on the device time
+    PCB *shortest = ctx->io_queue.head; // Pointer to the shortest request
+    for (PCB *current = PCB_NEXT(shortest); current != NULL; current = PCB_NEXT(current)) { // Iterate through the queue
+        if (current->remaining < shortest->remaining) { // Find the shortest burst
+            shortest = current; // Update the shortest request
+        }
+    }
+    queue_unlink(&ctx->io_queue, shortest); // Remove it from the queue
+    return shortest; // Return the picked PCB
+}
+
+// Serve an expired read, then an expired write, then the shortest read, then the shortest write (DEADLINE)
+static PCB *io_pick_deadline(SchedulerContext *ctx, sim_time_t now) {
+    PCB *oldest[2] = {NULL, NULL}; // Oldest read and oldest write
+    PCB *shortest[2] = {NULL, NULL}; // Shortest read and shortest write
+    for (PCB *current = ctx->io_queue.head; current != NULL; current = PCB_NEXT(current)) { // Iterate through the queue
+        int write = PCB_IS_WRITE(current); // Direction of the request
+        if (oldest[write] == NULL || current->ready_time < oldest[write]->ready_time) { // Find the oldest request
+            oldest[write] = current;
+        }
+        if (shortest[write] == NULL || current->remaining < shortest[write]->remaining) { // Find the shortest request
+            shortest[write] = current;
+        }
+    }
+    sim_time_t expire[2] = {ctx->args.io_read_expire, ctx->args.io_write_expire}; // How long each direction may wait
+    PCB *pick = NULL; // Request to serve
+    for (int write = 0; write < 2 && pick == NULL; write++) { // Reads expire first
+        if (oldest[write] && now - oldest[write]->ready_time >= expire[write]) { // If the request waited past its deadline
+            pick = oldest[write]; // Serve it before anything else
+        }
+    }
+    if (pick == NULL) { // If nothing has expired
+        pick = shortest[0] ? shortest[0] : shortest[1]; // Prefer reads, which processes block on first
+    }
+    queue_unlink(&ctx->io_queue, pick); // Remove it from the queue
+    return pick; // Return the picked PCB
+}
+
+// Serve the request of the highest-priority process, oldest first among equals (PRIO)
+static PCB *io_pick_highest_priority(SchedulerContext *ctx, sim_time_t now) {
+    (void)now; // Priorities do not depend on the device time
+    PCB *highest = ctx->io_queue.head; // Pointer to the highest priority request
+    for (PCB *current = PCB_NEXT(highest); current != NULL; current = PCB_NEXT(current)) { // Iterate through the queue
+        if (current->priority > highest->priority) { // Find the highest priority
+            highest = current; // Update the highest priority request
+        }
+    }
+    queue_unlink(&ctx->io_queue, highest); // Remove it from the queue
+    return highest; // Return the picked PCB
+}
+
+const IoPolicy io_fifo_policy = {"FIFO", io_pick_head}; // First-in first-out
+const IoPolicy io_sif_policy = {"SIOF", io_pick_shortest}; // Shortest I/O first
+const IoPolicy io_deadline_policy = {"DEADLINE", io_pick_deadline}; // Read/write expiry
+const IoPolicy io_prio_policy = {"PRIO", io_pick_highest_priority}; // Priority-aware
+
+// Look up an I/O policy by the name given to -io-alg (NULL if unknown)
+const IoPolicy *io_policy_find(const char *name) {
+    const IoPolicy *builtins[] = {&io_fifo_policy, &io_sif_policy, &io_deadline_policy, &io_prio_policy}; // Built-in I/O policies
+    for (size_t i = 0; name != NULL && i < sizeof(builtins) / sizeof(builtins[0]); i++) { // Loop through each policy
+        if (strcmp(name, builtins[i]->name) == 0) { // If the name matches
+            return builtins[i]; // Return the policy
+        }
+    }
+    return NULL; // Unknown policy
+}
@@ -0,0 +1,26 @@
+//
+// Pluggable I/O scheduling policies deciding the order io_queue requests reach the device
+//
+#ifndef IO_POLICY_H // If not defined, define IO_POLICY_H to prevent multiple inclusions
+#define IO_POLICY_H // Define IO_POLICY_H
+
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+
+struct PCB; // Process control block
+struct SchedulerContext; // Simulation the policy runs in
+
+// Define the IoPolicy structure (the I/O thread asks it for the next request whenever the device has capacity)
+typedef struct IoPolicy {
+    const char *name; // Name selected with -io-alg
+    // Unlink and return the next request to serve; called with the I/O queue mutex held and the queue non-empty; now is the device time
+    struct PCB *(*pick_next)(struct SchedulerContext *ctx, sim_time_t now);
+} IoPolicy;
+
+extern const IoPolicy io_fifo_policy; // Serve requests in arrival order
+extern const IoPolicy io_sif_policy; // Shortest I/O burst first
+extern const IoPolicy io_deadline_policy; // Reads before writes, expired requests before both
+extern const IoPolicy io_prio_policy; // Highest process priority first
+
+const IoPolicy *io_policy_find(const char *name); // Function prototype for looking up an I/O policy by name
+
+#endif // IO_POLICY_H // End of include guard
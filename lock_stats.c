@@ -0,0 +1,23 @@
+//
+// Queue lock instrumentation, compiled in with -DSCHED_LOCK_STATS (make LOCK_STATS=1)
+//
+#include "lock_stats.h" // Include the lock statistics header file
+
+// Average of a total over a count, in microseconds
+static double average_us(long long total_ns, unsigned long long count) {
+    return count ? total_ns / 1000.0 / count : 0.0; // Avoid dividing by zero
+}
+
+// Print the summary of one queue
+void lock_stats_report(FILE *out, const char *name, const LockStats *stats) {
+    fprintf(out, "Lock stats (%s queue)\n", name);
+    fprintf(out, "  Acquisitions               : %llu (%llu contended, %.2f%%)\n", stats->acquisitions, stats->contended,
+            stats->acquisitions ? 100.0 * stats->contended / stats->acquisitions : 0.0);
+    fprintf(out, "  Wait time                  : %.3f ms total, %.3f us avg, %.3f us max\n",
+            stats->wait_ns / 1e6, average_us(stats->wait_ns, stats->acquisitions), stats->max_wait_ns / 1e3);
+    fprintf(out, "  Hold time                  : %.3f ms total, %.3f us avg, %.3f us max\n",
+            stats->hold_ns / 1e6, average_us(stats->hold_ns, stats->acquisitions + stats->wakeups), stats->max_hold_ns / 1e3);
+    fprintf(out, "  Condvar wakeups            : %llu (%llu spurious)\n", stats->wakeups, stats->spurious_wakeups);
+    fprintf(out, "  Enqueue-to-dequeue handoff : %llu PCBs, %.3f us avg, %.3f us max\n",
+            stats->handoffs, average_us(stats->handoff_ns, stats->handoffs), stats->max_handoff_ns / 1e3);
+}
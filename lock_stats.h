@@ -0,0 +1,74 @@
+//
+// Queue lock instrumentation, compiled in with -DSCHED_LOCK_STATS (make LOCK_STATS=1)
+//
+#ifndef LOCK_STATS_H // If not defined, define LOCK_STATS_H to prevent multiple inclusions
+#define LOCK_STATS_H // Define LOCK_STATS_H
+
+#include <stdio.h> // Include standard I/O library
+#include <time.h> // Include time library for clock_gettime
+
+// Define the LockStats structure (updated with the queue mutex held, except the report)
+typedef struct LockStats {
+    unsigned long long acquisitions; // Times the mutex was acquired
+    unsigned long long contended; // Acquisitions that had to block
+    long long wait_ns; // Real time spent acquiring the mutex
+    long long max_wait_ns; // Longest acquisition
+    long long hold_ns; // Real time the mutex was held
+    long long max_hold_ns; // Longest hold
+    long long held_since_ns; // When the current holder acquired the mutex
+    unsigned long long wakeups; // Returns from the condition variable
+    unsigned long long spurious_wakeups; // Returns after which the waited-for condition still held
+    unsigned long long handoffs; // PCBs taken out of the queue
+    long long handoff_ns; // Real time PCBs spent in the queue
+    long long max_handoff_ns; // Longest time a PCB spent in the queue
+} LockStats;
+
+// Read the monotonic clock in nanoseconds
+static inline long long lock_stats_now(void) {
+    struct timespec now; // Current monotonic time
+    clock_gettime(CLOCK_MONOTONIC, &now); // Read the clock
+    return now.tv_sec * 1000000000LL + now.tv_nsec; // Convert to nanoseconds
+}
+
+// Add a sample to a total and keep the maximum
+static inline void lock_stats_add(long long *total, long long *max, long long sample) {
+    *total += sample; // Accumulate the sample
+    if (sample > *max) { // If it is the largest so far
+        *max = sample; // Remember it
+    }
+}
+
+void lock_stats_report(FILE *out, const char *name, const LockStats *stats); // Function prototype for printing the summary of one queue
+
+#ifdef SCHED_LOCK_STATS
+#define LOCK_STATS_FIELD LockStats lock_stats; // Per-queue statistics
+#define PCB_LOCK_STATS_FIELD long long enqueued_ns; // When the PCB was appended to its queue
+#define LOCK_STATS_START(var) long long var = lock_stats_now() // Timestamp before acquiring
+#define LOCK_STATS_ACQUIRED(stats, start, blocked) do { \
+        long long now_ = lock_stats_now(); \
+        (stats)->acquisitions++; \
+        (stats)->contended += (blocked); \
+        lock_stats_add(&(stats)->wait_ns, &(stats)->max_wait_ns, now_ - (start)); \
+        (stats)->held_since_ns = now_; \
+    } while (0)
+#define LOCK_STATS_RELEASING(stats) lock_stats_add(&(stats)->hold_ns, &(stats)->max_hold_ns, lock_stats_now() - (stats)->held_since_ns)
+#define LOCK_STATS_WOKEN(stats) do { (stats)->held_since_ns = lock_stats_now(); (stats)->wakeups++; } while (0)
+#define LOCK_STATS_SPURIOUS(stats) ((stats)->spurious_wakeups++)
+#define LOCK_STATS_ENQUEUED(pcb) ((pcb)->enqueued_ns = lock_stats_now())
+#define LOCK_STATS_HANDOFF(stats, pcb) do { \
+        (stats)->handoffs++; \
+        lock_stats_add(&(stats)->handoff_ns, &(stats)->max_handoff_ns, lock_stats_now() - (pcb)->enqueued_ns); \
+    } while (0)
+#else
+#define LOCK_STATS_FIELD
+#define PCB_LOCK_STATS_FIELD
+#define LOCK_STATS_START(var) do { } while (0)
+#define LOCK_STATS_ACQUIRED(stats, start, blocked) do { } while (0)
+#define LOCK_STATS_RELEASING(stats) do { } while (0)
+#define LOCK_STATS_WOKEN(stats) do { } while (0)
+#define LOCK_STATS_SPURIOUS(stats) do { } while (0)
+#define LOCK_STATS_ENQUEUED(pcb) do { } while (0)
+#define LOCK_STATS_HANDOFF(stats, pcb) do { } while (0)
+#endif // SCHED_LOCK_STATS
+
+#endif // LOCK_STATS_H // End of include guard
@@ -2,19 +2,85 @@
 // Created by 006li on 7/9/2024.
 //
 #include "scheduler.h" // Include the scheduler header file
+#include "checkpoint.h" // Include the checkpoint header file
+#include "batch.h" // Include the batch mode header file
+#include "des.h" // Include the virtual-time engine header file
+#include "ramp.h" // Include the load ramp header file
 
 // Global variables to store command line arguments
 char *algorithm = NULL; // Pointer to the scheduling algorithm
 char *input_file = NULL; // Pointer to the input file name
-int quantum = 0; // Time quantum for Round Robin scheduling
+char *input_dir = NULL; // Directory of traces to run as a batch
+char *input_list = NULL; // File listing traces to run as a batch
+int jobs = 0; // Batch worker threads (0 = one per online CPU)
+int runs = 1; // Concurrent runs of the input file, sharing one parsed workload image
+char *image_out = NULL; // File the parsed workload image of the input file is saved to
+char *ramp = NULL; // Load ramp "start:step:steps" run over the proc lines of the input file
+RampSpec ramp_spec = {0, 0, 0, 10000 * SIM_TIME_PER_MS, 1}; // Parsed load ramp (10 s windows, seed 1 unless set)
+int parse_threads = 0; // Threads pre-parsing the trace (0 = read line by line)
+char *service_path = NULL; // FIFO or socket commands are served from
+int service_fifo = 0; // The service path is a named pipe
+sim_time_t quantum = 0; // Time quantum for Round Robin scheduling
+sim_time_t switch_cost = 0; // CPU time of a context switch
+sim_time_t warmup_cost = 0; // Extra CPU time of the first run after a preemption
+sim_time_t migrate_cost = 0; // Extra CPU time of a run on another CPU than the last one
+int cpus = 1; // Simulated CPUs sharing the ready queue
+int fiber_threads = 0; // Carrier threads for the fiber backend (0 = an OS thread per worker)
+int des_threads = 0; // Worker threads of the virtual-time engine (0 = real-time engine)
+int des_partitions = 1; // CPU partitions of the virtual-time engine
+char *cpu_speed_list = NULL; // Comma-separated speed factor of each CPU
+double *cpu_speeds = NULL; // Parsed speed factors (NULL = 1.0 for every CPU)
+char *balance = "NONE"; // Load-balancing policy of the virtual-time engine
+sim_time_t balance_every = 10 * SIM_TIME_PER_MS; // Simulated time between migration passes
+char *group_list = NULL; // Comma-separated fair-share group definitions
+SchedGroup *groups = NULL; // Parsed group definitions (NULL = no groups)
+int group_count = 0; // Number of parsed group definitions
+int io_depth = 1; // Number of I/O bursts served concurrently (0 = unlimited)
+char *io_algorithm = "FIFO"; // I/O scheduling algorithm
+sim_time_t io_read_expire = 500 * SIM_TIME_PER_MS; // How long a read may wait under DEADLINE
+sim_time_t io_write_expire = 5000 * SIM_TIME_PER_MS; // How long a write may wait under DEADLINE
+sim_time_t io_tick = SIM_TIME_PER_MS; // Length of one I/O timing wheel tick
+double speed = 1.0; // Time-dilation factor (simulated ms per real ms)
+char *checkpoint_file = NULL; // Snapshot file written periodically
+sim_time_t checkpoint_every = 1000 * SIM_TIME_PER_MS; // Simulated time between snapshots
+char *resume_file = NULL; // Snapshot to resume from
+sim_time_t sample_every = 0; // Simulated time between metric samples (0 = off)
+int sample_json = 0; // Emit samples as JSON records
+char *sample_file = NULL; // File the samples are written to (stderr by default)
+char *results_file = NULL; // CSV receiving a row per finished process
 
-// Metrics
-int total_time = 0; // Total time taken
-int busy_time = 0; // Time when CPU is busy
-int process_count = 0; // Number of processes
-int total_turnaround_time = 0; // Sum of turnaround times of all processes
-int total_waiting_time = 0; // Sum of waiting times of all processes
-int current_time = 0; // Current time
+int metrics_port = 0; // Localhost port serving Prometheus metrics (0 = off)
+char *metrics_file = NULL; // Prometheus textfile rewritten periodically
+sim_time_t metrics_every = 1000 * SIM_TIME_PER_MS; // Simulated time between textfile rewrites
+
+int verbose = 1; // Print a line for every scheduling event
+
+// Parse a comma-separated speed factor per CPU (missing entries are 1.0); NULL if malformed
+static double *parse_cpu_speeds(const char *list, int cpus) {
+    double *speeds = malloc(cpus * sizeof(double)); // One factor per CPU
+    if (!speeds) { // If the allocation failed
+        return NULL;
+    }
+    const char *cursor = list; // Next factor to parse
+    for (int i = 0; i < cpus; i++) { // Loop through each CPU
+        speeds[i] = 1.0; // Nominal unless listed
+        if (*cursor == '\0') { // If the list ended
+            continue;
+        }
+        char *end; // End of the factor
+        speeds[i] = strtod(cursor, &end); // Parse it
+        if (end == cursor || speeds[i] <= 0 || (*end != ',' && *end != '\0')) { // If it is malformed
+            free(speeds); // Reject the list
+            return NULL;
+        }
+        cursor = *end == ',' ? end + 1 : end; // Move past the separator
+    }
+    if (*cursor != '\0') { // More factors than CPUs
+        free(speeds); // Reject the list
+        return NULL;
+    }
+    return speeds; // Return the factors
+}
 
 // Function to parse command line arguments
 void parse_arguments(int argc, char *argv[]) {
@@ -25,59 +91,280 @@ void parse_arguments(int argc, char *argv[]) {
         } else if (strcmp(argv[i], "-input") == 0 && i + 1 < argc) { // Check for input file flag
             input_file = argv[i + 1]; // Set the input file
             i++; // Skip next argument
+        } else if (strcmp(argv[i], "-input-dir") == 0 && i + 1 < argc) { // Check for batch directory flag
+            input_dir = argv[i + 1]; // Set the batch directory
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-input-list") == 0 && i + 1 < argc) { // Check for batch list flag
+            input_list = argv[i + 1]; // Set the batch list file
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-jobs") == 0 && i + 1 < argc) { // Check for batch worker flag
+            jobs = atoi(argv[i + 1]); // Set the number of batch workers
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) { // Check for repeated run flag
+            runs = atoi(argv[i + 1]); // Set the number of runs
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-image-out") == 0 && i + 1 < argc) { // Check for workload image flag
+            image_out = argv[i + 1]; // Set the image file
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-ramp") == 0 && i + 1 < argc) { // Check for load ramp flag
+            ramp = argv[i + 1]; // Set the ramp
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-ramp-window") == 0 && i + 1 < argc) { // Check for ramp window flag
+            if (sim_time_parse(argv[i + 1], &ramp_spec.window) != 0) { // Set the window (optional unit suffix)
+                ramp_spec.window = 0; // Reject malformed windows below
+            }
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-ramp-seed") == 0 && i + 1 < argc) { // Check for ramp seed flag
+            ramp_spec.seed = strtoull(argv[i + 1], NULL, 10); // Set the seed
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-parse-threads") == 0 && i + 1 < argc) { // Check for parallel pre-parse flag
+            parse_threads = atoi(argv[i + 1]); // Set the number of parser threads
+            i++; // Skip next argument
+        } else if ((strcmp(argv[i], "-socket") == 0 || strcmp(argv[i], "-fifo") == 0) && i + 1 < argc) { // Check for service mode flags
+            service_fifo = strcmp(argv[i], "-fifo") == 0; // Named pipe or UNIX domain socket
+            service_path = argv[i + 1]; // Set the endpoint
+            i++; // Skip next argument
         } else if (strcmp(argv[i], "-quantum") == 0 && i + 1 < argc) { // Check for quantum flag
-            quantum = atoi(argv[i + 1]); // Set the quantum value
+            if (sim_time_parse(argv[i + 1], &quantum) != 0) { // Set the quantum value (optional unit suffix)
+                quantum = 0; // Reject malformed quanta below
+            }
+            i++; // Skip next argument
+        } else if ((strcmp(argv[i], "-switch-cost") == 0 || strcmp(argv[i], "-warmup-cost") == 0 || strcmp(argv[i], "-migrate-cost") == 0) && i + 1 < argc) { // Check for dispatch cost flags
+            sim_time_t *cost = argv[i][1] == 's' ? &switch_cost : argv[i][1] == 'w' ? &warmup_cost : &migrate_cost; // Cost being set
+            if (sim_time_parse(argv[i + 1], cost) != 0) { // Set the cost (optional unit suffix)
+                *cost = -1; // Reject malformed costs below
+            }
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-cpus") == 0 && i + 1 < argc) { // Check for CPU count flag
+            cpus = atoi(argv[i + 1]); // Set the number of simulated CPUs
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-fibers") == 0 && i + 1 < argc) { // Check for fiber backend flag
+            fiber_threads = atoi(argv[i + 1]); // Set the number of carrier threads
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-des-threads") == 0 && i + 1 < argc) { // Check for virtual-time engine flag
+            des_threads = atoi(argv[i + 1]); // Set the number of engine workers
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-des-partitions") == 0 && i + 1 < argc) { // Check for CPU partition flag
+            des_partitions = atoi(argv[i + 1]); // Set the number of CPU partitions
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-cpu-speeds") == 0 && i + 1 < argc) { // Check for CPU speed flag
+            cpu_speed_list = argv[i + 1]; // Set the speed list (parsed once the CPU count is known)
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-balance") == 0 && i + 1 < argc) { // Check for load-balancing flag
+            balance = argv[i + 1]; // Set the load-balancing policy
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-balance-every") == 0 && i + 1 < argc) { // Check for migration interval flag
+            if (sim_time_parse(argv[i + 1], &balance_every) != 0) { // Set the interval (optional unit suffix)
+                balance_every = 0; // Reject malformed intervals below
+            }
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-groups") == 0 && i + 1 < argc) { // Check for fair-share group flag
+            group_list = argv[i + 1]; // Set the group definitions
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-io-depth") == 0 && i + 1 < argc) { // Check for I/O depth flag
+            io_depth = atoi(argv[i + 1]); // Set the I/O concurrency
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-io-alg") == 0 && i + 1 < argc) { // Check for I/O algorithm flag
+            io_algorithm = argv[i + 1]; // Set the I/O algorithm
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-io-read-expire") == 0 && i + 1 < argc) { // Check for read expiry flag
+            if (sim_time_parse(argv[i + 1], &io_read_expire) != 0) { // Set the read expiry (optional unit suffix)
+                io_read_expire = -1; // Reject malformed expiries below
+            }
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-io-write-expire") == 0 && i + 1 < argc) { // Check for write expiry flag
+            if (sim_time_parse(argv[i + 1], &io_write_expire) != 0) { // Set the write expiry (optional unit suffix)
+                io_write_expire = -1; // Reject malformed expiries below
+            }
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-speed") == 0 && i + 1 < argc) { // Check for time-dilation flag
+            speed = atof(argv[i + 1]); // Set the time-dilation factor
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-io-tick") == 0 && i + 1 < argc) { // Check for I/O tick flag
+            if (sim_time_parse(argv[i + 1], &io_tick) != 0) { // Set the I/O tick length (optional unit suffix)
+                io_tick = 0; // Reject malformed ticks below
+            }
             i++; // Skip next argument
+        } else if (strcmp(argv[i], "-checkpoint") == 0 && i + 1 < argc) { // Check for checkpoint file flag
+            checkpoint_file = argv[i + 1]; // Set the snapshot file
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-checkpoint-every") == 0 && i + 1 < argc) { // Check for checkpoint interval flag
+            if (sim_time_parse(argv[i + 1], &checkpoint_every) != 0) { // Set the interval (optional unit suffix)
+                checkpoint_every = 0; // Reject malformed intervals below
+            }
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-resume") == 0 && i + 1 < argc) { // Check for resume flag
+            resume_file = argv[i + 1]; // Set the snapshot to resume from
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-sample") == 0 && i + 1 < argc) { // Check for sampling interval flag
+            if (sim_time_parse(argv[i + 1], &sample_every) != 0 || sample_every == 0) { // Set the interval (optional unit suffix)
+                sample_every = -1; // Reject malformed intervals below
+            }
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-sample-json") == 0) { // Check for JSON sample flag
+            sample_json = 1; // Emit JSON records
+        } else if (strcmp(argv[i], "-sample-out") == 0 && i + 1 < argc) { // Check for sample file flag
+            sample_file = argv[i + 1]; // Set the sample file
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-results") == 0 && i + 1 < argc) { // Check for per-process results flag
+            results_file = argv[i + 1]; // Set the results file
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-metrics-port") == 0 && i + 1 < argc) { // Check for metrics port flag
+            metrics_port = atoi(argv[i + 1]); // Set the HTTP port
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-metrics-file") == 0 && i + 1 < argc) { // Check for metrics textfile flag
+            metrics_file = argv[i + 1]; // Set the textfile
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-metrics-every") == 0 && i + 1 < argc) { // Check for textfile interval flag
+            if (sim_time_parse(argv[i + 1], &metrics_every) != 0) { // Set the interval (optional unit suffix)
+                metrics_every = 0; // Reject malformed intervals below
+            }
+            i++; // Skip next argument
+        } else if (strcmp(argv[i], "-quiet") == 0) { // Check for quiet flag
+            verbose = 0; // Only print the final metrics
         }
     }
 
     // Check for required arguments and valid values
-    if (algorithm == NULL || input_file == NULL ||
-        (strcmp(algorithm, "RR") == 0 && quantum == 0)) {
-        fprintf(stderr, "Usage: %s -alg [FIFO|SJF|PR|RR] [-quantum [integer (ms)]] -input [file name]\n", argv[0]);
+    int batch = input_dir || input_list; // Running many traces on a worker pool
+    if (policy_find(algorithm) == NULL || io_policy_find(io_algorithm) == NULL || (input_file != NULL) + (service_path != NULL) + batch != 1 ||
+        (service_path && (checkpoint_file || resume_file)) || cpus < 1 || fiber_threads < 0 || (service_path && fiber_threads) ||
+        ((cpus > 1 || fiber_threads) && (checkpoint_file || resume_file)) ||
+        des_threads < 0 || des_partitions < 1 || des_partitions > cpus ||
+        switch_cost < 0 || warmup_cost < 0 || migrate_cost < 0 || ((switch_cost || warmup_cost || migrate_cost) && (checkpoint_file || resume_file)) ||
+        (cpus >= 1 && cpu_speed_list && !(cpu_speeds = parse_cpu_speeds(cpu_speed_list, cpus))) ||
+        des_balance_find(balance) < 0 || (des_balance_find(balance) != SCHED_BALANCE_NONE && !des_threads) || balance_every <= 0 ||
+        (des_threads && (service_path || fiber_threads || checkpoint_file || resume_file || sample_every || metrics_port || metrics_file)) ||
+        (group_list && (!(groups = group_parse(group_list, &group_count)) || des_threads || checkpoint_file || resume_file)) ||
+        (batch && (checkpoint_file || resume_file || sample_every || metrics_port || metrics_file)) || jobs < 0 ||
+        (ramp && (ramp_parse(ramp, &ramp_spec) != 0 || !input_file || checkpoint_file || resume_file || sample_every || metrics_port || metrics_file)) || ramp_spec.window <= 0 ||
+        runs < 1 || ((runs > 1 || image_out) && (!input_file || ramp)) || (runs > 1 && (checkpoint_file || resume_file || sample_every || metrics_port || metrics_file)) ||
+        (results_file && (batch || ramp || runs > 1)) ||
+        (strcmp(algorithm, "RR") == 0 && quantum == 0) || parse_threads < 0 || io_depth < 0 || io_read_expire < 0 || io_write_expire < 0 || speed <= 0 || io_tick <= 0 || checkpoint_every <= 0 || sample_every < 0 ||
+        metrics_port < 0 || metrics_port > 65535 || metrics_every <= 0) {
+        fprintf(stderr, "Usage: %s -alg [FIFO|SJF|PR|RR|SJF-SOA|PR-SOA] [-quantum [time (ms|us|ns|s, default ms)]] [-switch-cost [time]] [-warmup-cost [time]] [-migrate-cost [time]] [-cpus [integer]] [-fibers [carrier threads]] [-cpu-speeds [factor,...]] [-des-threads [integer (0 = real time)] [-des-partitions [integer]] [-balance [NONE|SPEED|LOAD] [-balance-every [time]]]] [-groups [name[:weight[:quota:period]],...]] [-io-depth [integer (0 = unlimited)]] [-io-tick [time]] [-speed [factor]] "
+                        "[-io-alg [FIFO|SIOF|DEADLINE|PRIO] [-io-read-expire [time]] [-io-write-expire [time]]] "
+                        "[-checkpoint [file name] [-checkpoint-every [time]]] [-resume [file name]] "
+                        "[-sample [time] [-sample-json] [-sample-out [file name]]] [-parse-threads [integer (0 = read line by line)]] "
+                        "[-metrics-port [port]] [-metrics-file [file name] [-metrics-every [time]]] [-results [file name]] [-quiet] "
+                        "(-input [file or image name] [-image-out [file name]] [-runs [integer] [-jobs [integer]]] [-ramp [start:step:steps (processes / ms)] [-ramp-window [time]] [-ramp-seed [integer]] [-jobs [integer]]] | -socket [path] | -fifo [path] | (-input-dir [directory] | -input-list [file name]) [-jobs [integer (0 = one per CPU)]])\n", argv[0]);
         exit(EXIT_FAILURE); // Exit if arguments are not valid
     }
 }
 
+// Run every trace of -input-dir and -input-list, or -runs copies of -input, on a worker pool and print one consolidated table
+static int run_batch(SchedulerArgs *scheduler_args) {
+    BatchInputs inputs = {NULL, 0}; // Traces of the batch
+    if (runs > 1 && (inputs.files = calloc(runs, sizeof(char *))) != NULL) { // If repeating one workload
+        while (inputs.count < runs && (inputs.files[inputs.count] = strdup(input_file)) != NULL) { // Every run replays the shared image
+            inputs.count++;
+        }
+    }
+    if ((runs > 1 && inputs.count < runs) || (input_dir && batch_collect_dir(&inputs, input_dir) != 0) || (input_list && batch_collect_list(&inputs, input_list) != 0)) { // Collect the traces
+        batch_inputs_free(&inputs); // Release what was collected
+        return EXIT_FAILURE; // Exit if the batch cannot be listed
+    }
+    if (inputs.count == 0) { // If there is nothing to run
+        fprintf(stderr, "No input files found\n"); // Print an error message
+        return EXIT_FAILURE; // Exit without an empty table
+    }
+    BatchResult *results = malloc(inputs.count * sizeof(BatchResult)); // One result per trace
+    if (!results) { // If the allocation failed
+        perror("Failed to allocate memory for batch results"); // Print an error message
+        batch_inputs_free(&inputs); // Release the traces
+        return EXIT_FAILURE; // Exit if the results cannot be kept
+    }
+    int workers = jobs > 0 ? jobs : batch_default_workers(); // Size the pool
+    scheduler_args->verbose = 0; // Interleaved per-event lines from concurrent runs would be unreadable
+    double wall_seconds; // Real time the batch took
+    int failed = batch_run(scheduler_args, &inputs, workers, results, &wall_seconds); // Run every trace
+    batch_print_results(scheduler_args, results, inputs.count, workers, wall_seconds, stdout); // Output the consolidated table
+    pcb_report(stdout); // Print the PCB layout and memory per process across the batch
+    free(results); // Free the results
+    batch_inputs_free(&inputs); // Release the traces
+    return failed ? EXIT_FAILURE : 0; // Fail the batch if any run failed
+}
+
+// Run one simulation per load ramp step over Poisson arrivals drawn from the input file and print where it saturates
+static int run_ramp(SchedulerArgs *scheduler_args) {
+    int workers = jobs > 0 ? jobs : batch_default_workers(); // Size the pool
+    scheduler_args->verbose = 0; // Interleaved per-event lines from concurrent runs would be unreadable
+    int failed = ramp_run(scheduler_args, &ramp_spec, workers, stdout); // Run every step
+    pcb_report(stdout); // Print the PCB layout and memory per process across the ramp
+    return failed ? EXIT_FAILURE : 0; // Fail the ramp if any run failed
+}
+
 // Main function
 int main(int argc, char *argv[]) {
     parse_arguments(argc, argv); // Parse command line arguments
 
-    SchedulerArgs scheduler_args = {algorithm, quantum}; // Set scheduler arguments
-
-    pthread_t file_thread, cpu_thread, io_thread; // Declare thread variables
-    pthread_create(&file_thread, NULL, file_read_thread, (void *)input_file); // Create file reading thread
-    pthread_create(&cpu_thread, NULL, cpu_scheduler_thread, (void *)&scheduler_args); // Create CPU scheduling thread
-    pthread_create(&io_thread, NULL, io_system_thread, NULL); // Create I/O system thread
-
-    pthread_join(file_thread, NULL); // Wait for file thread to finish
-    pthread_join(cpu_thread, NULL); // Wait for CPU thread to finish
-    pthread_join(io_thread, NULL); // Wait for I/O thread to finish
-
-    // Output performance metrics
-    total_time = current_time; // Set total time to current time
-    float cpu_utilization = (float)busy_time / total_time * 100; // Calculate CPU utilization
-    float throughput = (float)process_count / total_time; // Calculate throughput (processes per ms)
-    float avg_turnaround_time = (float)total_turnaround_time / process_count; // Calculate average turnaround time
-    float avg_waiting_time = (float)total_waiting_time / process_count; // Calculate average waiting time
-
-    // Print metrics
-    printf("Input File Name              : %s\n", input_file);
-    printf("CPU Scheduling Alg           : %s\n", algorithm);
-    if (strcmp(algorithm, "RR") == 0) {
-        printf("Quantum                      : %d ms\n", quantum);
-    }
-    printf("CPU utilization              : %.3f%%\n", cpu_utilization);
-    printf("Throughput                   : %.3f processes / ms\n", throughput);
-    printf("Avg. Turnaround time         : %.1fms\n", avg_turnaround_time);
-    printf("Avg. Waiting time in R queue : %.1fms\n", avg_waiting_time);
+    SchedulerArgs scheduler_args = {
+        .input_file = input_file, .parse_threads = parse_threads,
+        .service_path = service_path, .service_fifo = service_fifo,
+        .algorithm = algorithm, .quantum = quantum,
+        .switch_cost = switch_cost, .warmup_cost = warmup_cost, .migrate_cost = migrate_cost,
+        .cpus = cpus, .fiber_threads = fiber_threads,
+        .des_threads = des_threads, .des_partitions = des_partitions,
+        .cpu_speeds = cpu_speeds, .balance = des_balance_find(balance), .balance_every = balance_every,
+        .groups = groups, .group_count = group_count,
+        .io_depth = io_depth, .io_tick = io_tick, .speed = speed,
+        .io_algorithm = io_algorithm, .io_read_expire = io_read_expire, .io_write_expire = io_write_expire,
+        .checkpoint_file = checkpoint_file, .checkpoint_every = checkpoint_every,
+        .sample_every = sample_every, .sample_json = sample_json, .sample_out = stderr,
+        .metrics_port = metrics_port, .metrics_file = metrics_file, .metrics_every = metrics_every,
+        .verbose = verbose}; // Set scheduler arguments
+    Workload *workload = NULL; // Parsed image of the input file (NULL = stream the trace)
+    if (input_file && !ramp && (image_out || runs > 1 || workload_is_image(input_file))) { // If the trace is parsed once up front
+        if (!(workload = workload_open(input_file)) || (image_out && workload_save(workload, image_out) != 0)) { // Parse or map it
+            exit(EXIT_FAILURE); // Exit if the image is unusable
+        }
+        scheduler_args.workload = workload; // Every run replays it
+    }
+    if (input_dir || input_list || runs > 1) { // If running a batch
+        int status = run_batch(&scheduler_args); // Run every trace on the worker pool
+        workload_close(workload); // Release the image
+        return status;
+    }
+    if (ramp) { // If ramping the load
+        return run_ramp(&scheduler_args); // Run every step on the worker pool
+    }
+    if (sample_file && !(scheduler_args.sample_out = fopen(sample_file, "w"))) { // Open the sample file
+        perror("Failed to open sample file"); // Print an error message
+        exit(EXIT_FAILURE); // Exit if the samples cannot be written
+    }
+    SchedulerContext ctx; // The simulation
+    scheduler_init(&ctx, &scheduler_args); // Create empty queues, clock and metrics
+    long results_offset = -1; // Length of the results file covered by the snapshot (-1 = start a new file)
+    if (resume_file) { // If resuming from a snapshot
+        CheckpointPosition position; // Where the trace reader stood
+        if (checkpoint_load(&ctx, resume_file, &position) != 0) { // Restore queues, clocks and metrics
+            exit(EXIT_FAILURE); // Exit if the snapshot is unusable
+        }
+        ctx.args.resume_offset = position.trace_offset; // Continue reading after the checkpointed line
+        ctx.args.resume_time = position.read_time; // Continue from the checkpointed trace time
+        results_offset = position.results_offset; // Rows past it belong to processes the resumed run finishes again
+        printf("Resumed from %s at %.3f ms\n", resume_file, SIM_TIME_TO_MS(position.read_time)); // Print debug info
+    }
+    ResultsWriter results; // Writer of the per-process rows
+    if (results_file) { // If per-process rows are wanted
+        if (results_open(&results, results_file, results_offset) != 0) { // Start the writer (a resumed run appends to the rows written before the snapshot)
+            exit(EXIT_FAILURE); // Exit if the rows cannot be written
+        }
+        ctx.args.results = &results; // The completion paths feed it
+    }
 
-    // Debug prints to verify calculations
-    printf("Total time: %d ms\n", total_time);
-    printf("Busy time: %d ms\n", busy_time);
-    printf("Total turnaround time: %d ms\n", total_turnaround_time);
-    printf("Total waiting time: %d ms\n", total_waiting_time);
-    printf("Process count: %d\n", process_count);
+    int run_status = scheduler_run(&ctx); // Run the simulation to completion
+    if (sample_file) { // If the samples went to a file
+        fclose(scheduler_args.sample_out); // Close the sample file
+    }
+    int status = (results_file && results_close(&results) != 0) || run_status != 0 ? EXIT_FAILURE : 0; // Write the remaining rows
+    if (run_status == 0) { // A failed run has no meaningful metrics
+        scheduler_print_metrics(&ctx, stdout); // Output performance metrics
+    }
+    scheduler_destroy(&ctx); // Release the simulation
+    free(cpu_speeds); // Free the CPU speed factors
+    free(groups); // Free the group definitions
+    workload_close(workload); // Release the image
 
-    return 0; // Return success
+    return status; // Return success unless the run failed or rows were lost
 }
@@ -0,0 +1,221 @@
+//
+// Prometheus exposition of live counters and histograms (HTTP listener or textfile)
+//
+#include "metrics.h" // Include the metrics header file
+#include "scheduler.h" // Include the scheduler header file
+#include <arpa/inet.h> // Include htons and htonl
+#include <netinet/in.h> // Include sockaddr_in
+#include <sys/socket.h> // Include socket
+#include <sys/time.h> // Include struct timeval for the socket timeouts
+
+#define METRICS_REQUEST_MAX 1024 // Bytes of an HTTP request that are looked at
+#define METRICS_CLIENT_TIMEOUT_MS 1000 // Longest a scrape may stall sending its request or reading the response
+
+// Upper bounds of the finite buckets, in milliseconds of simulated time
+static const double bucket_ms[HISTOGRAM_BUCKETS] = {1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, HISTOGRAM_LAST_BOUND_MS};
+
+// Record one observation (safe to call from several threads)
+void histogram_observe(Histogram *histogram, sim_time_t value) {
+    int bucket = 0; // First bucket whose bound covers the value
+    while (bucket < HISTOGRAM_BUCKETS && SIM_TIME_TO_MS(value) > bucket_ms[bucket]) { // Skip the smaller buckets
+        bucket++;
+    }
+    __atomic_add_fetch(&histogram->buckets[bucket], 1, __ATOMIC_RELAXED); // Count the observation in its bucket
+    __atomic_add_fetch(&histogram->sum, value, __ATOMIC_RELAXED); // Add it to the sum
+    __atomic_add_fetch(&histogram->count, 1, __ATOMIC_RELAXED); // Count it
+}
+
+// Add the observations of one histogram to another
+void histogram_merge(Histogram *into, const Histogram *from) {
+    for (int bucket = 0; bucket <= HISTOGRAM_BUCKETS; bucket++) { // Loop through each bucket, +Inf included
+        __atomic_add_fetch(&into->buckets[bucket], from->buckets[bucket], __ATOMIC_RELAXED); // Add its count
+    }
+    __atomic_add_fetch(&into->sum, from->sum, __ATOMIC_RELAXED); // Add the sum
+    __atomic_add_fetch(&into->count, from->count, __ATOMIC_RELAXED); // Add the count
+}
+
+// Estimate a quantile by linear interpolation within its bucket, as Prometheus histogram_quantile does (-1 past the last finite bound)
+sim_time_t histogram_quantile(const Histogram *histogram, double quantile) {
+    double rank = quantile * histogram->count; // Observations at or below the quantile
+    unsigned long long cumulative = 0; // Observations up to the current bound
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) { // Loop through each finite bucket
+        unsigned long long below = cumulative; // Observations below the bucket
+        cumulative += histogram->buckets[i];
+        if (histogram->buckets[i] > 0 && cumulative >= rank) { // If the quantile falls in this bucket
+            double lower = i > 0 ? bucket_ms[i - 1] : 0; // Bounds of the bucket
+            double ms = lower + (bucket_ms[i] - lower) * (rank - below) / histogram->buckets[i]; // Spread its observations evenly
+            return (sim_time_t)(ms * SIM_TIME_PER_MS);
+        }
+    }
+    return histogram->count > 0 ? -1 : 0; // Only the +Inf bucket is left (or nothing was observed)
+}
+
+// Write a histogram in seconds of simulated time
+static void write_histogram(FILE *out, const char *name, const char *help, Histogram *histogram) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    unsigned long long cumulative = 0; // Observations up to the current bound
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) { // Loop through each finite bucket
+        cumulative += __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED); // Buckets are cumulative in the exposition
+        fprintf(out, "%s_bucket{le=\"%g\"} %llu\n", name, bucket_ms[i] / 1000.0, cumulative);
+    }
+    cumulative += __atomic_load_n(&histogram->buckets[HISTOGRAM_BUCKETS], __ATOMIC_RELAXED); // Add the +Inf bucket
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, cumulative);
+    fprintf(out, "%s_sum %.6f\n", name, (double)__atomic_load_n(&histogram->sum, __ATOMIC_RELAXED) / SIM_TIME_PER_SEC);
+    fprintf(out, "%s_count %llu\n", name, cumulative); // Count matches the +Inf bucket even while observations race
+}
+
+// Write every metric in Prometheus text exposition format; all values are read without locks
+void metrics_write(SchedulerContext *ctx, FILE *out) {
+    sim_time_t now = __atomic_load_n(&ctx->current_time, __ATOMIC_RELAXED); // Latest simulated time
+    fprintf(out, "# HELP sched_sim_time_seconds Simulated time reached.\n# TYPE sched_sim_time_seconds gauge\n");
+    fprintf(out, "sched_sim_time_seconds %.6f\n", (double)now / SIM_TIME_PER_SEC);
+    fprintf(out, "# HELP sched_dispatches_total PCBs dispatched to the CPU.\n# TYPE sched_dispatches_total counter\n");
+    fprintf(out, "sched_dispatches_total %llu\n", __atomic_load_n(&ctx->dispatches, __ATOMIC_RELAXED));
+    fprintf(out, "# HELP sched_preemptions_total Time slices that expired before the burst ended.\n# TYPE sched_preemptions_total counter\n");
+    fprintf(out, "sched_preemptions_total %llu\n", __atomic_load_n(&ctx->preemptions, __ATOMIC_RELAXED));
+    fprintf(out, "# HELP sched_policy_switches_total Policy lines applied while the simulation ran.\n# TYPE sched_policy_switches_total counter\n");
+    fprintf(out, "sched_policy_switches_total %llu\n", __atomic_load_n(&ctx->policy_switches, __ATOMIC_RELAXED));
+    fprintf(out, "# HELP sched_completions_total Processes that finished.\n# TYPE sched_completions_total counter\n");
+    fprintf(out, "sched_completions_total %d\n", __atomic_load_n(&ctx->process_count, __ATOMIC_RELAXED));
+    fprintf(out, "# HELP sched_active_processes Processes admitted but not yet finished.\n# TYPE sched_active_processes gauge\n");
+    fprintf(out, "sched_active_processes %d\n", __atomic_load_n(&ctx->active_processes, __ATOMIC_RELAXED));
+    fprintf(out, "# HELP sched_queue_depth PCBs waiting in a queue.\n# TYPE sched_queue_depth gauge\n");
+    fprintf(out, "sched_queue_depth{queue=\"ready\"} %d\n", __atomic_load_n(&ctx->ready_queue.length, __ATOMIC_RELAXED));
+    fprintf(out, "sched_queue_depth{queue=\"io\"} %d\n", __atomic_load_n(&ctx->io_queue.length, __ATOMIC_RELAXED));
+    fprintf(out, "# HELP sched_io_in_flight I/O bursts being served by the device.\n# TYPE sched_io_in_flight gauge\n");
+    fprintf(out, "sched_io_in_flight %d\n", __atomic_load_n(&ctx->io_wheel.count, __ATOMIC_RELAXED));
+    fprintf(out, "# HELP sched_cpu_busy_seconds_total Simulated time the CPU spent running bursts.\n# TYPE sched_cpu_busy_seconds_total counter\n");
+    fprintf(out, "sched_cpu_busy_seconds_total %.6f\n", (double)cpu_busy_at(ctx, now) / SIM_TIME_PER_SEC);
+    fprintf(out, "# HELP sched_cpu_overhead_seconds_total Simulated time CPUs spent switching context, warming caches and migrating.\n# TYPE sched_cpu_overhead_seconds_total counter\n");
+    fprintf(out, "sched_cpu_overhead_seconds_total %.6f\n", (double)__atomic_load_n(&ctx->overhead_time, __ATOMIC_RELAXED) / SIM_TIME_PER_SEC);
+    fprintf(out, "# HELP sched_lock_wait_seconds_total Real time threads spent blocked acquiring a queue mutex.\n# TYPE sched_lock_wait_seconds_total counter\n");
+    fprintf(out, "sched_lock_wait_seconds_total{queue=\"ready\"} %.9f\n", __atomic_load_n(&ctx->ready_queue.lock_wait_ns, __ATOMIC_RELAXED) / 1e9);
+    fprintf(out, "sched_lock_wait_seconds_total{queue=\"io\"} %.9f\n", __atomic_load_n(&ctx->io_queue.lock_wait_ns, __ATOMIC_RELAXED) / 1e9);
+    write_histogram(out, "sched_turnaround_seconds", "Simulated turnaround time of finished processes.", &ctx->turnaround_hist);
+    write_histogram(out, "sched_waiting_seconds", "Simulated ready-queue waiting time of finished processes.", &ctx->waiting_hist);
+    fprintf(out, "# HELP sched_io_requests_total I/O bursts admitted to the device.\n# TYPE sched_io_requests_total counter\n");
+    fprintf(out, "sched_io_requests_total{op=\"read\"} %llu\n", __atomic_load_n(&ctx->io_requests[0], __ATOMIC_RELAXED));
+    fprintf(out, "sched_io_requests_total{op=\"write\"} %llu\n", __atomic_load_n(&ctx->io_requests[1], __ATOMIC_RELAXED));
+    fprintf(out, "# HELP sched_io_wait_seconds_total Simulated time I/O requests waited in the I/O queue.\n# TYPE sched_io_wait_seconds_total counter\n");
+    fprintf(out, "sched_io_wait_seconds_total{op=\"read\"} %.6f\n", (double)__atomic_load_n(&ctx->io_wait_total[0], __ATOMIC_RELAXED) / SIM_TIME_PER_SEC);
+    fprintf(out, "sched_io_wait_seconds_total{op=\"write\"} %.6f\n", (double)__atomic_load_n(&ctx->io_wait_total[1], __ATOMIC_RELAXED) / SIM_TIME_PER_SEC);
+    write_histogram(out, "sched_io_wait_seconds", "Simulated I/O-queue waiting time of admitted requests.", &ctx->io_wait_hist);
+    if (ctx->groups) { // If processes share the CPUs by group
+        GroupTable *table = ctx->groups; // Groups of the simulation
+        fprintf(out, "# HELP sched_group_cpu_seconds_total Simulated CPU time used by a fair-share group and its descendants.\n# TYPE sched_group_cpu_seconds_total counter\n");
+        for (int g = 0; g < table->count; g++) { // Loop through each group
+            fprintf(out, "sched_group_cpu_seconds_total{group=\"%s\"} %.6f\n", table->groups[g].name,
+                    (double)__atomic_load_n(&table->groups[g].busy_time, __ATOMIC_RELAXED) / SIM_TIME_PER_SEC);
+        }
+        fprintf(out, "# HELP sched_group_throttled_periods_total Quota periods in which a fair-share group ran out of quota.\n# TYPE sched_group_throttled_periods_total counter\n");
+        for (int g = 0; g < table->count; g++) { // Loop through each group
+            fprintf(out, "sched_group_throttled_periods_total{group=\"%s\"} %llu\n", table->groups[g].name, __atomic_load_n(&table->groups[g].throttles, __ATOMIC_RELAXED));
+        }
+        fprintf(out, "# HELP sched_group_throttled_seconds_total Simulated time fair-share groups spent out of quota.\n# TYPE sched_group_throttled_seconds_total counter\n");
+        for (int g = 0; g < table->count; g++) { // Loop through each group
+            fprintf(out, "sched_group_throttled_seconds_total{group=\"%s\"} %.6f\n", table->groups[g].name,
+                    (double)__atomic_load_n(&table->groups[g].throttled_time, __ATOMIC_RELAXED) / SIM_TIME_PER_SEC);
+        }
+    }
+}
+
+// Rewrite the textfile through a temporary file so collectors never see a partial file
+int metrics_write_file(SchedulerContext *ctx, const char *path) {
+    char tmp_path[4096]; // Temporary file next to the textfile
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path); // Build the temporary path
+    FILE *file = fopen(tmp_path, "w"); // Open the temporary file
+    if (!file) { // If the file cannot be created
+        perror("Failed to open metrics file"); // Print an error message
+        return -1;
+    }
+    metrics_write(ctx, file); // Write the metrics
+    if (fclose(file) != 0 || rename(tmp_path, path) != 0) { // Flush and replace the textfile
+        perror("Failed to write metrics file"); // Print an error message
+        remove(tmp_path); // Drop the partial file
+        return -1;
+    }
+    return 0; // Success
+}
+
+// Textfile exporter thread function
+void *metrics_file_thread(void *arg) {
+    SchedulerContext *ctx = (SchedulerContext *)arg; // Get the simulation context from the argument
+    sim_time_t next = ctx->args.resume_time; // Absolute time of the next rewrite
+    while (!simulation_done(ctx)) { // Export until every process has finished
+        next += ctx->args.metrics_every; // Schedule the next rewrite
+        sim_clock_sleep_until(&ctx->clock, next); // Sleep until the absolute rewrite time (cancellation point at shutdown)
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL); // Never stop halfway through a rewrite
+        metrics_write_file(ctx, ctx->args.metrics_file); // Rewrite the textfile
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL); // Allow shutdown while sleeping again
+    }
+    pthread_exit(NULL); // Exit the thread
+}
+
+// Close the listening socket when the HTTP thread is cancelled
+static void close_listener(void *arg) {
+    close(*(int *)arg); // Close the socket
+}
+
+// Close an accepted connection when the HTTP thread is cancelled while reading its request
+static void close_client(void *arg) {
+    close(*(int *)arg); // Close the socket
+}
+
+// Answer one HTTP request: GET /metrics returns the exposition, anything else 404
+static void serve_request(SchedulerContext *ctx, int fd, const char *request) {
+    FILE *out = fdopen(fd, "w"); // Buffered response stream
+    if (out == NULL) { // If the stream cannot be created
+        close(fd); // Close the connection
+        return;
+    }
+    if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) { // If the metrics were asked for
+        fprintf(out, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+        metrics_write(ctx, out); // Write the metrics
+    } else {
+        fprintf(out, "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\nnot found\n");
+    }
+    fclose(out); // Flush and close the connection
+}
+
+// HTTP exporter thread function (listens on localhost only)
+void *metrics_http_thread(void *arg) {
+    SchedulerContext *ctx = (SchedulerContext *)arg; // Get the simulation context from the argument
+    int fd = socket(AF_INET, SOCK_STREAM, 0); // Create the listening socket
+    if (fd < 0) { // If the socket cannot be created
+        perror("Failed to create metrics socket"); // Print an error message
+        pthread_exit(NULL);
+    }
+    int reuse = 1; // Allow quick restarts on the same port
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr; // Listening address
+    memset(&addr, 0, sizeof(addr)); // Clear the address
+    addr.sin_family = AF_INET; // IPv4
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Localhost only
+    addr.sin_port = htons((unsigned short)ctx->args.metrics_port); // Configured port
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) { // Bind and listen
+        perror("Failed to listen on metrics port"); // Print an error message
+        close(fd); // Close the socket
+        pthread_exit(NULL);
+    }
+    pthread_cleanup_push(close_listener, &fd); // Close the socket when cancelled at shutdown
+    while (1) { // Serve until cancelled
+        int client = accept(fd, NULL, NULL); // Wait for a scrape (cancellation point)
+        if (client < 0) { // If the accept failed
+            continue; // Try again
+        }
+        struct timeval timeout = {METRICS_CLIENT_TIMEOUT_MS / 1000, METRICS_CLIENT_TIMEOUT_MS % 1000 * 1000}; // A silent or stalled client cannot hold the thread
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        char request[METRICS_REQUEST_MAX]; // Start of the request
+        ssize_t length; // Bytes received
+        pthread_cleanup_push(close_client, &client); // Close the connection if cancelled at shutdown
+        length = recv(client, request, sizeof(request) - 1, 0); // Read the request line and usually the headers (cancellation point)
+        pthread_cleanup_pop(0); // The connection is still needed for the response
+        request[length > 0 ? length : 0] = '\0'; // Terminate the request
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL); // Never stop halfway through a response
+        serve_request(ctx, client, request); // Answer the scrape
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL); // Allow shutdown while waiting again
+    }
+    pthread_cleanup_pop(1); // Unreachable; balances the push
+    pthread_exit(NULL);
+}
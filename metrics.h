@@ -0,0 +1,30 @@
+//
+// Prometheus exposition of live counters and histograms (HTTP listener or textfile)
+//
+#ifndef METRICS_H // If not defined, define METRICS_H to prevent multiple inclusions
+#define METRICS_H // Define METRICS_H
+
+#include <stdio.h> // Include standard I/O library
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+
+struct SchedulerContext; // Simulation the metrics describe
+
+#define HISTOGRAM_BUCKETS 12 // Finite buckets per histogram (plus +Inf)
+#define HISTOGRAM_LAST_BOUND_MS 10000 // Upper bound of the last finite bucket
+
+// Define the Histogram structure (cumulative buckets are computed when exporting)
+typedef struct Histogram {
+    unsigned long long buckets[HISTOGRAM_BUCKETS + 1]; // Observations per bucket (the last one is +Inf)
+    sim_time_t sum; // Sum of the observations
+    unsigned long long count; // Number of observations
+} Histogram;
+
+void histogram_observe(Histogram *histogram, sim_time_t value); // Function prototype for recording one observation without locks
+void histogram_merge(Histogram *into, const Histogram *from); // Function prototype for adding the observations of one histogram to another
+sim_time_t histogram_quantile(const Histogram *histogram, double quantile); // Function prototype for estimating a quantile from the buckets (-1 if it lies past the last finite bound)
+void metrics_write(struct SchedulerContext *ctx, FILE *out); // Function prototype for writing every metric in exposition format
+int metrics_write_file(struct SchedulerContext *ctx, const char *path); // Function prototype for atomically rewriting a textfile
+void *metrics_file_thread(void *arg); // Function prototype for the textfile exporter thread
+void *metrics_http_thread(void *arg); // Function prototype for the HTTP exporter thread
+
+#endif // METRICS_H // End of include guard
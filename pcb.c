@@ -0,0 +1,276 @@
+//
+// Process control blocks: a pointer-linked layout, or a compact pooled layout built with -DSCHED_COMPACT_PCB
+//
+#include "pcb.h" // Include the PCB header file
+#include <stdlib.h> // Include standard library
+#include <string.h> // Include string handling library
+#include <pthread.h> // Include pthread library for threading
+
+// Process-wide accounting behind the memory-per-process figure (updated atomically)
+static unsigned long long pcbs_allocated; // PCBs allocated since start-up
+static unsigned long long burst_bytes; // Burst storage allocated for those PCBs outside the PCB itself
+static long long pcbs_live; // PCBs currently allocated
+static long long pcbs_peak; // Most PCBs allocated at once
+
+// Count a newly allocated PCB
+static void count_alloc(void) {
+    __atomic_add_fetch(&pcbs_allocated, 1, __ATOMIC_RELAXED); // Count the allocation
+    long long live = __atomic_add_fetch(&pcbs_live, 1, __ATOMIC_RELAXED); // Count the live PCB
+    long long peak = __atomic_load_n(&pcbs_peak, __ATOMIC_RELAXED); // Current peak
+    while (live > peak && !__atomic_compare_exchange_n(&pcbs_peak, &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { // Raise the peak
+    }
+}
+
+#ifdef SCHED_COMPACT_PCB
+
+#define BURST_MS 0x02 // Packed value is in whole milliseconds
+#define BURST_WRITE 0x01 // Packed burst is a write request
+
+PCB *pcb_chunks[PCB_MAX_CHUNKS]; // Pool chunks (allocated on demand, never moved)
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER; // Mutex protecting the pool
+static uint32_t pool_free; // Head of the free list, linked through next (0 = empty)
+static uint32_t pool_next = 1; // Next never-used index (index 0 means NULL)
+
+// Allocate a zeroed, unlinked PCB from the pool
+PCB *pcb_alloc(void) {
+    pthread_mutex_lock(&pool_mutex); // Lock the pool
+    uint32_t index = pool_free; // Reuse a freed PCB first
+    if (index != 0) { // If the free list is not empty
+        pool_free = pcb_at(index)->next; // Pop it
+    } else {
+        index = pool_next; // Take a fresh index
+        uint32_t chunk = index >> PCB_CHUNK_BITS; // Chunk holding it
+        if (index == 0 || (pcb_chunks[chunk] == NULL && (pcb_chunks[chunk] = malloc(PCB_CHUNK_SIZE * sizeof(PCB))) == NULL)) { // If the pool is exhausted
+            pthread_mutex_unlock(&pool_mutex); // Unlock the pool
+            perror("Failed to allocate memory for PCB"); // Print an error message
+            return NULL;
+        }
+        pool_next++; // Wraps to 0 once all 2^32 - 1 indices are used
+    }
+    pthread_mutex_unlock(&pool_mutex); // Unlock the pool
+    PCB *pcb = pcb_at(index); // Resolve the slot
+    memset(pcb, 0, sizeof(*pcb)); // Clear the slot
+    pcb->index = index; // Remember its own index for linking
+    count_alloc(); // Account the allocation
+    return pcb; // Return the PCB
+}
+
+// Return a PCB to the pool and release spilled bursts
+void pcb_free(PCB *pcb) {
+    if (pcb == NULL) { // If there is nothing to free
+        return;
+    }
+    if (pcb->flags & PCB_FLAG_HEAP) { // If the bursts live on the heap
+        free(pcb->bursts.heap); // Free them
+    }
+    __atomic_sub_fetch(&pcbs_live, 1, __ATOMIC_RELAXED); // Count the release
+    pthread_mutex_lock(&pool_mutex); // Lock the pool
+    pcb->next = pool_free; // Push the slot onto the free list
+    pool_free = pcb->index;
+    pthread_mutex_unlock(&pool_mutex); // Unlock the pool
+}
+
+// Pack one burst: whole milliseconds when exact, two flag bits, LEB128 varint; returns the bytes written
+static int pack_burst(uint8_t *out, sim_time_t value, int write) {
+    uint64_t code = (uint64_t)value; // Value to encode
+    int ms = value % SIM_TIME_PER_MS == 0; // Trace bursts are usually whole milliseconds
+    code = ((ms ? code / SIM_TIME_PER_MS : code) << 2) | (ms ? BURST_MS : 0) | (write ? BURST_WRITE : 0); // Scale and tag
+    int length = 0; // Bytes written
+    do { // Seven bits per byte, high bit set while more follow
+        uint8_t byte = code & 0x7f; // Low seven bits
+        code >>= 7; // Drop them
+        if (out) { // If not just measuring
+            out[length] = byte | (code ? 0x80 : 0); // Store the byte
+        }
+        length++;
+    } while (code);
+    return length; // Return the size
+}
+
+// Unpack the burst at *offset and advance the offset
+static sim_time_t unpack_burst(const uint8_t *packed, uint16_t *offset, int *write) {
+    uint64_t code = 0; // Decoded varint
+    int shift = 0; // Bit position of the next seven bits
+    uint8_t byte; // Current byte
+    do { // Read seven bits per byte
+        byte = packed[(*offset)++]; // Next byte
+        code |= (uint64_t)(byte & 0x7f) << shift; // Add its bits
+        shift += 7;
+    } while (byte & 0x80);
+    *write = (code & BURST_WRITE) != 0; // Direction tag
+    sim_time_t value = (sim_time_t)(code >> 2); // Scaled value
+    return code & BURST_MS ? value * SIM_TIME_PER_MS : value; // Undo the scaling
+}
+
+// Packed bursts of a PCB
+static const uint8_t *packed_bursts(const PCB *pcb) {
+    return pcb->flags & PCB_FLAG_HEAP ? pcb->bursts.heap : pcb->bursts.bytes; // Heap or inline storage
+}
+
+// Store the bursts packed, inline when they fit; the first burst becomes current
+int pcb_set_bursts(PCB *pcb, const sim_time_t *bursts, const unsigned char *writes, int count) {
+    size_t size = 0; // Packed size
+    for (int i = 0; i < count; i++) { // Measure every burst
+        size += pack_burst(NULL, bursts[i], writes && (writes[i >> 3] >> (i & 7) & 1));
+    }
+    uint8_t *out = pcb->bursts.bytes; // Inline storage
+    if (size > PCB_INLINE_BYTES) { // If the bursts do not fit inline
+        if ((out = malloc(size)) == NULL) { // Spill them to the heap
+            perror("Failed to allocate memory for bursts"); // Print an error message
+            return -1;
+        }
+        pcb->bursts.heap = out;
+        pcb->flags |= PCB_FLAG_HEAP;
+        __atomic_add_fetch(&burst_bytes, size, __ATOMIC_RELAXED); // Account the spilled bytes
+    }
+    size_t offset = 0; // Write position
+    for (int i = 0; i < count; i++) { // Pack every burst
+        offset += pack_burst(out + offset, bursts[i], writes && (writes[i >> 3] >> (i & 7) & 1));
+    }
+    pcb->burst_count = count; // Set the burst count
+    pcb_seek(pcb, 0); // Start at the first burst
+    return 0; // Success
+}
+
+// Pack bursts that outlive the PCB like any others (the packed copy is usually inline, so nothing is gained by borrowing)
+int pcb_bind_bursts(PCB *pcb, const sim_time_t *bursts, const unsigned char *writes, int count) {
+    return pcb_set_bursts(pcb, bursts, writes, count); // Pack them
+}
+
+// Decode every burst and the write bitmap ((count + 7) / 8 bytes)
+void pcb_get_bursts(const PCB *pcb, sim_time_t *bursts, unsigned char *writes) {
+    memset(writes, 0, (pcb->burst_count + 7) / 8); // Start with every burst a read
+    uint16_t offset = 0; // Read position
+    for (int i = 0; i < pcb->burst_count; i++) { // Decode every burst
+        int write; // Direction of the burst
+        bursts[i] = unpack_burst(packed_bursts(pcb), &offset, &write);
+        writes[i >> 3] |= write << (i & 7); // Mark writes
+    }
+}
+
+// Make a burst current and load its length (decodes from the start)
+void pcb_seek(PCB *pcb, int burst) {
+    uint16_t offset = 0; // Read position
+    int write = 0; // Direction of the burst
+    sim_time_t value = 0; // Length of the burst
+    for (int i = 0; i <= burst && i < pcb->burst_count; i++) { // Decode up to the burst
+        value = unpack_burst(packed_bursts(pcb), &offset, &write);
+    }
+    pcb->current_burst = burst; // Set the current burst
+    pcb->burst_offset = offset; // Decoding continues after it
+    pcb->remaining = value; // Load its length
+    pcb->flags = (pcb->flags & ~PCB_FLAG_WRITE) | (write ? PCB_FLAG_WRITE : 0); // Load its direction
+}
+
+// Move to the next burst, decoding only that burst (0 when the process has none left)
+int pcb_advance(PCB *pcb) {
+    if (++pcb->current_burst >= pcb->burst_count) { // If that was the last burst
+        return 0;
+    }
+    int write; // Direction of the burst
+    pcb->remaining = unpack_burst(packed_bursts(pcb), &pcb->burst_offset, &write); // Decode the next burst
+    pcb->flags = (pcb->flags & ~PCB_FLAG_WRITE) | (write ? PCB_FLAG_WRITE : 0); // Load its direction
+    return 1;
+}
+
+#else
+
+// Allocate a zeroed, unlinked PCB
+PCB *pcb_alloc(void) {
+    PCB *pcb = calloc(1, sizeof(PCB)); // Allocate memory for a new PCB
+    if (pcb == NULL) { // If memory allocation fails
+        perror("Failed to allocate memory for PCB"); // Print an error message
+        return NULL;
+    }
+    count_alloc(); // Account the allocation
+    return pcb; // Return the PCB
+}
+
+// Release a PCB and its burst arrays
+void pcb_free(PCB *pcb) {
+    if (pcb == NULL) { // If there is nothing to free
+        return;
+    }
+    if (!(pcb->flags & PCB_FLAG_SHARED)) { // If the bursts are not borrowed
+        free((void *)pcb->bursts); // Free the bursts array
+        free((void *)pcb->write_bursts); // Free the write bitmap
+    }
+    free(pcb); // Free the PCB
+    __atomic_sub_fetch(&pcbs_live, 1, __ATOMIC_RELAXED); // Count the release
+}
+
+// Copy the bursts (and the write bitmap, if any burst is a write); the first burst becomes current
+int pcb_set_bursts(PCB *pcb, const sim_time_t *bursts, const unsigned char *writes, int count) {
+    size_t bitmap_size = (count + 7) / 8; // Bytes in the write bitmap
+    int any_write = 0; // Whether any burst is a write
+    for (size_t i = 0; writes && i < bitmap_size; i++) { // Loop through the bitmap
+        any_write |= writes[i]; // Collect the marked bursts
+    }
+    sim_time_t *copy = malloc(count * sizeof(sim_time_t)); // Allocate memory for the bursts
+    unsigned char *bitmap = any_write ? malloc(bitmap_size) : NULL; // Allocate the bitmap only when needed
+    pcb->bursts = copy; // Owned by the PCB from now on (freed even if the other allocation failed)
+    pcb->write_bursts = bitmap;
+    if (copy == NULL || (any_write && bitmap == NULL)) { // If memory allocation fails
+        perror("Failed to allocate memory for bursts"); // Print an error message
+        return -1;
+    }
+    memcpy(copy, bursts, count * sizeof(sim_time_t)); // Copy the bursts
+    if (any_write) { // If any burst is a write
+        memcpy(bitmap, writes, bitmap_size); // Copy the bitmap
+    }
+    __atomic_add_fetch(&burst_bytes, count * sizeof(sim_time_t) + (any_write ? bitmap_size : 0), __ATOMIC_RELAXED); // Account the arrays
+    pcb->burst_count = count; // Set the burst count
+    pcb_seek(pcb, 0); // Start at the first burst
+    return 0; // Success
+}
+
+// Borrow bursts that outlive the PCB (a workload image); nothing is copied or accounted
+int pcb_bind_bursts(PCB *pcb, const sim_time_t *bursts, const unsigned char *writes, int count) {
+    pcb->bursts = bursts; // Point into the image
+    pcb->write_bursts = writes; // NULL when every burst is a read
+    pcb->flags |= PCB_FLAG_SHARED; // pcb_free leaves them alone
+    pcb->burst_count = count; // Set the burst count
+    pcb_seek(pcb, 0); // Start at the first burst
+    return 0; // Success
+}
+
+// Copy every burst and the write bitmap ((count + 7) / 8 bytes)
+void pcb_get_bursts(const PCB *pcb, sim_time_t *bursts, unsigned char *writes) {
+    memcpy(bursts, pcb->bursts, pcb->burst_count * sizeof(sim_time_t)); // Copy the bursts
+    if (pcb->write_bursts) { // If any burst is a write
+        memcpy(writes, pcb->write_bursts, (pcb->burst_count + 7) / 8); // Copy the bitmap
+    } else {
+        memset(writes, 0, (pcb->burst_count + 7) / 8); // Every burst is a read
+    }
+}
+
+// Make a burst current and load its length
+void pcb_seek(PCB *pcb, int burst) {
+    pcb->current_burst = burst; // Set the current burst
+    pcb->remaining = burst < pcb->burst_count ? pcb->bursts[burst] : 0; // Load its length
+    int write = burst < pcb->burst_count && pcb->write_bursts && (pcb->write_bursts[burst >> 3] >> (burst & 7) & 1); // Its direction
+    pcb->flags = (pcb->flags & ~PCB_FLAG_WRITE) | (write ? PCB_FLAG_WRITE : 0); // Load its direction
+}
+
+// Move to the next burst (0 when the process has none left)
+int pcb_advance(PCB *pcb) {
+    if (pcb->current_burst + 1 >= pcb->burst_count) { // If that was the last burst
+        pcb->current_burst++; // Step past it
+        return 0;
+    }
+    pcb_seek(pcb, pcb->current_burst + 1); // Load the next burst
+    return 1;
+}
+
+#endif
+
+// Print the PCB layout and the average memory each process took
+void pcb_report(FILE *out) {
+    unsigned long long allocated = __atomic_load_n(&pcbs_allocated, __ATOMIC_RELAXED); // PCBs allocated so far
+    fprintf(out, "PCB layout                   : %s (%zu B per PCB)\n", PCB_LAYOUT, sizeof(PCB));
+    if (allocated > 0) { // If any process was loaded
+        double per_process = sizeof(PCB) + (double)__atomic_load_n(&burst_bytes, __ATOMIC_RELAXED) / allocated; // PCB plus out-of-line bursts
+        fprintf(out, "Memory per process           : %.1f B (peak %lld live, %.1f MiB)\n", per_process,
+                __atomic_load_n(&pcbs_peak, __ATOMIC_RELAXED), per_process * __atomic_load_n(&pcbs_peak, __ATOMIC_RELAXED) / (1024.0 * 1024.0));
+    }
+}
@@ -0,0 +1,133 @@
+//
+// Process control blocks: a pointer-linked layout, or a compact pooled layout built with -DSCHED_COMPACT_PCB
+//
+#ifndef PCB_H // If not defined, define PCB_H to prevent multiple inclusions
+#define PCB_H // Define PCB_H
+
+#include <stdio.h> // Include standard I/O library
+#include <stdint.h> // Include fixed-width integer types
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+#include "lock_stats.h" // Include the lock statistics header file for PCB_LOCK_STATS_FIELD
+
+#define PCB_FLAG_WRITE 0x01 // The current burst is a write request
+#define PCB_FLAG_HEAP 0x02 // The packed bursts did not fit inline (compact layout only)
+#define PCB_FLAG_PREEMPTED 0x04 // The last run ended in a preemption (its cache state went cold)
+#define PCB_FLAG_SHARED 0x08 // The bursts are borrowed from a workload image and never freed (pointer layout only)
+
+#ifdef SCHED_COMPACT_PCB
+
+#define PCB_LAYOUT "compact" // Name of the layout in the report
+#define PCB_INLINE_BYTES 16 // Packed bursts stored inside the PCB when they fit
+#define PCB_CHUNK_BITS 16 // log2 of the PCBs per pool chunk
+#define PCB_CHUNK_SIZE (1 << PCB_CHUNK_BITS) // PCBs per pool chunk
+#define PCB_CHUNK_MASK (PCB_CHUNK_SIZE - 1) // Mask selecting a PCB within its chunk
+#define PCB_MAX_CHUNKS 65536 // Chunks addressable by a 32-bit index
+#define PCB_PRIORITY_MIN INT16_MIN // Lowest priority a PCB can hold
+#define PCB_PRIORITY_MAX INT16_MAX // Highest priority a PCB can hold
+#define PCB_BURSTS_MAX 4096 // Most bursts a PCB can hold (keeps the packed offset within 16 bits)
+#define PCB_COMPACT_BYTES 96 // Size budget of a compact PCB (lock statistics add their timestamp on top)
+
+// Define the PCB structure (pooled, linked through 32-bit indices, bursts varint-packed and decoded one at a time)
+typedef struct PCB {
+    union {
+        sim_time_t remaining; // Time left in the current burst
+        long io_done_time; // Wheel tick at which the in-flight I/O burst completes (the burst length is no longer needed once it is on the wheel)
+    };
+    sim_time_t arrival_time; // Arrival time of the process
+    sim_time_t waiting_time; // Time the process has spent waiting in the ready queue
+    sim_time_t ready_time; // Simulated time the process entered its current queue
+    sim_time_t quota_reserved; // Quota its groups reserved for the run in progress (fair-share groups)
+    union {
+        uint8_t *heap; // Packed bursts on the heap (PCB_FLAG_HEAP)
+        uint8_t bytes[PCB_INLINE_BYTES]; // Packed bursts stored inline
+    } bursts; // Varint-packed bursts
+    uint32_t index; // Pool index of this PCB (never 0)
+    uint32_t next; // Pool index of the next PCB in the queue (0 = none)
+    uint32_t prev; // Pool index of the previous PCB in the queue (0 = none)
+    int32_t ready_index; // Entry in the SoA ready set (-1 = not indexed)
+    uint32_t id; // Admission order of the process (1-based)
+    uint32_t preemptions; // Time slices of the process that expired before its burst ended
+    uint16_t burst_offset; // Byte offset of the first burst after the current one
+    uint16_t burst_count; // Number of bursts
+    uint16_t current_burst; // Index of the current burst
+    uint16_t partition; // CPU partition owning the process (virtual-time engine)
+    uint16_t last_cpu; // CPU the process last ran on, plus one (0 = never ran)
+    uint16_t group; // Fair-share group of the process (0 = default)
+    int16_t priority; // Process priority
+    uint8_t flags; // PCB_FLAG_* bits
+    PCB_LOCK_STATS_FIELD // Enqueue timestamp (SCHED_LOCK_STATS builds only)
+} PCB;
+
+#ifndef SCHED_LOCK_STATS
+_Static_assert(sizeof(PCB) <= PCB_COMPACT_BYTES, "compact PCB outgrew its size budget"); // A new field has to fit or replace one
+#endif
+
+extern PCB *pcb_chunks[PCB_MAX_CHUNKS]; // Pool chunks (allocated on demand, never moved)
+
+// Resolve a pool index to its PCB (NULL for index 0)
+static inline PCB *pcb_at(uint32_t index) {
+    return index ? &pcb_chunks[index >> PCB_CHUNK_BITS][index & PCB_CHUNK_MASK] : NULL;
+}
+
+// Pool index of a PCB (0 for NULL)
+static inline uint32_t pcb_link(const PCB *pcb) {
+    return pcb ? pcb->index : 0;
+}
+
+#define PCB_NEXT(pcb) pcb_at((pcb)->next) // Next PCB in the list
+#define PCB_PREV(pcb) pcb_at((pcb)->prev) // Previous PCB in the list
+#define PCB_SET_NEXT(pcb, other) ((pcb)->next = pcb_link(other)) // Link the next PCB
+#define PCB_SET_PREV(pcb, other) ((pcb)->prev = pcb_link(other)) // Link the previous PCB
+
+#else
+
+#define PCB_LAYOUT "pointer" // Name of the layout in the report
+#define PCB_PRIORITY_MIN INT32_MIN // Lowest priority a PCB can hold
+#define PCB_PRIORITY_MAX INT32_MAX // Highest priority a PCB can hold
+#define PCB_BURSTS_MAX INT32_MAX // Most bursts a PCB can hold
+
+// Define the PCB (Process Control Block) structure
+typedef struct PCB {
+    int priority; // Process priority
+    int burst_count; // Number of bursts
+    const sim_time_t *bursts; // Array of bursts (never written; owned, or borrowed with PCB_FLAG_SHARED)
+    const unsigned char *write_bursts; // Bitmap of the I/O bursts that are writes (NULL = all reads)
+    int current_burst; // Index of the current burst
+    int flags; // PCB_FLAG_* bits
+    sim_time_t remaining; // Time left in the current burst
+    sim_time_t arrival_time; // Arrival time of the process
+    sim_time_t waiting_time; // Time the process has spent waiting in the ready queue
+    sim_time_t ready_time; // Simulated time the process entered its current queue
+    long io_done_time; // Wheel tick at which the in-flight I/O burst completes
+    int ready_index; // Entry in the SoA ready set (-1 = not indexed)
+    int partition; // CPU partition owning the process (virtual-time engine)
+    int last_cpu; // CPU the process last ran on, plus one (0 = never ran)
+    int group; // Fair-share group of the process (0 = default)
+    sim_time_t quota_reserved; // Quota its groups reserved for the run in progress (fair-share groups)
+    long id; // Admission order of the process (1-based)
+    long preemptions; // Time slices of the process that expired before its burst ended
+    PCB_LOCK_STATS_FIELD // Enqueue timestamp (SCHED_LOCK_STATS builds only)
+    struct PCB *next; // Pointer to the next PCB in the queue
+    struct PCB *prev; // Pointer to the previous PCB in the queue
+} PCB;
+
+#define PCB_NEXT(pcb) ((pcb)->next) // Next PCB in the list
+#define PCB_PREV(pcb) ((pcb)->prev) // Previous PCB in the list
+#define PCB_SET_NEXT(pcb, other) ((pcb)->next = (other)) // Link the next PCB
+#define PCB_SET_PREV(pcb, other) ((pcb)->prev = (other)) // Link the previous PCB
+
+#endif
+
+// Check whether the current burst of a PCB is a write request
+#define PCB_IS_WRITE(pcb) (((pcb)->flags & PCB_FLAG_WRITE) != 0)
+
+PCB *pcb_alloc(void); // Function prototype for allocating a zeroed, unlinked PCB
+void pcb_free(PCB *pcb); // Function prototype for releasing a PCB and its bursts
+int pcb_set_bursts(PCB *pcb, const sim_time_t *bursts, const unsigned char *writes, int count); // Function prototype for storing the bursts (writes is a bitmap, NULL = all reads)
+int pcb_bind_bursts(PCB *pcb, const sim_time_t *bursts, const unsigned char *writes, int count); // Function prototype for using bursts that outlive the PCB (borrowed by the pointer layout, packed by the compact one)
+void pcb_get_bursts(const PCB *pcb, sim_time_t *bursts, unsigned char *writes); // Function prototype for decoding every burst and the write bitmap
+void pcb_seek(PCB *pcb, int burst); // Function prototype for making a burst current and loading its remaining time
+int pcb_advance(PCB *pcb); // Function prototype for moving to the next burst (0 when the process has none left)
+void pcb_report(FILE *out); // Function prototype for printing the layout and memory per process
+
+#endif // PCB_H // End of include guard
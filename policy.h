@@ -0,0 +1,40 @@
+//
+// Pluggable CPU scheduling policies driven by one shared dispatch loop
+//
+#ifndef POLICY_H // If not defined, define POLICY_H to prevent multiple inclusions
+#define POLICY_H // Define POLICY_H
+
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+
+struct PCB; // Process control block
+struct Queue; // Queue of PCBs
+struct SchedulerContext; // Simulation the policy runs in
+struct Cpu; // Simulated CPU running the dispatch loop
+
+// Define the SchedPolicy structure (hooks are called by the shared run loop; NULL hooks are skipped)
+typedef struct SchedPolicy {
+    const char *name; // Name selected with -alg
+    // Unlink and return the next PCB to run; called with the ready queue mutex held and the queue non-empty
+    struct PCB *(*pick_next)(struct SchedulerContext *ctx);
+    // A PCB was appended to the ready queue; called with the ready queue mutex held
+    void (*on_enqueue)(struct SchedulerContext *ctx, struct PCB *pcb);
+    // A PCB used up its time slice and is about to be re-enqueued
+    void (*on_preempt)(struct SchedulerContext *ctx, struct PCB *pcb, sim_time_t ran);
+    // A PCB is being dispatched; return how long it may run before preemption (0 = until its burst ends)
+    sim_time_t (*on_tick)(struct SchedulerContext *ctx, struct PCB *pcb);
+    // A PCB ran on a CPU for ran from start (after every slice and every burst); called without locks
+    void (*on_ran)(struct SchedulerContext *ctx, struct PCB *pcb, sim_time_t start, sim_time_t ran);
+} SchedPolicy;
+
+extern const SchedPolicy fifo_policy; // First-in first-out
+extern const SchedPolicy sjf_policy; // Shortest next burst first
+extern const SchedPolicy pr_policy; // Highest priority first
+extern const SchedPolicy rr_policy; // Round robin with the configured quantum
+extern const SchedPolicy sjf_soa_policy; // SJF over the vectorised SoA ready set
+extern const SchedPolicy pr_soa_policy; // PR over the vectorised SoA ready set
+
+const SchedPolicy *policy_find(const char *name); // Function prototype for looking up a built-in policy by name
+void queue_unlink(struct Queue *queue, struct PCB *pcb); // Function prototype for removing a PCB from anywhere in a queue (mutex held)
+void run_policy(struct Cpu *cpu, const SchedPolicy *policy); // Function prototype for running any policy through the shared loop on one CPU
+
+#endif // POLICY_H // End of include guard
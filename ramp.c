@@ -0,0 +1,215 @@
+//
+// Load ramp mode: open-loop Poisson arrivals at stepped rates, one simulation per step, to locate the saturation knee
+//
+#include <math.h> // Include log
+#include "ramp.h" // Include the ramp header file
+#include "trace.h" // Include the trace header file
+
+// Define the RampMix structure (the proc lines arrivals are drawn from)
+typedef struct RampMix {
+    char **lines; // Proc lines of the template trace, without line endings
+    int count; // Number of lines
+} RampMix;
+
+// Parse "start:step:steps" into a ramp (rates in processes / ms)
+int ramp_parse(const char *text, RampSpec *spec) {
+    int consumed = 0; // Characters matched
+    if (!text || sscanf(text, "%lf:%lf:%d%n", &spec->start, &spec->step, &spec->steps, &consumed) != 3 || text[consumed] != '\0' ||
+        spec->start <= 0 || spec->step < 0 || spec->steps < 1) { // Every step needs a positive rate
+        return -1; // Report a parse error
+    }
+    return 0; // Success
+}
+
+// Collect the proc lines of the template trace (sleep, policy and stop lines are dropped)
+static int ramp_mix_load(RampMix *mix, const char *path) {
+    FILE *file = fopen(path, "r"); // Open the template for reading
+    if (!file) { // If the file cannot be opened
+        perror("Failed to open input file"); // Print an error message
+        return -1; // Report the failure
+    }
+    char line[TRACE_LINE_MAX]; // Buffer to store each line of the file
+    while (fgets(line, sizeof(line), file)) { // Read each line of the file
+        TraceEvent event; // Parsed line
+        if (trace_parse_line(line, strlen(line), &event) != TRACE_PROC) { // Only processes make up the mix
+            continue;
+        }
+        pcb_free(event.pcb); // The line is replayed, not the PCB
+        if ((mix->count & (mix->count - 1)) == 0) { // If the array is full (capacity doubles at powers of two)
+            char **lines = realloc(mix->lines, (mix->count ? mix->count * 2 : 1) * sizeof(char *)); // Grow the array
+            if (!lines) { // If the allocation failed
+                break;
+            }
+            mix->lines = lines; // Keep the grown array
+        }
+        if (!(mix->lines[mix->count] = strndup(event.text, event.text_length))) { // Copy the line
+            break;
+        }
+        mix->count++; // Count the line
+    }
+    fclose(file); // Close the file
+    if (mix->count == 0) { // If there is nothing to draw from
+        fprintf(stderr, "No proc lines found in %s\n", path); // Print an error message
+        return -1; // Report the failure
+    }
+    return 0; // Success
+}
+
+// Release the proc lines
+static void ramp_mix_free(RampMix *mix) {
+    for (int i = 0; i < mix->count; i++) { // Loop through each line
+        free(mix->lines[i]); // Free the line
+    }
+    free(mix->lines); // Free the array
+}
+
+// Next value of a splitmix64 generator (small, seedable and identical everywhere)
+static unsigned long long ramp_random(unsigned long long *state) {
+    unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL); // Advance the state
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL; // Mix the bits
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Start of the part of each window throughput is measured over
+static sim_time_t ramp_measure_from(const RampSpec *spec) {
+    return (sim_time_t)(spec->window * RAMP_WARMUP);
+}
+
+// Write one step's trace: exponential gaps at the step's rate until the window ends, each arrival a random proc line of the mix
+static int ramp_write_step(const RampMix *mix, const RampSpec *spec, int step, const char *path, int *arrivals, int *measured) {
+    FILE *file = fopen(path, "w"); // Open the step's trace for writing
+    if (!file) { // If the file cannot be opened
+        perror("Failed to write ramp trace"); // Print an error message
+        return -1; // Report the failure
+    }
+    double rate = spec->start + spec->step * step; // Arrivals per ms
+    unsigned long long state = spec->seed + step; // Each step draws its own reproducible sequence
+    sim_time_t now = 0; // Time of the last arrival
+    *arrivals = *measured = 0; // Arrivals written so far, and those in the measured part of the window
+    while (1) { // Loop through each arrival
+        double uniform = ((ramp_random(&state) >> 11) + 1) * 0x1.0p-53; // Uniform in (0, 1]
+        sim_time_t gap = (sim_time_t)(-log(uniform) / rate * SIM_TIME_PER_MS); // Exponential gap of a Poisson process
+        if (now + gap >= spec->window) { // If the next arrival falls past the window
+            break;
+        }
+        if (gap > 0) { // If time passes before it
+            fprintf(file, "sleep %lld%s\n", (long long)gap, SIM_TIME_UNIT);
+        }
+        now += gap; // Advance to the arrival
+        fprintf(file, "%s\n", mix->lines[ramp_random(&state) % mix->count]); // Draw the process from the mix
+        (*arrivals)++;
+        *measured += now >= ramp_measure_from(spec); // Offered during the measured part
+    }
+    fprintf(file, "stop\n"); // The queued processes still drain after the window
+    return fclose(file) == 0 ? 0 : -1; // Flush the trace
+}
+
+// Format a p99 turnaround for the table (past the last bucket bound when the estimate is -1)
+static void ramp_format_p99(char *buffer, size_t size, sim_time_t p99) {
+    if (p99 < 0) { // If it lies in the +Inf bucket
+        snprintf(buffer, size, ">%d", HISTOGRAM_LAST_BOUND_MS);
+    } else {
+        snprintf(buffer, size, "%.3f", SIM_TIME_TO_MS(p99));
+    }
+}
+
+// Print one row per step and the knee: the first step completing less than RAMP_KNEE_THROUGHPUT of its rate or whose p99 exploded
+static void ramp_print_results(const SchedulerArgs *args, const RampSpec *spec, const BatchResult *results, const int *arrivals, const int *measured, int workers, double wall_seconds, FILE *out) {
+    const SchedPolicy *policy = args->policy ? args->policy : policy_find(args->algorithm); // Policy every step used
+    fprintf(out, "CPU Scheduling Alg           : %s\n", policy ? policy->name : args->algorithm);
+    fprintf(out, "I/O Scheduling Alg           : %s\n", args->io_algorithm ? args->io_algorithm : "FIFO");
+    fprintf(out, "Load ramp                    : %d steps from %.3f by %.3f processes / ms, %.3f ms windows, seed %llu\n",
+            spec->steps, spec->start, spec->step, SIM_TIME_TO_MS(spec->window), spec->seed);
+    fprintf(out, "%4s %12s %8s %9s %12s %8s %14s %14s %9s\n", "Step", "Rate (/ms)", "Arrivals", "Processes", "Thru (/ms)", "CPU %", "Avg TAT (ms)", "p99 TAT (ms)", "Wall (s)");
+    int knee = -1, failed = 0; // First saturated step, and the number of failed runs
+    sim_time_t base_p99 = 0; // p99 turnaround of the lightest step
+    double peak = 0; // Highest throughput reached
+    for (int i = 0; i < spec->steps; i++) { // Loop through each step
+        const BatchResult *result = &results[i]; // Current result
+        double rate = spec->start + spec->step * i; // Offered rate
+        if (result->status != 0 || result->process_count == 0 || result->total_time == 0) { // Nothing to measure
+            failed += result->status != 0;
+            fprintf(out, "%4d %12.3f %8d %9d %12s %8s %14s %14s %9.3f\n", i, rate, arrivals[i], result->process_count, "-", "-", "-", result->status ? "FAILED" : "-", result->wall_seconds);
+            continue;
+        }
+        double interval = SIM_TIME_TO_MS(spec->window - ramp_measure_from(spec)); // Measured part of the window, in ms
+        double offered = measured[i] / interval; // Rate the Poisson draws actually produced there
+        double throughput = result->measured_completions / interval; // Completions over the same part (no warmup, no drain)
+        sim_time_t p99 = histogram_quantile(&result->turnaround_hist, 0.99); // Estimated from the turnaround buckets
+        char p99_text[32]; // Formatted p99
+        ramp_format_p99(p99_text, sizeof(p99_text), p99);
+        fprintf(out, "%4d %12.3f %8d %9d %12.3f %8.3f %14.3f %14s %9.3f\n", i, rate, arrivals[i], result->process_count, throughput,
+                (double)result->busy_time / result->total_time / (args->cpus > 0 ? args->cpus : 1) * 100,
+                SIM_TIME_TO_MS(result->total_turnaround_time) / result->process_count, p99_text, result->wall_seconds);
+        peak = throughput > peak ? throughput : peak; // Track the saturation throughput
+        if (i == 0) { // The lightest step is the baseline
+            base_p99 = p99;
+        }
+        if (knee < 0 && (throughput < RAMP_KNEE_THROUGHPUT * offered || p99 < 0 || (base_p99 > 0 && p99 > RAMP_KNEE_P99 * base_p99))) { // If queueing exploded
+            knee = i;
+        }
+    }
+    if (knee < 0) { // If every step kept up
+        fprintf(out, "Knee                         : not reached (peak throughput %.3f processes / ms; raise the rate)\n", peak);
+    } else if (knee == 0) { // If even the lightest step was saturated there is nothing to bracket the knee
+        fprintf(out, "Knee                         : not found (the first step is already saturated at %.3f processes / ms; lower the start rate)\n", spec->start);
+    } else {
+        fprintf(out, "Knee                         : step %d at %.3f processes / ms (peak throughput %.3f processes / ms)\n", knee, spec->start + spec->step * knee, peak);
+    }
+    fprintf(out, "Ramp: %d steps (%d failed) on %d workers in %.3f s\n", spec->steps, failed, workers < spec->steps ? workers : spec->steps, wall_seconds);
+}
+
+// Generate a trace per step from the proc lines of args->input_file, run them on a worker pool and print the table and knee
+int ramp_run(const SchedulerArgs *args, const RampSpec *spec, int workers, FILE *out) {
+    RampMix mix = {NULL, 0}; // Proc lines arrivals are drawn from
+    if (ramp_mix_load(&mix, args->input_file) != 0) { // Collect them
+        ramp_mix_free(&mix);
+        return spec->steps; // Every step failed
+    }
+    const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp"; // Where the step traces are written
+    BatchInputs inputs = {calloc(spec->steps, sizeof(char *)), 0}; // One generated trace per step
+    BatchResult *results = calloc(spec->steps, sizeof(BatchResult)); // One result per step
+    int *arrivals = calloc(spec->steps, sizeof(int)); // Arrivals generated per step
+    int *measured = calloc(spec->steps, sizeof(int)); // Arrivals in the measured part of each step
+    int failed = spec->steps; // Every step failed until the batch runs
+    if (!inputs.files || !results || !arrivals || !measured) { // If the allocation failed
+        perror("Failed to allocate memory for the load ramp"); // Print an error message
+        goto done;
+    }
+    for (; inputs.count < spec->steps; inputs.count++) { // Loop through each step
+        char path[4096]; // Path of the step's trace
+        snprintf(path, sizeof(path), "%s/sched-ramp-XXXXXX", dir);
+        int fd = mkstemp(path); // Reserve a unique name
+        if (fd < 0 || !(inputs.files[inputs.count] = strdup(path))) { // If the file cannot be created
+            perror("Failed to create ramp trace"); // Print an error message
+            if (fd >= 0) { // Drop the reserved name
+                close(fd);
+                remove(path);
+            }
+            goto done;
+        }
+        close(fd); // The trace is written by name
+        if (ramp_write_step(&mix, spec, inputs.count, path, &arrivals[inputs.count], &measured[inputs.count]) != 0) { // Generate the arrivals
+            inputs.count++; // Remove it below
+            goto done;
+        }
+    }
+    double wall_seconds; // Real time the ramp took
+    SchedulerArgs step_args = *args; // Every step counts its completions over the measured part of the window
+    step_args.measure_from = ramp_measure_from(spec);
+    step_args.measure_until = spec->window;
+    failed = batch_run(&step_args, &inputs, workers, results, &wall_seconds); // Run every step as an independent simulation
+    ramp_print_results(args, spec, results, arrivals, measured, workers, wall_seconds, out); // Output the table and knee
+
+done:
+    for (int i = 0; i < inputs.count; i++) { // Loop through each generated trace
+        remove(inputs.files[i]); // Delete it
+    }
+    batch_inputs_free(&inputs); // Release the paths
+    free(results); // Free the results
+    free(arrivals); // Free the arrival counts
+    free(measured);
+    ramp_mix_free(&mix); // Release the proc lines
+    return failed; // Report the number of failed runs
+}
@@ -0,0 +1,25 @@
+//
+// Load ramp mode: open-loop Poisson arrivals at stepped rates, one simulation per step, to locate the saturation knee
+//
+#ifndef RAMP_H // If not defined, define RAMP_H to prevent multiple inclusions
+#define RAMP_H // Define RAMP_H
+
+#include "batch.h" // Include the batch mode header file
+
+#define RAMP_WARMUP 0.5 // Share of each window before throughput is measured (the queues fill up, and the drain after it is never measured)
+#define RAMP_KNEE_THROUGHPUT 0.9 // A step is saturated once it completes less than this share of the rate it was offered
+#define RAMP_KNEE_P99 10 // ... or once its p99 turnaround exceeds this multiple of the lightest step's
+
+// Define the RampSpec structure (the rates to step through)
+typedef struct RampSpec {
+    double start; // Arrival rate of the first step (processes / ms)
+    double step; // Rate added at every further step
+    int steps; // Number of steps
+    sim_time_t window; // Simulated time arrivals are generated for in each step
+    unsigned long long seed; // Seed of the arrival and job-mix generator
+} RampSpec;
+
+int ramp_parse(const char *text, RampSpec *spec); // Function prototype for parsing "start:step:steps" into a ramp (rates in processes / ms)
+int ramp_run(const SchedulerArgs *args, const RampSpec *spec, int workers, FILE *out); // Function prototype for running every step on a worker pool and printing the table and knee (returns the number of failed runs)
+
+#endif // RAMP_H // End of include guard
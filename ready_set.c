@@ -0,0 +1,305 @@
+//
+// Structure-of-arrays ready set with vectorised min/max search
+//
+#include "scheduler.h" // Include the scheduler header file (which includes the ready set header)
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // Include the x86 vector intrinsics
+#define RS_X86 1 // Vector kernels are available
+#endif
+
+#define RS_INITIAL_CAPACITY 64 // Entries allocated on the first insert
+
+// Search kernels; ties resolve to the lowest index, which rs_remove keeps in queue order, so every kernel picks the PCB the list scan would
+typedef struct RsKernels {
+    const char *name; // Name reported in the metrics
+    int (*argmin_i64)(const int64_t *values, int count); // Index of the smallest value
+    int (*argmax_i32)(const int32_t *values, int count); // Index of the largest value
+} RsKernels;
+
+// Index of the smallest value (portable fallback)
+static int argmin_i64_scalar(const int64_t *values, int count) {
+    int best = 0; // Index of the smallest value so far
+    for (int i = 1; i < count; i++) { // Loop through each value
+        if (values[i] < values[best]) { // Strictly smaller keeps the earliest tie
+            best = i; // Update the smallest value
+        }
+    }
+    return best; // Return the index
+}
+
+// Index of the largest value (portable fallback)
+static int argmax_i32_scalar(const int32_t *values, int count) {
+    int best = 0; // Index of the largest value so far
+    for (int i = 1; i < count; i++) { // Loop through each value
+        if (values[i] > values[best]) { // Strictly larger keeps the earliest tie
+            best = i; // Update the largest value
+        }
+    }
+    return best; // Return the index
+}
+
+#ifdef RS_X86
+// Reduce per-lane winners to one index, preferring the lowest index on ties
+static int reduce_lanes_i64(const int64_t *value, const int64_t *index, int lanes, int want_min) {
+    int best = 0; // Lane holding the winner so far
+    for (int lane = 1; lane < lanes; lane++) { // Loop through each lane
+        int better = want_min ? value[lane] < value[best] : value[lane] > value[best]; // Strictly better value
+        if (better || (value[lane] == value[best] && index[lane] < index[best])) { // Or the same value seen earlier
+            best = lane; // Update the winning lane
+        }
+    }
+    return (int)index[best]; // Return the winning index
+}
+
+// Index of the smallest value, four 64-bit lanes at a time
+__attribute__((target("avx2")))
+static int argmin_i64_avx2(const int64_t *values, int count) {
+    if (count < 8) { // Too short to be worth the setup
+        return argmin_i64_scalar(values, count);
+    }
+    __m256i best = _mm256_loadu_si256((const __m256i *)values); // Smallest value per lane
+    __m256i best_index = _mm256_set_epi64x(3, 2, 1, 0); // Index of the smallest value per lane
+    __m256i index = best_index; // Indices of the current block
+    const __m256i step = _mm256_set1_epi64x(4); // Lanes per block
+    int i = 4; // First value not yet examined
+    for (; i + 4 <= count; i += 4) { // Loop through each full block
+        index = _mm256_add_epi64(index, step); // Indices of this block
+        __m256i block = _mm256_loadu_si256((const __m256i *)(values + i)); // Load the block
+        __m256i smaller = _mm256_cmpgt_epi64(best, block); // Lanes where the block is strictly smaller
+        best = _mm256_blendv_epi8(best, block, smaller); // Keep the smaller values
+        best_index = _mm256_blendv_epi8(best_index, index, smaller); // And their indices
+    }
+    int64_t lane_value[4], lane_index[4]; // Per-lane winners
+    _mm256_storeu_si256((__m256i *)lane_value, best); // Spill the values
+    _mm256_storeu_si256((__m256i *)lane_index, best_index); // Spill the indices
+    int winner = reduce_lanes_i64(lane_value, lane_index, 4, 1); // Combine the lanes
+    for (; i < count; i++) { // Loop through the tail
+        if (values[i] < values[winner]) { // Strictly smaller keeps the earliest tie
+            winner = i; // Update the smallest value
+        }
+    }
+    return winner; // Return the index
+}
+
+// Index of the largest value, eight 32-bit lanes at a time
+__attribute__((target("avx2")))
+static int argmax_i32_avx2(const int32_t *values, int count) {
+    if (count < 16) { // Too short to be worth the setup
+        return argmax_i32_scalar(values, count);
+    }
+    __m256i best = _mm256_loadu_si256((const __m256i *)values); // Largest value per lane
+    __m256i best_index = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0); // Index of the largest value per lane
+    __m256i index = best_index; // Indices of the current block
+    const __m256i step = _mm256_set1_epi32(8); // Lanes per block
+    int i = 8; // First value not yet examined
+    for (; i + 8 <= count; i += 8) { // Loop through each full block
+        index = _mm256_add_epi32(index, step); // Indices of this block
+        __m256i block = _mm256_loadu_si256((const __m256i *)(values + i)); // Load the block
+        __m256i larger = _mm256_cmpgt_epi32(block, best); // Lanes where the block is strictly larger
+        best = _mm256_blendv_epi8(best, block, larger); // Keep the larger values
+        best_index = _mm256_blendv_epi8(best_index, index, larger); // And their indices
+    }
+    int32_t lane_value[8], lane_index[8]; // Per-lane winners
+    _mm256_storeu_si256((__m256i *)lane_value, best); // Spill the values
+    _mm256_storeu_si256((__m256i *)lane_index, best_index); // Spill the indices
+    int winner = lane_index[0]; // Combine the lanes
+    for (int lane = 1; lane < 8; lane++) { // Loop through each lane
+        if (lane_value[lane] > values[winner] || (lane_value[lane] == values[winner] && lane_index[lane] < winner)) { // Larger, or equal and earlier
+            winner = lane_index[lane]; // Update the winning index
+        }
+    }
+    for (; i < count; i++) { // Loop through the tail
+        if (values[i] > values[winner]) { // Strictly larger keeps the earliest tie
+            winner = i; // Update the largest value
+        }
+    }
+    return winner; // Return the index
+}
+
+// Index of the smallest value, two 64-bit lanes at a time
+__attribute__((target("sse4.2")))
+static int argmin_i64_sse(const int64_t *values, int count) {
+    if (count < 4) { // Too short to be worth the setup
+        return argmin_i64_scalar(values, count);
+    }
+    __m128i best = _mm_loadu_si128((const __m128i *)values); // Smallest value per lane
+    __m128i best_index = _mm_set_epi64x(1, 0); // Index of the smallest value per lane
+    __m128i index = best_index; // Indices of the current block
+    const __m128i step = _mm_set1_epi64x(2); // Lanes per block
+    int i = 2; // First value not yet examined
+    for (; i + 2 <= count; i += 2) { // Loop through each full block
+        index = _mm_add_epi64(index, step); // Indices of this block
+        __m128i block = _mm_loadu_si128((const __m128i *)(values + i)); // Load the block
+        __m128i smaller = _mm_cmpgt_epi64(best, block); // Lanes where the block is strictly smaller
+        best = _mm_blendv_epi8(best, block, smaller); // Keep the smaller values
+        best_index = _mm_blendv_epi8(best_index, index, smaller); // And their indices
+    }
+    int64_t lane_value[2], lane_index[2]; // Per-lane winners
+    _mm_storeu_si128((__m128i *)lane_value, best); // Spill the values
+    _mm_storeu_si128((__m128i *)lane_index, best_index); // Spill the indices
+    int winner = reduce_lanes_i64(lane_value, lane_index, 2, 1); // Combine the lanes
+    for (; i < count; i++) { // Loop through the tail
+        if (values[i] < values[winner]) { // Strictly smaller keeps the earliest tie
+            winner = i; // Update the smallest value
+        }
+    }
+    return winner; // Return the index
+}
+
+// Index of the largest value, four 32-bit lanes at a time
+__attribute__((target("sse4.2")))
+static int argmax_i32_sse(const int32_t *values, int count) {
+    if (count < 8) { // Too short to be worth the setup
+        return argmax_i32_scalar(values, count);
+    }
+    __m128i best = _mm_loadu_si128((const __m128i *)values); // Largest value per lane
+    __m128i best_index = _mm_set_epi32(3, 2, 1, 0); // Index of the largest value per lane
+    __m128i index = best_index; // Indices of the current block
+    const __m128i step = _mm_set1_epi32(4); // Lanes per block
+    int i = 4; // First value not yet examined
+    for (; i + 4 <= count; i += 4) { // Loop through each full block
+        index = _mm_add_epi32(index, step); // Indices of this block
+        __m128i block = _mm_loadu_si128((const __m128i *)(values + i)); // Load the block
+        __m128i larger = _mm_cmpgt_epi32(block, best); // Lanes where the block is strictly larger
+        best = _mm_blendv_epi8(best, block, larger); // Keep the larger values
+        best_index = _mm_blendv_epi8(best_index, index, larger); // And their indices
+    }
+    int32_t lane_value[4], lane_index[4]; // Per-lane winners
+    _mm_storeu_si128((__m128i *)lane_value, best); // Spill the values
+    _mm_storeu_si128((__m128i *)lane_index, best_index); // Spill the indices
+    int winner = lane_index[0]; // Combine the lanes
+    for (int lane = 1; lane < 4; lane++) { // Loop through each lane
+        if (lane_value[lane] > values[winner] || (lane_value[lane] == values[winner] && lane_index[lane] < winner)) { // Larger, or equal and earlier
+            winner = lane_index[lane]; // Update the winning index
+        }
+    }
+    for (; i < count; i++) { // Loop through the tail
+        if (values[i] > values[winner]) { // Strictly larger keeps the earliest tie
+            winner = i; // Update the largest value
+        }
+    }
+    return winner; // Return the index
+}
+#endif // RS_X86
+
+static const RsKernels scalar_kernels = {"scalar", argmin_i64_scalar, argmax_i32_scalar}; // Portable kernels
+#ifdef RS_X86
+static const RsKernels sse_kernels = {"sse4.2", argmin_i64_sse, argmax_i32_sse}; // 128-bit kernels
+static const RsKernels avx2_kernels = {"avx2", argmin_i64_avx2, argmax_i32_avx2}; // 256-bit kernels
+#endif
+
+static const RsKernels *kernels = &scalar_kernels; // Kernels selected for this CPU
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT; // Guard for the one-time CPU check
+
+// Pick the widest kernels the CPU supports
+static void select_kernels(void) {
+#ifdef RS_X86
+    __builtin_cpu_init(); // Read the CPU features
+    if (__builtin_cpu_supports("avx2")) { // If 256-bit integer compares are available
+        kernels = &avx2_kernels; // Use the AVX2 kernels
+    } else if (__builtin_cpu_supports("sse4.2")) { // If 64-bit integer compares are available
+        kernels = &sse_kernels; // Use the SSE kernels
+    }
+#endif
+}
+
+// Initialize an empty set
+void rs_init(ReadySet *set) {
+    pthread_once(&kernels_once, select_kernels); // Choose the kernels on first use
+    set->burst = NULL; // Arrays are allocated on the first insert
+    set->priority = NULL;
+    set->pcb = NULL;
+    set->count = 0; // The set starts empty
+    set->capacity = 0;
+}
+
+// Release the arrays (the PCBs stay owned by the ready queue)
+void rs_destroy(ReadySet *set) {
+    free(set->burst); // Free the burst array
+    free(set->priority); // Free the priority array
+    free(set->pcb); // Free the PCB array
+    rs_init(set); // Leave the set empty
+}
+
+// Grow every array to the given capacity
+static int rs_grow(ReadySet *set, int capacity) {
+    sim_time_t *burst = realloc(set->burst, capacity * sizeof(sim_time_t)); // Grow the burst array
+    if (burst == NULL) { // If memory allocation fails
+        return -1; // Report the failure
+    }
+    set->burst = burst;
+    int32_t *priority = realloc(set->priority, capacity * sizeof(int32_t)); // Grow the priority array
+    if (priority == NULL) { // If memory allocation fails
+        return -1; // Report the failure
+    }
+    set->priority = priority;
+    PCB **pcb = realloc(set->pcb, capacity * sizeof(PCB *)); // Grow the PCB array
+    if (pcb == NULL) { // If memory allocation fails
+        return -1; // Report the failure
+    }
+    set->pcb = pcb;
+    set->capacity = capacity; // Every array now holds capacity entries
+    return 0; // Success
+}
+
+// Add a PCB keyed by its current burst and priority
+int rs_insert(ReadySet *set, PCB *pcb) {
+    if (set->count == set->capacity && rs_grow(set, set->capacity ? set->capacity * 2 : RS_INITIAL_CAPACITY) != 0) { // Make room
+        pcb->ready_index = -1; // The PCB is not indexed
+        return -1; // Report the failure
+    }
+    int i = set->count++; // Append at the end
+    set->burst[i] = pcb->remaining; // Key for SJF
+    set->priority[i] = pcb->priority; // Key for PR
+    set->pcb[i] = pcb; // Back pointer
+    pcb->ready_index = i; // Remember the entry for O(1) removal
+    return 0; // Success
+}
+
+// Remove a PCB by shifting the later entries down, so entries stay in the order they were inserted (the ready queue's order)
+void rs_remove(ReadySet *set, PCB *pcb) {
+    int i = pcb->ready_index; // Entry of the PCB
+    if (i < 0 || i >= set->count || set->pcb[i] != pcb) { // If the PCB is not indexed
+        return; // Nothing to remove
+    }
+    int moved = --set->count - i; // Entries after the hole
+    if (moved > 0) { // If the PCB was not the last entry
+        memmove(&set->burst[i], &set->burst[i + 1], moved * sizeof(sim_time_t)); // Close the hole in every array
+        memmove(&set->priority[i], &set->priority[i + 1], moved * sizeof(int32_t));
+        memmove(&set->pcb[i], &set->pcb[i + 1], moved * sizeof(PCB *));
+        for (int j = i; j < set->count; j++) { // Loop through each moved entry
+            set->pcb[j]->ready_index = j; // Keep its PCB's index current
+        }
+    }
+    pcb->ready_index = -1; // The PCB is no longer indexed
+}
+
+// Drop every entry, keeping the arrays for the next inserts
+void rs_clear(ReadySet *set) {
+    for (int i = 0; i < set->count; i++) { // Loop through each entry
+        set->pcb[i]->ready_index = -1; // The PCB is no longer indexed
+    }
+    set->count = 0; // The set is empty
+}
+
+// Find the PCB with the shortest next burst
+PCB *rs_min_burst(const ReadySet *set) {
+    if (set->count == 0) { // If the set is empty
+        return NULL; // Nothing to pick
+    }
+    return set->pcb[kernels->argmin_i64(set->burst, set->count)]; // Vectorised scan of the burst array
+}
+
+// Find the PCB with the highest priority
+PCB *rs_max_priority(const ReadySet *set) {
+    if (set->count == 0) { // If the set is empty
+        return NULL; // Nothing to pick
+    }
+    return set->pcb[kernels->argmax_i32(set->priority, set->count)]; // Vectorised scan of the priority array
+}
+
+// Name the kernels chosen for this CPU
+const char *rs_kernel_name(void) {
+    pthread_once(&kernels_once, select_kernels); // Choose the kernels on first use
+    return kernels->name; // Return the name
+}
@@ -0,0 +1,30 @@
+//
+// Structure-of-arrays ready set with vectorised min/max search
+//
+#ifndef READY_SET_H // If not defined, define READY_SET_H to prevent multiple inclusions
+#define READY_SET_H // Define READY_SET_H
+
+#include <stdint.h> // Include fixed-width integer types
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+
+struct PCB; // Each entry points back at its PCB, and the PCB stores its index
+
+// Define the ReadySet structure (entry i of every array describes the same PCB)
+typedef struct ReadySet {
+    sim_time_t *burst; // Next CPU burst of each entry
+    int32_t *priority; // Priority of each entry
+    struct PCB **pcb; // PCB of each entry
+    int count; // Number of entries
+    int capacity; // Number of entries the arrays can hold
+} ReadySet;
+
+void rs_init(ReadySet *set); // Function prototype for initializing an empty set
+void rs_destroy(ReadySet *set); // Function prototype for releasing the arrays (not the PCBs)
+int rs_insert(ReadySet *set, struct PCB *pcb); // Function prototype for adding a PCB keyed by its current burst and priority
+void rs_remove(ReadySet *set, struct PCB *pcb); // Function prototype for removing a PCB by its stored index (order-preserving, so ties keep resolving in queue order)
+void rs_clear(ReadySet *set); // Function prototype for dropping every entry but keeping the arrays
+struct PCB *rs_min_burst(const ReadySet *set); // Function prototype for finding the PCB with the shortest next burst
+struct PCB *rs_max_priority(const ReadySet *set); // Function prototype for finding the PCB with the highest priority
+const char *rs_kernel_name(void); // Function prototype for naming the search kernel chosen for this CPU
+
+#endif // READY_SET_H // End of include guard
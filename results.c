@@ -0,0 +1,137 @@
+//
+// Per-process results: one CSV row per finished process, formatted and written by a background thread
+//
+#include <stdlib.h> // Include standard library
+#include <string.h> // Include memset
+#include <unistd.h> // Include ftruncate
+#include "results.h" // Include the results header file
+
+// Format one row into the file's buffer
+static void results_write_row(ResultsWriter *writer, const ProcessResult *row) {
+    if (fprintf(writer->file, "%ld,%d,%.3f,%.3f,%.3f,%.3f,%d,%ld\n", row->id, row->priority, SIM_TIME_TO_MS(row->arrival), SIM_TIME_TO_MS(row->completion),
+                SIM_TIME_TO_MS(row->waiting), SIM_TIME_TO_MS(row->completion - row->arrival), row->bursts, row->preemptions) < 0) { // If the write failed
+        writer->failed = 1; // Report it when the writer closes
+    }
+}
+
+// Writer thread: take every row recorded so far, format them without the lock, then free their slots
+static void *results_thread(void *arg) {
+    ResultsWriter *writer = (ResultsWriter *)arg; // Writer being drained
+    pthread_mutex_lock(&writer->mutex); // Lock the ring
+    while (1) { // Loop until closed and drained
+        while (writer->head == writer->tail && !writer->closing) { // Wait for rows
+            pthread_cond_wait(&writer->nonempty, &writer->mutex); // Wait for a condition signal
+        }
+        unsigned long long tail = writer->tail, head = writer->head; // Rows to write
+        if (tail == head) { // If the writer closed with nothing left
+            break;
+        }
+        pthread_mutex_unlock(&writer->mutex); // Recorders only touch slots past head
+        for (; tail < head; tail++) { // Loop through each recorded row
+            results_write_row(writer, &writer->ring[tail & (RESULTS_RING - 1)]); // Format it
+        }
+        pthread_mutex_lock(&writer->mutex); // Lock the ring
+        writer->tail = tail; // The slots are free again
+        pthread_cond_broadcast(&writer->nonfull); // Wake recorders waiting for a slot
+    }
+    pthread_mutex_unlock(&writer->mutex); // Unlock the ring
+    return NULL;
+}
+
+// Open the file, drop any rows past the resume offset, write the header unless appending to earlier rows, and start the writer thread
+int results_open(ResultsWriter *writer, const char *path, long resume_offset) {
+    memset(writer, 0, sizeof(*writer)); // Start empty
+    writer->file = fopen(path, resume_offset >= 0 ? "a" : "w"); // Open the output file
+    if (!writer->file) { // If the file cannot be opened
+        perror("Failed to open results file"); // Print an error message
+        return -1; // Report the failure
+    }
+    fseek(writer->file, 0, SEEK_END); // Find the length of the earlier rows
+    if (resume_offset >= 0 && ftell(writer->file) > resume_offset && ftruncate(fileno(writer->file), resume_offset) != 0) { // Rows finished after the snapshot are written again
+        perror("Failed to truncate results file"); // Print an error message
+        fclose(writer->file); // Close the file
+        return -1; // Report the failure
+    }
+    writer->ring = malloc(RESULTS_RING * sizeof(ProcessResult)); // Every slot is allocated up front
+    if (!writer->ring) { // If the allocation failed
+        perror("Failed to allocate memory for results"); // Print an error message
+        fclose(writer->file); // Close the file
+        return -1; // Report the failure
+    }
+    setvbuf(writer->file, NULL, _IOFBF, RESULTS_BUFFER_BYTES); // Rows reach the file in large writes
+    fseek(writer->file, 0, SEEK_END); // Find out whether the file still has rows
+    if (ftell(writer->file) == 0) { // If it is new or empty
+        fprintf(writer->file, "%s\n", RESULTS_HEADER); // Name the columns
+    }
+    pthread_mutex_init(&writer->mutex, NULL); // Initialize the ring mutex
+    pthread_cond_init(&writer->nonempty, NULL); // Initialize the ring conditions
+    pthread_cond_init(&writer->nonfull, NULL);
+    if (pthread_create(&writer->thread, NULL, results_thread, writer) != 0) { // Start the writer thread
+        perror("Failed to start results writer"); // Print an error message
+        pthread_mutex_destroy(&writer->mutex); // Destroy the ring mutex
+        pthread_cond_destroy(&writer->nonempty); // Destroy the ring conditions
+        pthread_cond_destroy(&writer->nonfull);
+        free(writer->ring); // Free the ring
+        fclose(writer->file); // Close the file
+        return -1; // Report the failure
+    }
+    return 0; // Success
+}
+
+// Copy the columns of a finished process into the next slot (called before the PCB is freed)
+void results_record(ResultsWriter *writer, const PCB *pcb, sim_time_t finish_time) {
+    pthread_mutex_lock(&writer->mutex); // Lock the ring
+    if (writer->head - writer->tail == RESULTS_RING) { // If the writer fell a whole ring behind
+        writer->stalls++; // Count the stall
+        do {
+            pthread_cond_wait(&writer->nonfull, &writer->mutex); // Wait for a condition signal
+        } while (writer->head - writer->tail == RESULTS_RING);
+    }
+    ProcessResult *row = &writer->ring[writer->head & (RESULTS_RING - 1)]; // Slot of the row
+    row->id = pcb->id; // Copy the columns
+    row->priority = pcb->priority;
+    row->bursts = pcb->burst_count;
+    row->arrival = pcb->arrival_time;
+    row->completion = finish_time;
+    row->waiting = pcb->waiting_time;
+    row->preemptions = pcb->preemptions;
+    if (writer->head++ == writer->tail) { // If the writer may be waiting for rows
+        pthread_cond_signal(&writer->nonempty); // Wake it
+    }
+    pthread_mutex_unlock(&writer->mutex); // Unlock the ring
+}
+
+// Wait for the writer to drain the ring and flush the file, so a snapshot never covers rows that are not on disk; return the file length
+long results_sync(ResultsWriter *writer) {
+    pthread_mutex_lock(&writer->mutex); // Lock the ring
+    while (writer->head != writer->tail) { // Wait for the recorded rows
+        pthread_cond_wait(&writer->nonfull, &writer->mutex); // Wait for a condition signal
+    }
+    if (fflush(writer->file) != 0) { // The writer is idle until the next row, so the buffer is ours
+        writer->failed = 1;
+    }
+    long offset = ftell(writer->file); // Every row so far ends here
+    pthread_mutex_unlock(&writer->mutex); // Unlock the ring
+    return offset;
+}
+
+// Let the writer drain the ring, wait for it and close the file
+int results_close(ResultsWriter *writer) {
+    pthread_mutex_lock(&writer->mutex); // Lock the ring
+    writer->closing = 1; // No more rows follow
+    pthread_cond_signal(&writer->nonempty); // Wake the writer
+    pthread_mutex_unlock(&writer->mutex); // Unlock the ring
+    pthread_join(writer->thread, NULL); // Wait for the remaining rows to be written
+    if (fclose(writer->file) != 0) { // Flush and close the file
+        writer->failed = 1;
+    }
+    pthread_mutex_destroy(&writer->mutex); // Destroy the ring mutex
+    pthread_cond_destroy(&writer->nonempty); // Destroy the ring conditions
+    pthread_cond_destroy(&writer->nonfull);
+    free(writer->ring); // Free the ring
+    if (writer->failed) { // If any row was lost
+        fprintf(stderr, "Failed to write per-process results\n"); // Print an error message
+        return -1; // Report the failure
+    }
+    return 0; // Success
+}
@@ -0,0 +1,47 @@
+//
+// Per-process results: one CSV row per finished process, formatted and written by a background thread
+//
+#ifndef RESULTS_H // If not defined, define RESULTS_H to prevent multiple inclusions
+#define RESULTS_H // Define RESULTS_H
+
+#include <stdio.h> // Include standard I/O library
+#include <pthread.h> // Include pthread library for threading
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+#include "pcb.h" // Include the process control block header file
+
+#define RESULTS_RING 4096 // Finished processes buffered between the simulation and the writer (a power of two)
+#define RESULTS_BUFFER_BYTES (1 << 16) // stdio buffer of the output file
+#define RESULTS_HEADER "id,priority,arrival_ms,completion_ms,waiting_ms,turnaround_ms,bursts,preemptions" // CSV column names
+
+// Define the ProcessResult structure (the columns of one row, captured when the process finishes)
+typedef struct ProcessResult {
+    long id; // Admission order of the process
+    int priority; // Process priority
+    int bursts; // Number of bursts
+    sim_time_t arrival; // Arrival time
+    sim_time_t completion; // Time the last burst ended
+    sim_time_t waiting; // Time spent in the ready queue
+    long preemptions; // Time slices that expired before the burst ended
+} ProcessResult;
+
+// Define the ResultsWriter structure (a preallocated ring drained by the writer thread)
+typedef struct ResultsWriter {
+    FILE *file; // Output file
+    ProcessResult *ring; // RESULTS_RING slots, allocated once when the writer opens
+    unsigned long long head; // Rows recorded so far (next slot to fill)
+    unsigned long long tail; // Rows written so far (next slot to drain)
+    pthread_mutex_t mutex; // Mutex protecting head, tail and closing
+    pthread_cond_t nonempty; // Signalled when rows are recorded or the writer closes
+    pthread_cond_t nonfull; // Signalled when the writer frees slots
+    int closing; // Set once no more rows will be recorded
+    int failed; // Set when a write to the file failed
+    unsigned long long stalls; // Records that waited for a free slot
+    pthread_t thread; // Writer thread
+} ResultsWriter;
+
+int results_open(ResultsWriter *writer, const char *path, long resume_offset); // Function prototype for opening the file and starting the writer thread (a resumed run keeps the first resume_offset bytes; -1 = new file)
+void results_record(ResultsWriter *writer, const PCB *pcb, sim_time_t finish_time); // Function prototype for queueing the row of a finished process (no allocation; waits only while the ring is full)
+long results_sync(ResultsWriter *writer); // Function prototype for waiting until every recorded row reached the file (before a checkpoint; returns its length)
+int results_close(ResultsWriter *writer); // Function prototype for draining the ring, stopping the writer and closing the file (-1 if a write failed)
+
+#endif // RESULTS_H // End of include guard
@@ -0,0 +1,62 @@
+//
+// Periodic streaming metrics snapshots taken while the simulation runs
+//
+#include "sampler.h" // Include the sampler header file
+
+// Emit one sample; every counter is read without taking the queue mutexes
+static void emit_sample(SchedulerContext *ctx, FILE *out, sim_time_t now, sim_time_t window,
+                        sim_time_t busy, sim_time_t prev_busy, int completed, int prev_completed) {
+    SchedulerArgs *args = &ctx->args; // Configuration of the simulation
+    int ready = __atomic_load_n(&ctx->ready_queue.length, __ATOMIC_RELAXED); // Ready queue depth
+    int io = __atomic_load_n(&ctx->io_queue.length, __ATOMIC_RELAXED); // I/O queue depth
+    int in_flight = __atomic_load_n(&ctx->io_wheel.count, __ATOMIC_RELAXED); // I/O bursts on the device
+    sim_time_t turnaround = __atomic_load_n(&ctx->total_turnaround_time, __ATOMIC_RELAXED); // Sum of turnaround times
+    sim_time_t waiting = __atomic_load_n(&ctx->total_waiting_time, __ATOMIC_RELAXED); // Sum of waiting times
+    double utilization = window > 0 ? (double)(busy - prev_busy) / window / ctx->cpu_count : 0.0; // CPU utilization over the window (averaged over the CPUs)
+    double throughput = window > 0 ? (completed - prev_completed) / SIM_TIME_TO_MS(window) : 0.0; // Completions per ms over the window
+    double avg_turnaround = completed ? SIM_TIME_TO_MS(turnaround) / completed : 0.0; // Running average turnaround time (ms)
+    double avg_waiting = completed ? SIM_TIME_TO_MS(waiting) / completed : 0.0; // Running average waiting time (ms)
+
+    if (args->sample_json) { // JSON record per line
+        fprintf(out, "{\"t_ms\":%.3f,\"ready\":%d,\"io_queued\":%d,\"io_in_flight\":%d,"
+                                  "\"cpu_util\":%.4f,\"throughput_per_ms\":%.4f,\"completed\":%d,"
+                                  "\"avg_turnaround_ms\":%.3f,\"avg_waiting_ms\":%.3f}\n",
+                SIM_TIME_TO_MS(now), ready, io, in_flight, utilization, throughput, completed, avg_turnaround, avg_waiting);
+    } else { // Human-readable line
+        fprintf(out, "[sample] t=%.3fms ready=%d io=%d io_in_flight=%d cpu=%.1f%% "
+                                  "throughput=%.4f/ms completed=%d avg_tat=%.3fms avg_wait=%.3fms\n",
+                SIM_TIME_TO_MS(now), ready, io, in_flight, utilization * 100, throughput, completed, avg_turnaround, avg_waiting);
+    }
+    fflush(out); // Make the sample visible immediately
+}
+
+// Sampler thread function
+void *sampler_thread(void *arg) {
+    SchedulerContext *ctx = (SchedulerContext *)arg; // Get the simulation context from the argument
+    SchedulerArgs *args = &ctx->args; // Configuration of the simulation
+    sim_time_t sample_time = args->resume_time; // Simulated time of the previous sample
+    sim_time_t prev_busy = cpu_busy_at(ctx, sample_time); // Busy time at the previous sample
+    int prev_completed = __atomic_load_n(&ctx->process_count, __ATOMIC_RELAXED); // Completions at the previous sample
+
+    while (!simulation_done(ctx)) { // Sample until every process has finished
+        sim_time_t next = sample_time + args->sample_every; // Absolute time of the next sample
+        sim_clock_sleep_until(&ctx->clock, next); // Sleep until the absolute sample time (cancellation point at shutdown)
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL); // Never stop halfway through writing a sample
+        sim_time_t busy = cpu_busy_at(ctx, next); // Busy time up to the sample
+        int completed = __atomic_load_n(&ctx->process_count, __ATOMIC_RELAXED); // Completions so far
+        emit_sample(ctx, args->sample_out, next, next - sample_time, busy, prev_busy, completed, prev_completed); // Write the sample
+        sample_time = next; // Start the next window
+        prev_busy = busy; // Remember the busy time
+        prev_completed = completed; // Remember the completions
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL); // Allow shutdown while sleeping again
+    }
+
+    pthread_exit(NULL); // Exit the thread
+}
+
+// Write one sample covering the whole run so far (answers a live stats request)
+void sampler_report(SchedulerContext *ctx, FILE *out) {
+    sim_time_t now = sim_clock_now(&ctx->clock); // Current simulated time
+    int completed = __atomic_load_n(&ctx->process_count, __ATOMIC_RELAXED); // Completions so far
+    emit_sample(ctx, out, now, now, cpu_busy_at(ctx, now), 0, completed, 0); // Cumulative since time 0
+}
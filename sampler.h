@@ -0,0 +1,12 @@
+//
+// Periodic streaming metrics snapshots taken while the simulation runs
+//
+#ifndef SAMPLER_H // If not defined, define SAMPLER_H to prevent multiple inclusions
+#define SAMPLER_H // Define SAMPLER_H
+
+#include "scheduler.h" // Include the scheduler header file
+
+void *sampler_thread(void *arg); // Function prototype for the metrics sampler thread
+void sampler_report(SchedulerContext *ctx, FILE *out); // Function prototype for writing a cumulative sample on demand
+
+#endif // SAMPLER_H // End of include guard
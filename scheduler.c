@@ -2,339 +2,1141 @@
 // Created by 006li on 7/10/2024.
 //
 #include "scheduler.h" // Include the scheduler header file
+#include "checkpoint.h" // Include the checkpoint header file
+#include "sampler.h" // Include the sampler header file
+#include "trace.h" // Include the trace parsing header file
+#include "service.h" // Include the service mode header file
+#include "metrics.h" // Include the metrics exporter header file
+#include "des.h" // Include the virtual-time engine header file
 
-// Global queues
-Queue ready_queue = {NULL, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER}; // Initialize ready queue
-Queue io_queue = {NULL, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER}; // Initialize IO queue
-int file_read_done = 0; // Flag to indicate file read completion
+#define WORKER_THREADS(ctx) ((ctx)->cpu_count + 1) // CPU and I/O threads that must park before a snapshot
+#define CPU_REPORT_MAX 64 // CPUs listed one per line in the end-of-run metrics
 
-// Enqueue function
-void enqueue(Queue *queue, PCB *pcb) {
-    pthread_mutex_lock(&queue->mutex); // Lock the queue mutex
-    pcb->waiting_time = current_time; // Track the time when the process is enqueued
+// Move the simulated time forward to at least the given time
+static void observe_time(SchedulerContext *ctx, sim_time_t time) {
+    sim_time_t seen = __atomic_load_n(&ctx->current_time, __ATOMIC_SEQ_CST); // Latest time observed so far
+    while (seen < time && !__atomic_compare_exchange_n(&ctx->current_time, &seen, time, 0,
+                                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) { // Retry if another thread moved it
+    }
+}
+
+// Publish a CPU's busy time and the burst in progress (the CPU's own thread or fiber only)
+static void publish_cpu(Cpu *cpu, sim_time_t start, sim_time_t end, sim_time_t completed) {
+    __atomic_add_fetch(&cpu->seq, 1, __ATOMIC_SEQ_CST); // Begin the update (odd)
+    __atomic_store_n(&cpu->burst_start, start, __ATOMIC_RELAXED); // Start of the burst in progress
+    __atomic_store_n(&cpu->burst_end, end, __ATOMIC_RELAXED); // End of the burst in progress
+    __atomic_add_fetch(&cpu->busy_time, completed, __ATOMIC_RELAXED); // Account the completed burst on the CPU
+    __atomic_add_fetch(&cpu->ctx->busy_time, completed, __ATOMIC_RELAXED); // Account it in the total
+    __atomic_add_fetch(&cpu->seq, 1, __ATOMIC_SEQ_CST); // End the update (even)
+}
+
+// Busy time of one CPU up to the given simulated time, including the burst in progress, read without locks
+static sim_time_t cpu_busy_one(Cpu *cpu, sim_time_t time) {
+    while (1) { // Retry until a consistent snapshot is read
+        unsigned seq = __atomic_load_n(&cpu->seq, __ATOMIC_SEQ_CST); // Sequence before reading
+        if (seq & 1) { // If an update is in progress
+            continue; // Try again
+        }
+        sim_time_t busy = __atomic_load_n(&cpu->busy_time, __ATOMIC_RELAXED); // Completed busy time
+        sim_time_t start = __atomic_load_n(&cpu->burst_start, __ATOMIC_RELAXED); // Start of the burst in progress
+        sim_time_t end = __atomic_load_n(&cpu->burst_end, __ATOMIC_RELAXED); // End of the burst in progress
+        if (__atomic_load_n(&cpu->seq, __ATOMIC_SEQ_CST) != seq) { // If the fields changed while reading
+            continue; // Try again
+        }
+        if (time > start) { // If the burst in progress has started
+            busy += (time < end ? time : end) - start; // Add its elapsed part
+        }
+        return busy; // Return the busy time
+    }
+}
+
+// Busy time of every CPU up to the given simulated time, read without locks
+sim_time_t cpu_busy_at(SchedulerContext *ctx, sim_time_t time) {
+    sim_time_t busy = 0; // Sum over the CPUs
+    for (int i = 0; i < ctx->cpu_count; i++) { // Loop through each CPU
+        busy += cpu_busy_one(&ctx->cpus[i], time); // Add its busy time
+    }
+    return busy; // Return the busy time
+}
+
+// Check whether the trace is exhausted and every admitted process has finished
+int simulation_done(SchedulerContext *ctx) {
+    return __atomic_load_n(&ctx->aborted, __ATOMIC_SEQ_CST) || (ctx->file_read_done && __atomic_load_n(&ctx->active_processes, __ATOMIC_SEQ_CST) == 0); // Done when nothing is left anywhere (or the run was abandoned)
+}
+
+// Lock a queue, accounting the real time spent blocked when the mutex is contended
+static inline void queue_lock(Queue *queue) {
+    LOCK_STATS_START(start); // Timestamp the acquisition when lock statistics are compiled in
+    if (pthread_mutex_trylock(&queue->mutex) == 0) { // Fast path: the mutex was free
+        LOCK_STATS_ACQUIRED(&queue->lock_stats, start, 0); // Uncontended acquisition
+        return;
+    }
+    struct timespec begin, end; // Real time around the blocking acquire
+    clock_gettime(CLOCK_MONOTONIC, &begin); // Start of the wait
+    pthread_mutex_lock(&queue->mutex); // Block until the mutex is free
+    clock_gettime(CLOCK_MONOTONIC, &end); // End of the wait
+    long long waited = (end.tv_sec - begin.tv_sec) * 1000000000LL + (end.tv_nsec - begin.tv_nsec); // Nanoseconds blocked
+    __atomic_store_n(&queue->lock_wait_ns, queue->lock_wait_ns + waited, __ATOMIC_RELAXED); // Written under the mutex, read without it
+    LOCK_STATS_ACQUIRED(&queue->lock_stats, start, 1); // Contended acquisition
+}
+
+// Unlock a queue
+static inline void queue_unlock(Queue *queue) {
+    LOCK_STATS_RELEASING(&queue->lock_stats); // Account the hold time
+    pthread_mutex_unlock(&queue->mutex); // Unlock the queue mutex
+}
+
+// Wait on a queue's condition variable (queue mutex held)
+static inline void queue_wait(Queue *queue) {
+    LOCK_STATS_RELEASING(&queue->lock_stats); // The wait releases the mutex
+    if (fiber_current()) { // If running as a fiber
+        fiber_wait(&queue->fiber_waiters, &queue->mutex); // Park the fiber instead of its carrier thread
+    } else {
+        pthread_cond_wait(&queue->cond, &queue->mutex); // Wait for a condition signal
+    }
+    LOCK_STATS_WOKEN(&queue->lock_stats); // The mutex is held again
+}
+
+// Wake one thread or fiber waiting on a queue (queue mutex held)
+static inline void queue_signal(Queue *queue) {
+    pthread_cond_signal(&queue->cond); // Wake a waiting thread
+    fiber_wake_one(&queue->fiber_waiters); // Wake a waiting fiber
+}
+
+// Wake every thread and fiber waiting on a queue (queue mutex held)
+static inline void queue_broadcast(Queue *queue) {
+    pthread_cond_broadcast(&queue->cond); // Wake the waiting threads
+    fiber_wake_all(&queue->fiber_waiters); // Wake the waiting fibers
+}
+
+// Wake every thread blocked on a queue so it can re-check the termination condition
+static void wake_all_queues(SchedulerContext *ctx) {
+    Queue *queues[] = {&ctx->ready_queue, &ctx->io_queue}; // Queues that threads may block on
+    for (int i = 0; i < 2; i++) { // Loop through each queue
+        queue_lock(queues[i]); // Lock so a waiter cannot miss the broadcast
+        queue_broadcast(queues[i]); // Broadcast to all waiting threads
+        queue_unlock(queues[i]); // Unlock the queue mutex
+    }
+}
+
+// Park the calling worker while a checkpoint is being written (called with no PCB in hand)
+static void worker_safe_point(SchedulerContext *ctx) {
+    if (!__atomic_load_n(&ctx->pause_requested, __ATOMIC_SEQ_CST)) { // Fast path: no checkpoint pending
+        return;
+    }
+    pthread_mutex_lock(&ctx->pause_mutex); // Lock the pause state
+    ctx->parked_workers++; // Report this worker as parked
+    pthread_cond_broadcast(&ctx->pause_cond); // Let the checkpointer see the new count
+    while (ctx->pause_requested) { // Wait until the snapshot is written
+        pthread_cond_wait(&ctx->pause_cond, &ctx->pause_mutex); // Wait for a condition signal
+    }
+    ctx->parked_workers--; // Leave the parked state
+    pthread_mutex_unlock(&ctx->pause_mutex); // Unlock the pause state
+}
+
+// Stop the worker threads at their safe points so the queues and the wheel hold every live PCB
+static void pause_workers(SchedulerContext *ctx) {
+    __atomic_store_n(&ctx->pause_requested, 1, __ATOMIC_SEQ_CST); // Ask the workers to park
+    wake_all_queues(ctx); // Wake workers blocked on an empty queue
+    pthread_mutex_lock(&ctx->pause_mutex); // Lock the pause state
+    while (ctx->parked_workers < WORKER_THREADS(ctx)) { // Wait for every worker
+        pthread_cond_wait(&ctx->pause_cond, &ctx->pause_mutex); // Wait for a condition signal
+    }
+    pthread_mutex_unlock(&ctx->pause_mutex); // Unlock the pause state
+}
+
+// Let the parked worker threads continue
+static void resume_workers(SchedulerContext *ctx) {
+    pthread_mutex_lock(&ctx->pause_mutex); // Lock the pause state
+    __atomic_store_n(&ctx->pause_requested, 0, __ATOMIC_SEQ_CST); // Clear the request
+    pthread_cond_broadcast(&ctx->pause_cond); // Release the parked workers
+    pthread_mutex_unlock(&ctx->pause_mutex); // Unlock the pause state
+}
+
+// Record the metrics of a finished process and release it
+static void finish_process(SchedulerContext *ctx, PCB *pcb, sim_time_t finish_time) {
+    pthread_mutex_lock(&ctx->metrics_mutex); // Lock the metrics mutex
+    sim_time_t turnaround_time = finish_time - pcb->arrival_time; // Calculate turnaround time
+    __atomic_add_fetch(&ctx->total_turnaround_time, turnaround_time, __ATOMIC_RELAXED); // Update total turnaround time
+    __atomic_add_fetch(&ctx->total_waiting_time, pcb->waiting_time, __ATOMIC_RELAXED); // Update total waiting time
+    __atomic_add_fetch(&ctx->process_count, 1, __ATOMIC_RELAXED); // Increment process count
+    if (finish_time >= ctx->args.measure_from && finish_time < ctx->args.measure_until) { // If it finished in the measured interval
+        ctx->measured_completions++;
+    }
+    histogram_observe(&ctx->turnaround_hist, turnaround_time); // Record the turnaround distribution
+    histogram_observe(&ctx->waiting_hist, pcb->waiting_time); // Record the waiting distribution
+    pthread_mutex_unlock(&ctx->metrics_mutex); // Unlock the metrics mutex
+    if (ctx->args.results) { // If per-process rows are written
+        results_record(ctx->args.results, pcb, finish_time); // Queue the row for the writer thread
+    }
+    pcb_free(pcb); // Free the PCB
+    if (__atomic_sub_fetch(&ctx->active_processes, 1, __ATOMIC_SEQ_CST) == 0) { // If this was the last live process
+        wake_all_queues(ctx); // Let blocked threads notice a possible end of simulation
+    }
+}
+
+// Run a PCB on a CPU for run_time after overhead (dispatch costs) and return the simulated time the burst ends
+static sim_time_t run_burst(Cpu *cpu, PCB *pcb, sim_time_t overhead, sim_time_t run_time) {
+    SchedulerContext *ctx = cpu->ctx; // Simulation the CPU belongs to
+    sim_time_t start = pcb->ready_time > cpu->cpu_time ? pcb->ready_time : cpu->cpu_time; // Start once both the CPU and the PCB are ready
+    pcb->waiting_time += start - pcb->ready_time; // Accumulate the time spent in the ready queue
+    sim_time_t end = start + overhead + run_time; // Nominal end of the burst, after the dispatch overhead
+    publish_cpu(cpu, start + overhead, end, 0); // Publish the burst in progress (the overhead is not useful work)
+    sim_clock_sleep_until(&ctx->clock, end); // Sleep until the absolute end of the burst
+    publish_cpu(cpu, end, end, run_time); // Update the busy time and mark the CPU idle
+    if (overhead > 0) { // If the dispatch cost CPU time
+        __atomic_add_fetch(&cpu->overhead_time, overhead, __ATOMIC_RELAXED); // Account it on the CPU
+        __atomic_add_fetch(&ctx->overhead_time, overhead, __ATOMIC_RELAXED); // Account it in the total
+    }
+    cpu->cpu_time = end; // The CPU is free again at the end of the burst
+    observe_time(ctx, end); // Update the current time
+    pcb->ready_time = end; // The PCB leaves the CPU at the end of the burst
+    return end; // Return the end of the burst
+}
+
+// Link a PCB at the tail of a queue (queue mutex held)
+static void queue_append(Queue *queue, PCB *pcb) {
     if (queue->tail) { // If the queue is not empty
-        queue->tail->next = pcb; // Add the PCB to the end of the queue
-        pcb->prev = queue->tail; // Set the previous pointer
+        PCB_SET_NEXT(queue->tail, pcb); // Add the PCB to the end of the queue
+        PCB_SET_PREV(pcb, queue->tail); // Set the previous pointer
         queue->tail = pcb; // Update the tail pointer
     } else { // If the queue is empty
         queue->head = queue->tail = pcb; // Set both head and tail to the new PCB
     }
-    pthread_cond_signal(&queue->cond); // Signal that a new item is available
-    pthread_mutex_unlock(&queue->mutex); // Unlock the queue mutex
+    __atomic_store_n(&queue->length, queue->length + 1, __ATOMIC_RELAXED); // Update the queue length
+    LOCK_STATS_ENQUEUED(pcb); // Start the handoff clock
 }
 
-// Dequeue function
-PCB *dequeue(Queue *queue) {
-    pthread_mutex_lock(&queue->mutex); // Lock the queue mutex
-    while (queue->head == NULL && !file_read_done) { // Wait while the queue is empty and file read is not done
-        pthread_cond_wait(&queue->cond, &queue->mutex); // Wait for a condition signal
+// Remove a PCB from anywhere in a queue (queue mutex held)
+void queue_unlink(Queue *queue, PCB *pcb) {
+    PCB *prev = PCB_PREV(pcb), *next = PCB_NEXT(pcb); // Neighbours of the PCB
+    if (prev != NULL) { // If the PCB is not the head
+        PCB_SET_NEXT(prev, next); // Remove it from the queue
+    } else {
+        queue->head = next; // Update the head pointer
+    }
+    if (next != NULL) { // If the PCB is not the tail
+        PCB_SET_PREV(next, prev); // Remove it from the queue
+    } else {
+        queue->tail = prev; // Update the tail pointer
+    }
+    PCB_SET_NEXT(pcb, NULL); // Clear links in the removed PCB
+    PCB_SET_PREV(pcb, NULL);
+    __atomic_store_n(&queue->length, queue->length - 1, __ATOMIC_RELAXED); // Update the queue length
+    LOCK_STATS_HANDOFF(&queue->lock_stats, pcb); // Account the time the PCB spent queued
+}
+
+// Enqueue function
+void enqueue(Queue *queue, PCB *pcb) {
+    queue_lock(queue); // Lock the queue mutex
+    queue_append(queue, pcb); // Link the PCB at the tail
+    queue_signal(queue); // Signal that a new item is available
+    queue_unlock(queue); // Unlock the queue mutex
+}
+
+// Append a PCB to the ready queue and let the policy see it
+static inline __attribute__((always_inline)) void ready_append(SchedulerContext *ctx, const SchedPolicy *policy, PCB *pcb) {
+    queue_lock(&ctx->ready_queue); // Lock the ready queue mutex
+    if (ctx->policy != policy) { // If the policy was switched since the caller read it
+        policy = ctx->policy; // Index the PCB for the active one
+    }
+    queue_append(&ctx->ready_queue, pcb); // Link the PCB at the tail
+    if (policy && policy->on_enqueue) { // If the policy keeps its own ordering
+        policy->on_enqueue(ctx, pcb); // Let it index the PCB
+    }
+    queue_signal(&ctx->ready_queue); // Signal that a new item is available
+    queue_unlock(&ctx->ready_queue); // Unlock the ready queue mutex
+}
+
+// Enqueue a PCB that became ready
+void enqueue_ready(SchedulerContext *ctx, PCB *pcb) {
+    ready_append(ctx, ctx->policy, pcb); // Append through the active policy
+}
+
+// Enqueue a chain of PCBs (linked through next) under one lock acquisition and one wakeup
+void enqueue_batch(Queue *queue, PCB *chain) {
+    if (chain == NULL) { // If there is nothing to move
+        return;
+    }
+    queue_lock(queue); // Lock the queue mutex once for the whole chain
+    while (chain) { // Walk the chain
+        PCB *next = PCB_NEXT(chain); // Remember the next PCB before relinking
+        PCB_SET_NEXT(chain, NULL); // Detach the PCB
+        queue_append(queue, chain); // Link the PCB at the tail
+        chain = next; // Move to the next PCB
     }
-    if (queue->head == NULL) { // If the queue is still empty
-        pthread_mutex_unlock(&queue->mutex); // Unlock the queue mutex
-        return NULL; // Return NULL
+    queue_broadcast(queue); // Wake the waiters once
+    queue_unlock(queue); // Unlock the queue mutex
+}
+
+// Enqueue a chain of PCBs that became ready under one lock acquisition and one wakeup
+void enqueue_ready_batch(SchedulerContext *ctx, PCB *chain) {
+    if (chain == NULL) { // If there is nothing to move
+        return;
+    }
+    queue_lock(&ctx->ready_queue); // Lock the ready queue mutex once for the whole chain
+    const SchedPolicy *policy = ctx->policy; // Policy indexing the ready queue (switches take the mutex)
+    while (chain) { // Walk the chain
+        PCB *next = PCB_NEXT(chain); // Remember the next PCB before relinking
+        PCB_SET_NEXT(chain, NULL); // Detach the PCB
+        queue_append(&ctx->ready_queue, chain); // Link the PCB at the tail
+        if (policy && policy->on_enqueue) { // If the policy keeps its own ordering
+            policy->on_enqueue(ctx, chain); // Let it index the PCB
+        }
+        chain = next; // Move to the next PCB
+    }
+    queue_broadcast(&ctx->ready_queue); // Wake the waiters once
+    queue_unlock(&ctx->ready_queue); // Unlock the ready queue mutex
+}
+
+// Wait while a queue is empty and processes are still live (queue mutex held)
+static void queue_wait_nonempty(SchedulerContext *ctx, Queue *queue) {
+    for (int woken = 0; queue->head == NULL && !simulation_done(ctx) && !ctx->pause_requested; woken = 1) { // Wait while the queue is empty and processes are still live
+        if (woken) { // Woken up, but there is still nothing to do
+            LOCK_STATS_SPURIOUS(&queue->lock_stats); // Count the spurious wakeup
+        }
+        queue_wait(queue); // Wait for a condition signal
     }
+}
+
+// Dequeue function
+PCB *dequeue(SchedulerContext *ctx, Queue *queue) {
+    queue_lock(queue); // Lock the queue mutex
+    queue_wait_nonempty(ctx, queue); // Block until there is something to take
     PCB *pcb = queue->head; // Get the head PCB
-    queue->head = pcb->next; // Move the head pointer to the next PCB
-    if (queue->head == NULL) { // If the queue is now empty
-        queue->tail = NULL; // Set the tail to NULL
-    } else {
-        queue->head->prev = NULL; // Clear the previous pointer of the new head
+    if (pcb != NULL) { // If the queue is not empty
+        queue_unlink(queue, pcb); // Remove it from the queue
     }
-    pcb->next = pcb->prev = NULL; // Clear pointers in the dequeued PCB
-    pthread_mutex_unlock(&queue->mutex); // Unlock the queue mutex
-    pcb->waiting_time = current_time - pcb->waiting_time; // Update the waiting time
-    return pcb; // Return the dequeued PCB
+    queue_unlock(queue); // Unlock the queue mutex
+    return pcb; // Return the dequeued PCB (NULL if none)
 }
 
-// File read thread function
-void *file_read_thread(void *arg) {
-    char *filename = (char *)arg; // Get the filename from the argument
-    FILE *file = fopen(filename, "r"); // Open the file for reading
-    if (!file) { // If the file cannot be opened
-        perror("Failed to open input file"); // Print an error message
-        pthread_exit(NULL); // Exit the thread
+// Dequeue up to max PCBs (0 = all) under one lock acquisition; returns a chain linked through next
+PCB *dequeue_batch(SchedulerContext *ctx, Queue *queue, int max) {
+    queue_lock(queue); // Lock the queue mutex
+    queue_wait_nonempty(ctx, queue); // Block until there is something to take
+    PCB *head = NULL, *tail = NULL; // Chain being built
+    for (int taken = 0; queue->head != NULL && (max <= 0 || taken < max); taken++) { // Take from the head
+        PCB *pcb = queue->head; // Get the head PCB
+        queue_unlink(queue, pcb); // Remove it from the queue
+        if (tail) { // If the chain is not empty
+            PCB_SET_NEXT(tail, pcb); // Link the PCB after the tail
+        } else {
+            head = pcb; // The PCB starts the chain
+        }
+        tail = pcb; // Update the tail
     }
+    queue_unlock(queue); // Unlock the queue mutex
+    return head; // Return the chain (NULL if none)
+}
 
-    char line[256]; // Buffer to store each line of the file
-    while (fgets(line, sizeof(line), file)) { // Read each line of the file
-        if (strncmp(line, "proc", 4) == 0) { // If the line starts with "proc"
-            PCB *pcb = malloc(sizeof(PCB)); // Allocate memory for a new PCB
-            if (pcb == NULL) { // If memory allocation fails
-                perror("Failed to allocate memory for PCB"); // Print an error message
-                continue; // Skip to the next line
+// Define the ReaderState structure (trace position and the arrivals not yet enqueued)
+typedef struct ReaderState {
+    sim_time_t read_time; // Simulated time reached by the trace
+    sim_time_t next_checkpoint; // Trace time of the next snapshot
+    PCB *batch_head; // First arrival waiting to be enqueued
+    PCB *batch_tail; // Last arrival waiting to be enqueued
+    int batch_count; // Number of arrivals waiting to be enqueued
+    long admitted; // Processes admitted so far, restored ones included (numbers the next one)
+} ReaderState;
+
+#define READER_BATCH_MAX 256 // Arrivals held back at most before they are enqueued
+
+// Enqueue the arrivals collected since the last flush in one batch
+static void flush_arrivals(SchedulerContext *ctx, ReaderState *state) {
+    if (state->batch_count == 0) { // If nothing arrived
+        return;
+    }
+    __atomic_add_fetch(&ctx->active_processes, state->batch_count, __ATOMIC_SEQ_CST); // Count the processes as live
+    enqueue_ready_batch(ctx, state->batch_head); // Move them to the ready queue at once
+    state->batch_head = state->batch_tail = NULL; // Start a new batch
+    state->batch_count = 0;
+}
+
+// Apply one trace event in file order; returns 1 once the trace says stop
+static int replay_event(SchedulerContext *ctx, TraceEvent *event, ReaderState *state) {
+    SchedulerArgs *args = &ctx->args; // Configuration of the simulation
+    switch (event->kind) {
+    case TRACE_PROC: { // A new process arrives
+        PCB *pcb = event->pcb; // Take ownership of the parsed PCB
+        event->pcb = NULL;
+        pcb->arrival_time = state->read_time; // Set the arrival time
+        pcb->ready_time = state->read_time; // The process is ready on arrival
+        pcb->id = ++state->admitted; // Number it in admission order
+        if (ctx->groups) { // If processes share the CPUs by group
+            int group = event->group ? group_find(ctx->groups, event->group, event->group_length) : 0; // Leaf named by the line
+            if (group < 0) { // If no such leaf was defined
+                SCHED_LOG(ctx, "Unknown group, using default: %.*s\n", event->text_length, event->text); // Print debug info
+                group = 0; // Fall back to the default group
+            }
+            pcb->group = group;
+        }
+        if (state->batch_tail) { // If the batch is not empty
+            PCB_SET_NEXT(state->batch_tail, pcb); // Add the PCB to the batch
+        } else {
+            state->batch_head = pcb; // The PCB starts the batch
+        }
+        state->batch_tail = pcb; // Update the batch tail
+        if (++state->batch_count >= READER_BATCH_MAX) { // Do not hold back too many arrivals
+            flush_arrivals(ctx, state); // Enqueue the batch
+        }
+        SCHED_LOG(ctx, "Enqueued process with priority %d and %d bursts\n", pcb->priority, pcb->burst_count); // Print debug info
+        return 0;
+    }
+    case TRACE_SLEEP: // The trace time advances
+        flush_arrivals(ctx, state); // Everything before the sleep arrives now
+        SCHED_LOG(ctx, "Sleeping for %.3f ms\n", SIM_TIME_TO_MS(event->sleep_time)); // Print debug info
+        state->read_time += event->sleep_time; // Advance the trace time
+        sim_clock_sleep_until(&ctx->clock, state->read_time); // Sleep until the absolute arrival time
+        observe_time(ctx, state->read_time); // Update the current time
+        if (args->checkpoint_file && state->read_time >= state->next_checkpoint) { // If a snapshot is due
+            CheckpointPosition position = {event->end_offset, state->read_time, -1}; // Resume after this line
+            pause_workers(ctx); // Park the CPU and I/O threads
+            if (args->results) { // If per-process rows are written
+                position.results_offset = results_sync(args->results); // A resumed run appends after the rows finished so far
             }
-            int burst_count;
-            sscanf(line, "proc %d %d", &pcb->priority, &burst_count); // Parse the priority and burst count
-            pcb->burst_count = burst_count; // Set the burst count
-            pcb->bursts = malloc(burst_count * sizeof(int)); // Allocate memory for the bursts
-            if (pcb->bursts == NULL) { // If memory allocation fails
-                perror("Failed to allocate memory for bursts"); // Print an error message
-                free(pcb); // Free the PCB memory
-                continue; // Skip to the next line
+            if (checkpoint_save(ctx, args->checkpoint_file, &position) == 0) { // Write the snapshot
+                SCHED_LOG(ctx, "Checkpoint written at %.3f ms\n", SIM_TIME_TO_MS(state->read_time)); // Print debug info
             }
-            char *token = strtok(line + 5, " "); // Tokenize the line to get burst times
-            for (int i = 0; i < burst_count; ++i) { // Loop through each burst
-                token = strtok(NULL, " "); // Get the next token
-                pcb->bursts[i] = atoi(token); // Convert token to integer and store in bursts
+            resume_workers(ctx); // Let the CPU and I/O threads continue
+            while (state->next_checkpoint <= state->read_time) { // Skip snapshots missed by long sleeps
+                state->next_checkpoint += args->checkpoint_every; // Schedule the next snapshot
             }
-            pcb->current_burst = 0; // Initialize current burst index
-            pcb->arrival_time = current_time; // Set the arrival time
-            pcb->waiting_time = 0; // Initialize waiting time
-            pcb->turnaround_time = 0; // Initialize turnaround time
-            pcb->prev = pcb->next = NULL; // Clear pointers
-            enqueue(&ready_queue, pcb); // Enqueue the PCB to the ready queue
-            printf("Enqueued process with priority %d and %d bursts\n", pcb->priority, burst_count); // Print debug info
-        } else if (strncmp(line, "sleep", 5) == 0) { // If the line starts with "sleep"
-            int sleep_time;
-            sscanf(line, "sleep %d", &sleep_time); // Parse the sleep time
-            printf("Sleeping for %d ms\n", sleep_time); // Print debug info
-            usleep(sleep_time * 1000); // Sleep for the specified time
-            current_time += sleep_time; // Update the current time
-        } else if (strncmp(line, "stop", 4) == 0) { // If the line starts with "stop"
-            printf("Stopping file read thread\n"); // Print debug info
-            break; // Exit the loop
-        } else { // If the line is unrecognized
-            printf("Unknown command: %s\n", line); // Print debug info
         }
+        return 0;
+    case TRACE_STOP: // The trace ends
+        SCHED_LOG(ctx, "Stopping file read thread\n"); // Print debug info
+        return 1;
+    case TRACE_POLICY: // The scheduling policy changes
+        flush_arrivals(ctx, state); // Earlier arrivals are queued under the old policy first
+        if (scheduler_switch_policy(ctx, event->policy, event->quantum) != 0) { // Rebuild the ready ordering
+            SCHED_LOG(ctx, "Policy switch needs a quantum: %.*s\n", event->text_length, event->text); // Print debug info
+            return 0;
+        }
+        SCHED_LOG(ctx, "Switched to policy %s at %.3f ms\n", event->policy->name, SIM_TIME_TO_MS(state->read_time)); // Print debug info
+        return 0;
+    case TRACE_MALFORMED: // A proc, sleep or policy line could not be parsed
+        SCHED_LOG(ctx, "Malformed line: %.*s\n", event->text_length, event->text); // Print debug info
+        return 0;
+    default: // If the line is unrecognized
+        SCHED_LOG(ctx, "Unknown command: %.*s\n", event->text_length, event->text); // Print debug info
+        return 0;
     }
+}
 
+// Replay the trace line by line on the reader thread
+static void read_trace_sequential(SchedulerContext *ctx, ReaderState *state) {
+    SchedulerArgs *args = &ctx->args; // Configuration of the simulation
+    FILE *file = fopen(args->input_file, "r"); // Open the file for reading
+    if (!file) { // If the file cannot be opened
+        perror("Failed to open input file"); // Print an error message
+        ctx->read_failed = 1; // Report the failure from scheduler_run
+        return;
+    }
+    if (args->resume_offset > 0 && fseek(file, args->resume_offset, SEEK_SET) != 0) { // Continue after the checkpointed line
+        perror("Failed to seek input file"); // Print an error message
+        fclose(file); // Close the file
+        ctx->read_failed = 1; // Reading from the start would admit the restored processes again
+        return;
+    }
+    char line[TRACE_LINE_MAX]; // Buffer to store each line of the file
+    while (fgets(line, sizeof(line), file)) { // Read each line of the file
+        TraceEvent event; // Parsed line
+        trace_parse_line(line, strlen(line), &event); // Parse the line
+        event.end_offset = ftell(file); // Where a resume would continue
+        if (replay_event(ctx, &event, state)) { // Apply it
+            break; // Exit the loop at stop
+        }
+    }
     fclose(file); // Close the file
-    pthread_mutex_lock(&ready_queue.mutex); // Lock the ready queue mutex
-    file_read_done = 1; // Set the file read done flag
-    pthread_cond_broadcast(&ready_queue.cond); // Broadcast to all waiting threads
-    pthread_mutex_unlock(&ready_queue.mutex); // Unlock the ready queue mutex
-    pthread_exit(NULL); // Exit the thread
 }
 
-// CPU scheduler thread function
-void *cpu_scheduler_thread(void *arg) {
-    SchedulerArgs *args = (SchedulerArgs *)arg; // Get the scheduler arguments from the argument
-    if (strcmp(args->algorithm, "FIFO") == 0) { // If the algorithm is FIFO
-        run_fifo(); // Run FIFO scheduling
-    } else if (strcmp(args->algorithm, "SJF") == 0) { // If the algorithm is SJF
-        run_sjf(); // Run SJF scheduling
-    } else if (strcmp(args->algorithm, "PR") == 0) { // If the algorithm is PR
-        run_pr(); // Run PR scheduling
-    } else if (strcmp(args->algorithm, "RR") == 0) { // If the algorithm is RR
-        run_rr(args->quantum); // Run RR scheduling with the specified quantum
+// Replay the records of a parsed workload image on the reader thread
+static void read_workload(SchedulerContext *ctx, ReaderState *state) {
+    const Workload *workload = ctx->args.workload; // Image shared with every other run
+    for (long i = ctx->args.resume_offset; i < workload->header->record_count; i++) { // Loop through each record from the resume point
+        TraceEvent event; // Replayed line
+        workload_event(workload, i, &event); // Give it a PCB of this run's own
+        event.end_offset = i + 1; // Where a resume would continue
+        if (replay_event(ctx, &event, state)) { // Apply it
+            break; // Exit the loop at stop
+        }
     }
-    pthread_exit(NULL); // Exit the thread
 }
 
-// I/O system thread function
-void *io_system_thread(void *arg) {
-    while (1) { // Infinite loop
-        PCB *pcb = dequeue(&io_queue); // Dequeue a PCB from the IO queue
-        if (!pcb) { // If no PCB is dequeued
-            if (file_read_done && ready_queue.head == NULL && io_queue.head == NULL) { // Check for termination condition
-                break; // Exit the loop
+// Replay the trace in file order while a thread pool parses the chunks ahead of it
+static void read_trace_parallel(SchedulerContext *ctx, ReaderState *state) {
+    SchedulerArgs *args = &ctx->args; // Configuration of the simulation
+    TraceReader *reader = trace_reader_open(args->input_file, args->resume_offset, args->parse_threads); // Map the file and start the parsers
+    if (!reader) { // If the file cannot be mapped
+        ctx->read_failed = 1; // Report the failure from scheduler_run
+        return;
+    }
+    int stop = 0; // Set once the trace says stop
+    TraceChunk *chunk; // Next chunk in file order
+    while (!stop && (chunk = trace_reader_next(reader)) != NULL) { // Wait for each chunk in turn
+        for (int i = 0; i < chunk->count && !stop; i++) { // Loop through its events
+            stop = replay_event(ctx, &chunk->events[i], state); // Apply the event
+        }
+        trace_reader_release(reader, chunk); // Let a parser reuse the slot
+    }
+    trace_reader_close(reader); // Stop the parsers and free PCBs parsed past the stop line
+}
+
+// Serve trace commands from a FIFO or socket until a client sends stop
+static void read_service(SchedulerContext *ctx, ReaderState *state) {
+    Service service; // Endpoint the commands arrive on
+    if (service_open(&service, ctx->args.service_path, ctx->args.service_fifo) != 0) { // Create the FIFO or socket
+        ctx->read_failed = 1; // Report the failure from scheduler_run
+        return;
+    }
+    printf("Serving on %s\n", ctx->args.service_path); // Tell the operator where to connect
+    fflush(stdout); // Make the banner visible before blocking
+    int stop = 0; // Set once a client sends stop
+    while (!stop && service_accept(&service) == 0) { // Serve one client at a time
+        char line[TRACE_LINE_MAX]; // Buffer to store each command
+        while (!stop && fgets(line, sizeof(line), service.in)) { // Read each command
+            if (strncmp(line, "stats", 5) == 0) { // If the client asks for live metrics
+                sampler_report(ctx, service.reply ? service.reply : stdout); // Answer with a cumulative sample
+                continue; // Read the next command
             }
-            continue; // Continue to the next iteration
+            TraceEvent event; // Parsed command
+            trace_parse_line(line, strlen(line), &event); // Parse the command
+            event.end_offset = 0; // A stream has no resumable offset
+            sim_time_t now = sim_clock_now(&ctx->clock); // Commands arrive in real time
+            if (event.kind == TRACE_PROC && state->read_time < now) { // If the client was idle
+                state->read_time = now; // The process arrives now
+            }
+            stop = replay_event(ctx, &event, state); // Apply the command
+            flush_arrivals(ctx, state); // Live arrivals are not held back
         }
+        service_hangup(&service); // Drop the client
+    }
+    service_close(&service); // Remove the endpoint
+    observe_time(ctx, sim_clock_now(&ctx->clock)); // Idle time up to the shutdown counts towards the run
+}
 
-        // Simulate I/O burst
-        usleep(pcb->bursts[pcb->current_burst] * 1000); // Sleep for the burst time
-        current_time += pcb->bursts[pcb->current_burst]; // Update the current time
+// File read thread function
+void *file_read_thread(void *arg) {
+    SchedulerContext *ctx = (SchedulerContext *)arg; // Get the simulation context from the argument
+    ReaderState state = {ctx->args.resume_time, ctx->args.resume_time + ctx->args.checkpoint_every, NULL, NULL, 0,
+                         ctx->process_count + ctx->active_processes}; // Start at the (resumed) trace time, numbering after the restored processes
+    if (ctx->args.service_path) { // If running as a service
+        read_service(ctx, &state);
+    } else if (ctx->args.workload) { // If the trace was parsed ahead of the run
+        read_workload(ctx, &state);
+    } else if (ctx->args.parse_threads > 0) { // If pre-parsing on a thread pool
+        read_trace_parallel(ctx, &state);
+    } else {
+        read_trace_sequential(ctx, &state);
+    }
+    flush_arrivals(ctx, &state); // Enqueue arrivals after the last sleep
+    ctx->file_read_done = 1; // Set the file read done flag
+    wake_all_queues(ctx); // Broadcast to all waiting threads
+    return NULL; // Exit the thread (or fiber)
+}
 
-        pcb->current_burst++; // Increment the current burst index
-        if (pcb->current_burst < pcb->burst_count) { // If there are more bursts
-            enqueue(&ready_queue, pcb); // Enqueue the PCB back to the ready queue
-            printf("Processed I/O for process\n"); // Print debug info
+// CPU scheduler thread function (one per simulated CPU)
+void *cpu_scheduler_thread(void *arg) {
+    Cpu *cpu = (Cpu *)arg; // Get the simulated CPU from the argument
+    do { // An instance returns when the policy is switched under it
+        const SchedPolicy *policy = __atomic_load_n(&cpu->ctx->policy, __ATOMIC_ACQUIRE); // Active policy
+        if (policy == &fifo_policy) { // Built-in policies run their specialised instances
+            run_fifo(cpu); // Run FIFO scheduling
+        } else if (policy == &sjf_policy) {
+            run_sjf(cpu); // Run SJF scheduling
+        } else if (policy == &pr_policy) {
+            run_pr(cpu); // Run PR scheduling
+        } else if (policy == &rr_policy) {
+            run_rr(cpu); // Run RR scheduling with the configured quantum
         } else {
-            // Process finished during I/O
-            printf("Process finished during I/O with priority %d\n", pcb->priority); // Print debug info
-            pcb->turnaround_time = current_time - pcb->arrival_time; // Calculate turnaround time
-            total_turnaround_time += pcb->turnaround_time; // Update total turnaround time
-            total_waiting_time += pcb->waiting_time; // Update total waiting time
-            process_count++; // Increment process count
-            free(pcb->bursts); // Free the bursts array
-            free(pcb); // Free the PCB
+            run_policy(cpu, policy); // Run a custom policy through the generic loop
         }
+    } while (!simulation_done(cpu->ctx)); // Until every process has finished
+    return NULL; // Exit the thread (or fiber)
+}
+
+// Start the current I/O burst of a PCB on the device
+static void io_start(SchedulerContext *ctx, PCB *pcb, sim_time_t tick) {
+    TimingWheel *wheel = &ctx->io_wheel; // Wheel holding the in-flight I/O bursts
+    sim_time_t now = wheel->now * tick; // Simulated time of the wheel's current tick
+    sim_time_t start = pcb->ready_time > now ? pcb->ready_time : now; // Start once both the device and the request are ready
+    sim_time_t waited = start - pcb->ready_time; // Time the request spent in the I/O queue
+    int write = PCB_IS_WRITE(pcb); // Direction of the request
+    __atomic_add_fetch(&ctx->io_requests[write], 1, __ATOMIC_RELAXED); // Count the request
+    __atomic_add_fetch(&ctx->io_wait_total[write], waited, __ATOMIC_RELAXED); // Add its wait
+    if (waited > ctx->io_wait_max[write]) { // If no request of this direction waited longer
+        __atomic_store_n(&ctx->io_wait_max[write], waited, __ATOMIC_RELAXED); // Only the I/O thread writes it
     }
+    histogram_observe(&ctx->io_wait_hist, waited); // Record the wait distribution
+    sim_time_t done = start + pcb->remaining; // Completion time of the burst
+    tw_insert(wheel, pcb, (long)((done + tick - 1) / tick)); // Complete on the first tick at or after the completion time
+}
 
-    pthread_exit(NULL); // Exit the thread
+// Start every I/O burst of a dequeued chain
+static void io_start_batch(SchedulerContext *ctx, PCB *batch, sim_time_t tick) {
+    while (batch) { // Walk the chain
+        PCB *pcb = batch; // Take the first PCB
+        batch = PCB_NEXT(pcb); // Move to the next PCB
+        PCB_SET_NEXT(pcb, NULL); // Detach it before the wheel relinks it
+        io_start(ctx, pcb, tick); // Start the I/O burst
+    }
 }
 
-// FIFO scheduling function
-void run_fifo() {
-    while (1) { // Infinite loop
-        PCB *pcb = dequeue(&ready_queue); // Dequeue a PCB from the ready queue
-        if (!pcb) { // If no PCB is dequeued
-            if (file_read_done && ready_queue.head == NULL && io_queue.head == NULL) { // Check for termination condition
-                break; // Exit the loop
+// Dequeue up to max I/O requests (0 = all) in the order the I/O policy serves them, under one lock acquisition
+static PCB *io_dequeue_batch(SchedulerContext *ctx, int max, sim_time_t tick) {
+    Queue *queue = &ctx->io_queue; // Queue the policy picks from
+    queue_lock(queue); // Lock the queue mutex
+    queue_wait_nonempty(ctx, queue); // Block until there is something to take
+    if (queue->head != NULL && ctx->io_wheel.count == 0) { // If the device is idle
+        sim_time_t oldest = queue->head->ready_time; // Arrival of the oldest request (one CPU queues them in time order)
+        for (PCB *pcb = ctx->cpu_count > 1 ? PCB_NEXT(queue->head) : NULL; pcb != NULL; pcb = PCB_NEXT(pcb)) { // Several CPUs queue on their own timelines, so scan the queue
+            if (pcb->ready_time < oldest) { // Find the oldest request
+                oldest = pcb->ready_time;
             }
-            continue; // Continue to the next iteration
         }
-        int burst_time = pcb->bursts[pcb->current_burst]; // Get the burst time of the current burst
-        printf("Running process with priority %d for %d ms\n", pcb->priority, burst_time); // Print debug info
-        usleep(burst_time * 1000); // Sleep for the burst time
-        busy_time += burst_time; // Update the busy time
-        current_time += burst_time; // Update the current time
-        pcb->current_burst++; // Increment the current burst index
-        if (pcb->current_burst < pcb->burst_count) { // If there are more bursts
-            enqueue(&io_queue, pcb); // Enqueue the PCB to the IO queue
+        if (oldest / tick > ctx->io_wheel.now) { // If the device idled past the oldest request's arrival
+            tw_init(&ctx->io_wheel, (long)(oldest / tick)); // Restart the empty wheel at the arrival tick
+        }
+    }
+    sim_time_t now = ctx->io_wheel.now * tick; // Device time the requests are judged at
+    PCB *head = NULL, *tail = NULL; // Chain being built
+    for (int taken = 0; queue->head != NULL && (max <= 0 || taken < max); taken++) { // Take requests in policy order
+        PCB *pcb = ctx->io_policy->pick_next(ctx, now); // Let the policy pick and unlink
+        if (tail) { // If the chain is not empty
+            PCB_SET_NEXT(tail, pcb); // Link the PCB after the tail
         } else {
-            printf("Process finished with priority %d\n", pcb->priority); // Print debug info
-            pcb->turnaround_time = current_time - pcb->arrival_time; // Calculate turnaround time
-            total_turnaround_time += pcb->turnaround_time; // Update total turnaround time
-            total_waiting_time += pcb->waiting_time; // Update total waiting time
-            process_count++; // Increment process count
-            free(pcb->bursts); // Free the bursts array
-            free(pcb); // Free the PCB
+            head = pcb; // The PCB starts the chain
         }
+        tail = pcb; // Update the tail
     }
+    queue_unlock(queue); // Unlock the queue mutex
+    return head; // Return the chain (NULL if none)
 }
 
-// SJF scheduling function
-void run_sjf() {
-    while (1) { // Infinite loop
-        PCB *shortest_pcb = NULL; // Pointer to the shortest PCB
-        PCB *current = ready_queue.head; // Pointer to the current PCB in the queue
+// I/O system thread function
+void *io_system_thread(void *arg) {
+    SchedulerContext *ctx = (SchedulerContext *)arg; // Get the simulation context from the argument
+    SchedulerArgs *args = &ctx->args; // Configuration of the simulation
+    sim_time_t tick = args->io_tick; // Simulated length of one wheel tick
+    TimingWheel *wheel = &ctx->io_wheel; // Wheel holding the in-flight I/O bursts (restored by -resume)
 
-        pthread_mutex_lock(&ready_queue.mutex); // Lock the ready queue mutex
-        while (current != NULL) { // Iterate through the queue
-            if (shortest_pcb == NULL || current->bursts[current->current_burst] < shortest_pcb->bursts[shortest_pcb->current_burst]) { // Find the shortest burst
-                shortest_pcb = current; // Update the shortest PCB
+    while (1) { // Infinite loop
+        worker_safe_point(ctx); // Park here while a checkpoint is written
+        if (wheel->count == 0) { // If the device is idle
+            PCB *batch = io_dequeue_batch(ctx, args->io_depth, tick); // Block until I/O requests arrive, then take as many as the device serves
+            if (!batch) { // If no PCB is dequeued
+                if (simulation_done(ctx)) { // Check for termination condition
+                    break; // Exit the loop
+                }
+                continue; // Continue to the next iteration
             }
-            current = current->next; // Move to the next PCB
+            io_start_batch(ctx, batch, tick); // Start the I/O bursts
+            continue; // Simulate the tick on the next iteration
+        }
+        if (ctx->io_queue.head != NULL && (args->io_depth == 0 || wheel->count < args->io_depth)) { // Admit queued requests while the device has capacity
+            io_start_batch(ctx, io_dequeue_batch(ctx, args->io_depth == 0 ? 0 : args->io_depth - wheel->count, tick), tick); // Take them under one lock acquisition
         }
 
-        if (shortest_pcb != NULL) { // If a shortest PCB is found
-            if (shortest_pcb->prev != NULL) { // If the shortest PCB is not the head
-                shortest_pcb->prev->next = shortest_pcb->next; // Remove it from the queue
+        // Simulate one tick of the device
+        sim_clock_sleep_until(&ctx->clock, (wheel->now + 1) * tick); // Sleep until the absolute start of the next tick
+        PCB *expired = tw_advance(wheel); // Collect every I/O burst completing at this tick
+        sim_time_t now = wheel->now * tick; // Simulated time of the new tick
+        observe_time(ctx, now); // Update the current time
+        PCB *ready_head = NULL, *ready_tail = NULL; // PCBs returning to the ready queue at this tick
+        while (expired) { // Release the expired batch
+            PCB *pcb = expired; // Take the first expired PCB
+            expired = PCB_NEXT(pcb); // Move to the next expired PCB
+            PCB_SET_NEXT(pcb, NULL); // Clear links before requeueing
+            PCB_SET_PREV(pcb, NULL);
+            pcb->ready_time = now; // The I/O burst completed at this tick
+            if (pcb_advance(pcb)) { // If there are more bursts
+                if (ready_tail) { // If the chain is not empty
+                    PCB_SET_NEXT(ready_tail, pcb); // Link the PCB after the tail
+                } else {
+                    ready_head = pcb; // The PCB starts the chain
+                }
+                ready_tail = pcb; // Update the tail
+                SCHED_LOG(ctx, "Processed I/O for process\n"); // Print debug info
             } else {
-                ready_queue.head = shortest_pcb->next; // Update the head pointer
+                // Process finished during I/O
+                SCHED_LOG(ctx, "Process finished during I/O with priority %d\n", pcb->priority); // Print debug info
+                finish_process(ctx, pcb, now); // Record metrics and free the PCB
             }
+        }
+        enqueue_ready_batch(ctx, ready_head); // Move the PCBs back to the ready queue at once
+    }
 
-            if (shortest_pcb->next != NULL) { // If the shortest PCB is not the tail
-                shortest_pcb->next->prev = shortest_pcb->prev; // Remove it from the queue
-            } else {
-                ready_queue.tail = shortest_pcb->prev; // Update the tail pointer
-            }
-            shortest_pcb->next = shortest_pcb->prev = NULL; // Clear the pointers
+    return NULL; // Exit the thread (or fiber)
+}
+
+// Pick the PCB at the head of the ready queue (FIFO and RR)
+static PCB *pick_head(SchedulerContext *ctx) {
+    PCB *pcb = ctx->ready_queue.head; // Oldest ready PCB
+    queue_unlink(&ctx->ready_queue, pcb); // Remove it from the queue
+    return pcb; // Return the picked PCB
+}
+
+// Pick the PCB with the shortest next CPU burst (SJF)
+static PCB *pick_shortest(SchedulerContext *ctx) {
+    PCB *shortest_pcb = ctx->ready_queue.head; // Pointer to the shortest PCB
+    for (PCB *current = PCB_NEXT(shortest_pcb); current != NULL; current = PCB_NEXT(current)) { // Iterate through the queue
+        if (current->remaining < shortest_pcb->remaining) { // Find the shortest burst
+            shortest_pcb = current; // Update the shortest PCB
+        }
+    }
+    queue_unlink(&ctx->ready_queue, shortest_pcb); // Remove it from the queue
+    return shortest_pcb; // Return the picked PCB
+}
+
+// Pick the PCB with the highest priority (PR)
+static PCB *pick_highest_priority(SchedulerContext *ctx) {
+    PCB *highest_priority_pcb = ctx->ready_queue.head; // Pointer to the highest priority PCB
+    for (PCB *current = PCB_NEXT(highest_priority_pcb); current != NULL; current = PCB_NEXT(current)) { // Iterate through the queue
+        if (current->priority > highest_priority_pcb->priority) { // Find the highest priority
+            highest_priority_pcb = current; // Update the highest priority PCB
+        }
+    }
+    queue_unlink(&ctx->ready_queue, highest_priority_pcb); // Remove it from the queue
+    return highest_priority_pcb; // Return the picked PCB
+}
+
+// Give every dispatched PCB the configured quantum (RR)
+static sim_time_t quantum_slice(SchedulerContext *ctx, PCB *pcb) {
+    (void)pcb; // Every PCB gets the same slice
+    return __atomic_load_n(&ctx->args.quantum, __ATOMIC_RELAXED); // Time quantum for round-robin scheduling (a policy line may change it)
+}
+
+// Index a newly ready PCB in the SoA ready set (SJF-SOA and PR-SOA)
+static void soa_index(SchedulerContext *ctx, PCB *pcb) {
+    if (rs_insert(&ctx->ready_set, pcb) != 0) { // If the set cannot grow
+        perror("Failed to grow the ready set"); // The PCB stays reachable through the list
+    }
+}
+
+// Unlink a PCB picked from the SoA ready set, or fall back to the list head for unindexed PCBs
+static PCB *soa_take(SchedulerContext *ctx, PCB *pcb) {
+    if (pcb == NULL) { // If nothing is indexed
+        pcb = ctx->ready_queue.head; // Take the oldest unindexed PCB
+    }
+    rs_remove(&ctx->ready_set, pcb); // Drop its entry
+    queue_unlink(&ctx->ready_queue, pcb); // Remove it from the queue
+    return pcb; // Return the picked PCB
+}
+
+// Pick the PCB with the shortest next CPU burst with a vectorised scan (SJF-SOA)
+static PCB *pick_soa_shortest(SchedulerContext *ctx) {
+    return soa_take(ctx, rs_min_burst(&ctx->ready_set)); // Scan the burst array
+}
+
+// Pick the PCB with the highest priority with a vectorised scan (PR-SOA)
+static PCB *pick_soa_highest_priority(SchedulerContext *ctx) {
+    return soa_take(ctx, rs_max_priority(&ctx->ready_set)); // Scan the priority array
+}
+
+const SchedPolicy fifo_policy = {"FIFO", pick_head, NULL, NULL, NULL, NULL}; // First-in first-out
+const SchedPolicy sjf_policy = {"SJF", pick_shortest, NULL, NULL, NULL, NULL}; // Shortest next burst first
+const SchedPolicy pr_policy = {"PR", pick_highest_priority, NULL, NULL, NULL, NULL}; // Highest priority first
+const SchedPolicy rr_policy = {"RR", pick_head, NULL, NULL, quantum_slice, NULL}; // Round robin with the configured quantum
+const SchedPolicy sjf_soa_policy = {"SJF-SOA", pick_soa_shortest, soa_index, NULL, NULL, NULL}; // SJF over the SoA ready set
+const SchedPolicy pr_soa_policy = {"PR-SOA", pick_soa_highest_priority, soa_index, NULL, NULL, NULL}; // PR over the SoA ready set
+
+// Look up a built-in policy by its -alg name
+const SchedPolicy *policy_find(const char *name) {
+    const SchedPolicy *builtins[] = {&fifo_policy, &sjf_policy, &pr_policy, &rr_policy, &sjf_soa_policy, &pr_soa_policy}; // Built-in policies
+    for (size_t i = 0; name != NULL && i < sizeof(builtins) / sizeof(builtins[0]); i++) { // Loop through each policy
+        if (strcmp(name, builtins[i]->name) == 0) { // If the name matches
+            return builtins[i]; // Return the policy
+        }
+    }
+    return NULL; // Unknown policy
+}
+
+// Switch the policy (and RR quantum) of a running simulation, re-indexing the ready queue in place in one pass over it
+int scheduler_switch_policy(SchedulerContext *ctx, const SchedPolicy *policy, sim_time_t quantum) {
+    Queue *ready = &ctx->ready_queue; // Queue the policy orders
+    queue_lock(ready); // Lock the ready queue mutex (pickers and enqueuers see either policy whole)
+    if (policy == &rr_policy && quantum <= 0 && ctx->args.quantum <= 0) { // If RR would have no quantum
+        queue_unlock(ready); // Unlock the ready queue mutex
+        return -1; // Report the failure
+    }
+    if (quantum > 0) { // If the line sets a new quantum
+        __atomic_store_n(&ctx->args.quantum, quantum, __ATOMIC_RELAXED); // Slices dispatched from now on use it
+    }
+    if (ctx->groups) { // If processes share the CPUs by group
+        group_set_inner(ctx, policy); // The groups stay; the policy within them changes
+    } else {
+        rs_clear(&ctx->ready_set); // Drop the old policy's index
+        __atomic_store_n(&ctx->policy, policy, __ATOMIC_RELEASE); // CPU loops see it on their next pick and restart
+        for (PCB *pcb = ready->head; pcb != NULL && policy->on_enqueue; pcb = PCB_NEXT(pcb)) { // Walk the queue in arrival order
+            policy->on_enqueue(ctx, pcb); // Let the new policy index the PCB
         }
-        pthread_mutex_unlock(&ready_queue.mutex); // Unlock the ready queue mutex
+    }
+    __atomic_add_fetch(&ctx->policy_switches, 1, __ATOMIC_RELAXED); // Count the switch
+    queue_unlock(ready); // Unlock the ready queue mutex
+    return 0; // Success
+}
 
-        if (!shortest_pcb) { // If no shortest PCB is found
-            if (file_read_done && ready_queue.head == NULL && io_queue.head == NULL) { // Check for termination condition
+// Shared dispatch loop; forced inline so the built-in instances below call their constant hooks directly
+static inline __attribute__((always_inline)) void policy_loop(Cpu *cpu, const SchedPolicy *policy) {
+    SchedulerContext *ctx = cpu->ctx; // Simulation the CPU belongs to
+    Queue *ready = &ctx->ready_queue; // Queue the policy picks from
+    while (1) { // Infinite loop
+        worker_safe_point(ctx); // Park here while a checkpoint is written
+        PCB *pcb = NULL; // PCB picked by the policy
+        queue_lock(ready); // Lock the ready queue mutex
+        for (int woken = 0; ready->head == NULL && !simulation_done(ctx) && !ctx->pause_requested; woken = 1) { // Wait while the queue is empty and processes are still live
+            if (woken) { // Woken up, but there is still nothing to do
+                LOCK_STATS_SPURIOUS(&ready->lock_stats); // Count the spurious wakeup
+            }
+            queue_wait(ready); // Wait for a condition signal
+        }
+        if (ctx->policy != policy) { // If the policy was switched
+            queue_unlock(ready); // Unlock the ready queue mutex
+            return; // Let the caller start the instance of the new one
+        }
+        if (ready->head != NULL) { // If there is something to pick from
+            pcb = policy->pick_next(ctx); // Let the policy pick and unlink a PCB
+        }
+        queue_unlock(ready); // Unlock the ready queue mutex
+        if (!pcb) { // If no PCB is picked
+            if (simulation_done(ctx)) { // Check for termination condition
                 break; // Exit the loop
             }
             continue; // Continue to the next iteration
         }
 
-        int burst_time = shortest_pcb->bursts[shortest_pcb->current_burst]; // Get the burst time of the shortest PCB
-        usleep(burst_time * 1000); // Sleep for the burst time
-        busy_time += burst_time; // Update the busy time
-        current_time += burst_time; // Update the current time
-        shortest_pcb->current_burst++; // Increment the current burst index
-        if (shortest_pcb->current_burst < shortest_pcb->burst_count) { // If there are more bursts
-            enqueue(&io_queue, shortest_pcb); // Enqueue the PCB to the IO queue
+        __atomic_add_fetch(&ctx->dispatches, 1, __ATOMIC_RELAXED); // Count the dispatch
+        sim_time_t overhead = cpu_take(cpu, pcb, &ctx->args); // Count a migration if it last ran elsewhere, and price the dispatch
+        sim_time_t burst_time = cpu_run_time(cpu, pcb->remaining); // Time this CPU needs for the rest of the current burst
+        sim_time_t slice = policy->on_tick ? policy->on_tick(ctx, pcb) : 0; // Time the PCB may run before preemption
+        if (slice > 0 && burst_time > slice) { // If the burst outlasts its slice
+            SCHED_LOG(ctx, "Running process with priority %d for quantum %.3f ms\n", pcb->priority, SIM_TIME_TO_MS(slice)); // Print debug info
+            sim_time_t end_time = run_burst(cpu, pcb, overhead, slice); // Run the PCB until the absolute end of the slice
+            pcb->remaining -= cpu_work_in(cpu, slice); // Decrement the work left (the trace bursts stay untouched)
+            pcb->flags |= PCB_FLAG_PREEMPTED; // Its next run starts with cold caches
+            pcb->preemptions++; // Count the preemption on the process
+            __atomic_add_fetch(&ctx->preemptions, 1, __ATOMIC_RELAXED); // Count the preemption
+            if (policy->on_ran) { // If the policy tracks runs
+                policy->on_ran(ctx, pcb, end_time - slice, slice); // Tell it how long the PCB ran
+            }
+            if (policy->on_preempt) { // If the policy tracks preemptions
+                policy->on_preempt(ctx, pcb, slice); // Tell it the slice expired
+            }
+            ready_append(ctx, policy, pcb); // Enqueue the PCB back to the ready queue
+            continue; // Pick again
+        }
+        SCHED_LOG(ctx, "Running process with priority %d for %.3f ms\n", pcb->priority, SIM_TIME_TO_MS(burst_time)); // Print debug info
+        sim_time_t end_time = run_burst(cpu, pcb, overhead, burst_time); // Run the PCB until the absolute end of the burst
+        if (policy->on_ran) { // If the policy tracks runs
+            policy->on_ran(ctx, pcb, end_time - burst_time, burst_time); // Tell it how long the PCB ran
+        }
+        if (pcb_advance(pcb)) { // If there are more bursts
+            enqueue(&ctx->io_queue, pcb); // Enqueue the PCB to the IO queue
         } else {
-            // Process finished
-            printf("Process finished with priority %d\n", shortest_pcb->priority); // Print debug info
-            shortest_pcb->turnaround_time = current_time - shortest_pcb->arrival_time; // Calculate turnaround time
-            total_turnaround_time += shortest_pcb->turnaround_time; // Update total turnaround time
-            total_waiting_time += shortest_pcb->waiting_time; // Update total waiting time
-            process_count++; // Increment process count
-            free(shortest_pcb->bursts); // Free the bursts array
-            free(shortest_pcb); // Free the PCB
+            SCHED_LOG(ctx, "Process finished with priority %d\n", pcb->priority); // Print debug info
+            finish_process(ctx, pcb, end_time); // Record metrics and free the PCB
         }
     }
 }
 
+// Run any policy through the shared loop (hooks are called indirectly)
+void run_policy(Cpu *cpu, const SchedPolicy *policy) {
+    policy_loop(cpu, policy); // Generic instance
+}
+
+// FIFO scheduling function
+void run_fifo(Cpu *cpu) {
+    policy_loop(cpu, &fifo_policy); // Instance specialised for FIFO
+}
+
+// SJF scheduling function
+void run_sjf(Cpu *cpu) {
+    policy_loop(cpu, &sjf_policy); // Instance specialised for SJF
+}
+
 // Priority scheduling function
-void run_pr() {
-    while (1) { // Infinite loop
-        PCB *highest_priority_pcb = NULL; // Pointer to the highest priority PCB
-        PCB *current = ready_queue.head; // Pointer to the current PCB in the queue
+void run_pr(Cpu *cpu) {
+    policy_loop(cpu, &pr_policy); // Instance specialised for PR
+}
 
-        pthread_mutex_lock(&ready_queue.mutex); // Lock the ready queue mutex
-        while (current != NULL) { // Iterate through the queue
-            if (highest_priority_pcb == NULL || current->priority > highest_priority_pcb->priority) { // Find the highest priority
-                highest_priority_pcb = current; // Update the highest priority PCB
-            }
-            current = current->next; // Move to the next PCB
+// Round Robin scheduling function
+void run_rr(Cpu *cpu) {
+    policy_loop(cpu, &rr_policy); // Instance specialised for RR
+}
+
+// Initialize an empty simulation with its own queues, clock and metrics
+void scheduler_init(SchedulerContext *ctx, const SchedulerArgs *args) {
+    memset(ctx, 0, sizeof(*ctx)); // Clear the queues, metrics and flags
+    ctx->args = *args; // Copy the configuration
+    ctx->policy = args->policy ? args->policy : policy_find(args->algorithm); // Custom policy, or the built-in named by -alg
+    ctx->io_policy = io_policy_find(args->io_algorithm ? args->io_algorithm : "FIFO"); // I/O policy named by -io-alg
+    Queue *queues[] = {&ctx->ready_queue, &ctx->io_queue}; // Queues owned by the simulation
+    for (int i = 0; i < 2; i++) { // Loop through each queue
+        pthread_mutex_init(&queues[i]->mutex, NULL); // Initialize the queue mutex
+        pthread_cond_init(&queues[i]->cond, NULL); // Initialize the queue condition variable
+    }
+    pthread_mutex_init(&ctx->metrics_mutex, NULL); // Initialize the metrics mutex
+    pthread_mutex_init(&ctx->pause_mutex, NULL); // Initialize the pause mutex
+    pthread_cond_init(&ctx->pause_cond, NULL); // Initialize the pause condition variable
+    tw_init(&ctx->io_wheel, 0); // Start with an empty I/O wheel at tick 0
+    rs_init(&ctx->ready_set); // Start with an empty SoA ready set
+    int cpus = args->cpus > 0 ? args->cpus : 1; // At least one CPU
+    if ((ctx->cpus = calloc(cpus, sizeof(Cpu))) != NULL) { // Allocate the CPUs
+        ctx->cpu_count = cpus; // Record the number of CPUs
+    } else {
+        perror("Failed to allocate memory for CPUs"); // scheduler_run reports the failure
+    }
+    for (int i = 0; i < ctx->cpu_count; i++) { // Loop through each CPU
+        ctx->cpus[i].ctx = ctx; // Link the CPU to its simulation
+        ctx->cpus[i].id = i; // Number the CPU
+        ctx->cpus[i].speed = args->cpu_speeds ? args->cpu_speeds[i] : 1.0; // Scale its bursts
+    }
+    if (args->groups && ctx->policy) { // If processes share the CPUs by group
+        if ((ctx->groups = group_table_create(args->groups, args->group_count, ctx->policy)) != NULL) { // Copy the groups
+            ctx->policy = &group_policy; // Pick a group first, then let the named policy pick within it
+        } else {
+            perror("Failed to allocate memory for groups"); // The run falls back to a flat ready queue
         }
+    }
+    sim_clock_init(&ctx->clock, args->speed, 0); // Give the clock a valid epoch until the run starts
+}
 
-        if (highest_priority_pcb != NULL) { // If a highest priority PCB is found
-            if (highest_priority_pcb->prev != NULL) { // If the highest priority PCB is not the head
-                highest_priority_pcb->prev->next = highest_priority_pcb->next; // Remove it from the queue
-            } else {
-                ready_queue.head = highest_priority_pcb->next; // Update the head pointer
-            }
+// Free every PCB still linked into a list
+static void free_pcb_list(PCB *pcb) {
+    while (pcb) { // Walk the list
+        PCB *next = PCB_NEXT(pcb); // Remember the next PCB
+        pcb_free(pcb); // Free the PCB
+        pcb = next; // Move to the next PCB
+    }
+}
 
-            if (highest_priority_pcb->next != NULL) { // If the highest priority PCB is not the tail
-                highest_priority_pcb->next->prev = highest_priority_pcb->prev; // Remove it from the queue
-            } else {
-                ready_queue.tail = highest_priority_pcb->prev; // Update the tail pointer
-            }
-            highest_priority_pcb->next = highest_priority_pcb->prev = NULL; // Clear the pointers
+// Release a simulation and any PCBs it still holds
+void scheduler_destroy(SchedulerContext *ctx) {
+    free_pcb_list(ctx->ready_queue.head); // Free PCBs left in the ready queue
+    free_pcb_list(ctx->io_queue.head); // Free PCBs left in the IO queue
+    for (int level = 0; level < TW_LEVELS; level++) { // Loop through each wheel level
+        for (int slot = 0; slot < TW_SLOTS; slot++) { // Loop through each slot
+            free_pcb_list(ctx->io_wheel.slots[level][slot].head); // Free in-flight PCBs
         }
-        pthread_mutex_unlock(&ready_queue.mutex); // Unlock the ready queue mutex
+    }
+    Queue *queues[] = {&ctx->ready_queue, &ctx->io_queue}; // Queues owned by the simulation
+    for (int i = 0; i < 2; i++) { // Loop through each queue
+        pthread_mutex_destroy(&queues[i]->mutex); // Destroy the queue mutex
+        pthread_cond_destroy(&queues[i]->cond); // Destroy the queue condition variable
+    }
+    pthread_mutex_destroy(&ctx->metrics_mutex); // Destroy the metrics mutex
+    pthread_mutex_destroy(&ctx->pause_mutex); // Destroy the pause mutex
+    pthread_cond_destroy(&ctx->pause_cond); // Destroy the pause condition variable
+    rs_destroy(&ctx->ready_set); // Release the SoA ready set arrays
+    group_table_destroy(ctx->groups); // Release the groups
+    free(ctx->cpus); // Free the CPUs
+    sim_clock_destroy(&ctx->clock); // Release the clock
+}
 
-        if (!highest_priority_pcb) { // If no highest priority PCB is found
-            if (file_read_done && ready_queue.head == NULL && io_queue.head == NULL) { // Check for termination condition
-                break; // Exit the loop
+// Start every CPU, the I/O device and then the reader as fibers of a pool, or as OS threads when pool is NULL; returns the number started
+static int start_workers(SchedulerContext *ctx, FiberPool *pool, pthread_t *threads) {
+    int started = 0; // Number of workers started
+    for (int i = 0; i <= ctx->cpu_count + 1; i++) { // Each CPU, the I/O device, then the reader (so a failed start admits nothing)
+        void *(*entry)(void *) = i < ctx->cpu_count ? cpu_scheduler_thread : i == ctx->cpu_count ? io_system_thread : file_read_thread; // Worker function
+        void *arg = i < ctx->cpu_count ? (void *)&ctx->cpus[i] : (void *)ctx; // CPUs get their Cpu, the others the context
+        int error = pool ? fiber_spawn(pool, entry, arg) : pthread_create(&threads[started], NULL, entry, arg); // Start the worker
+        if (error != 0) { // If it did not start
+            if (!pool) { // Fiber failures are reported by the pool
+                fprintf(stderr, "Failed to start the simulation threads: %s\n", strerror(error)); // Print an error message
             }
-            continue; // Continue to the next iteration
+            break;
         }
+        started++; // Count the worker
+    }
+    return started; // Return the number started
+}
 
-        int burst_time = highest_priority_pcb->bursts[highest_priority_pcb->current_burst]; // Get the burst time of the highest priority PCB
-        usleep(burst_time * 1000); // Sleep for the burst time
-        busy_time += burst_time; // Update the busy time
-        current_time += burst_time; // Update the current time
-        highest_priority_pcb->current_burst++; // Increment the current burst index
-        if (highest_priority_pcb->current_burst < highest_priority_pcb->burst_count) { // If there are more bursts
-            enqueue(&io_queue, highest_priority_pcb); // Enqueue the PCB to the IO queue
-        } else {
-            // Process finished
-            printf("Process finished with priority %d\n", highest_priority_pcb->priority); // Print debug info
-            highest_priority_pcb->turnaround_time = current_time - highest_priority_pcb->arrival_time; // Calculate turnaround time
-            total_turnaround_time += highest_priority_pcb->turnaround_time; // Update total turnaround time
-            total_waiting_time += highest_priority_pcb->waiting_time; // Update total waiting time
-            process_count++; // Increment process count
-            free(highest_priority_pcb->bursts); // Free the bursts array
-            free(highest_priority_pcb); // Free the PCB
+// Run a simulation to completion on its own reader, CPU, I/O (and sampler) threads
+int scheduler_run(SchedulerContext *ctx) {
+    if (ctx->args.des_threads > 0) { // If the run uses the virtual-time engine
+        return des_run(ctx); // Simulate without the real-time clock
+    }
+    if (ctx->policy == NULL) { // If the algorithm is unknown
+        fprintf(stderr, "Unknown scheduling algorithm %s\n", ctx->args.algorithm ? ctx->args.algorithm : "(none)"); // Print an error message
+        return -1; // Report the failure
+    }
+    if (ctx->io_policy == NULL) { // If the I/O algorithm is unknown
+        fprintf(stderr, "Unknown I/O scheduling algorithm %s\n", ctx->args.io_algorithm); // Print an error message
+        return -1; // Report the failure
+    }
+    int workers = ctx->cpu_count + 2; // Reader, CPUs and I/O device
+    FiberPool *pool = NULL; // Carriers of the fiber backend
+    pthread_t *threads = NULL; // Threads of the thread backend
+    if (ctx->cpu_count == 0 || (ctx->args.fiber_threads > 0 ? !(pool = fiber_pool_create(ctx->args.fiber_threads))
+                                                             : !(threads = malloc(workers * sizeof(pthread_t))))) { // Allocate the backend
+        fprintf(stderr, "Failed to set up %d simulated CPUs\n", ctx->args.cpus); // Print an error message
+        return -1; // Report the failure
+    }
+    if (pool && start_workers(ctx, pool, NULL) != workers) { // Fibers are only queued here, so a failure leaves nothing running
+        fiber_pool_destroy(pool); // Release the fibers spawned so far
+        return -1; // Report the failure
+    }
+    sim_clock_destroy(&ctx->clock); // Drop the placeholder clock
+    sim_clock_init(&ctx->clock, ctx->args.speed, ctx->args.resume_time); // Start the clock at the (resumed) trace time
+
+    pthread_t sample_thread, metrics_file_tid, metrics_http_tid; // Declare thread variables
+    int sampling = 0, exporting = 0, serving = 0; // Set once the sampler, textfile and HTTP exporter threads started
+    int helpers_ok = 1; // Cleared when a sampler or exporter thread did not start (the workers are then not started either)
+    if (ctx->args.sample_every > 0) { // If sampling is enabled
+        int error = pthread_create(&sample_thread, NULL, sampler_thread, (void *)ctx); // Create metrics sampler thread
+        if (error != 0) { // If it did not start
+            fprintf(stderr, "Failed to start the sampler thread: %s\n", strerror(error)); // Print an error message
+        }
+        helpers_ok = sampling = error == 0; // Record whether it runs
+    }
+    if (helpers_ok && ctx->args.metrics_file) { // If exporting to a textfile
+        int error = pthread_create(&metrics_file_tid, NULL, metrics_file_thread, (void *)ctx); // Create textfile exporter thread
+        if (error != 0) { // If it did not start
+            fprintf(stderr, "Failed to start the metrics textfile exporter: %s\n", strerror(error)); // Print an error message
+        }
+        helpers_ok = exporting = error == 0; // Record whether it runs
+    }
+    if (helpers_ok && ctx->args.metrics_port > 0) { // If exporting over HTTP
+        int error = pthread_create(&metrics_http_tid, NULL, metrics_http_thread, (void *)ctx); // Create HTTP exporter thread
+        if (error != 0) { // If it did not start
+            fprintf(stderr, "Failed to start the metrics HTTP exporter: %s\n", strerror(error)); // Print an error message
         }
+        helpers_ok = serving = error == 0; // Record whether it runs
+    }
+    int started = !helpers_ok ? 0 : pool ? workers : start_workers(ctx, NULL, threads); // Create the CPU, I/O and reader threads
+    if (started != workers) { // If a helper or worker did not start
+        __atomic_store_n(&ctx->aborted, 1, __ATOMIC_SEQ_CST); // Abandon the run
+        ctx->file_read_done = 1; // Nothing more will be admitted
+        wake_all_queues(ctx); // Let the started workers see it
     }
+
+    if (pool) { // If running on fibers
+        if (started == workers) { // If every helper started
+            fiber_pool_run(pool); // Run the reader, CPUs and I/O device on the carriers until they finish
+        }
+        fiber_pool_destroy(pool); // Release the carriers and fiber stacks
+    } else {
+        for (int i = 0; i < started; i++) { // Loop through each worker thread
+            pthread_join(threads[i], NULL); // Wait for it to finish
+        }
+        free(threads); // Free the thread handles
+    }
+    if (sampling) { // If the sampler started
+        pthread_cancel(sample_thread); // Stop the sampler instead of waiting out its interval
+        pthread_join(sample_thread, NULL); // Wait for sampler thread to finish
+    }
+    if (exporting) { // If the textfile exporter started
+        pthread_cancel(metrics_file_tid); // Stop the exporter instead of waiting out its interval
+        pthread_join(metrics_file_tid, NULL); // Wait for exporter thread to finish
+    }
+    if (serving) { // If the HTTP exporter started
+        pthread_cancel(metrics_http_tid); // Stop listening for scrapes
+        pthread_join(metrics_http_tid, NULL); // Wait for exporter thread to finish
+    }
+    ctx->total_time = ctx->current_time; // Set total time to current time
+    if (ctx->args.metrics_file) { // If exporting to a textfile
+        metrics_write_file(ctx, ctx->args.metrics_file); // Leave the final values behind
+    }
+    return ctx->read_failed || ctx->aborted ? -1 : 0; // Fail when the trace could not be read or a thread did not start
 }
 
-// Round Robin scheduling function
-void run_rr(int quantum) {
-    while (1) { // Infinite loop
-        PCB *pcb = dequeue(&ready_queue); // Dequeue a PCB from the ready queue
-        if (!pcb) { // If no PCB is dequeued
-            if (file_read_done && ready_queue.head == NULL && io_queue.head == NULL) { // Check for termination condition
-                break; // Exit the loop
-            }
-            continue; // Continue to the next iteration
+// Print the end-of-run metrics of a simulation
+void scheduler_print_metrics(SchedulerContext *ctx, FILE *out) {
+    double cpu_utilization = (double)ctx->busy_time / ctx->total_time / (ctx->cpu_count ? ctx->cpu_count : 1) * 100; // Calculate CPU utilization (averaged over the CPUs)
+    double throughput = ctx->process_count / SIM_TIME_TO_MS(ctx->total_time); // Calculate throughput (processes per ms)
+    double avg_turnaround_time = SIM_TIME_TO_MS(ctx->total_turnaround_time) / ctx->process_count; // Calculate average turnaround time (ms)
+    double avg_waiting_time = SIM_TIME_TO_MS(ctx->total_waiting_time) / ctx->process_count; // Calculate average waiting time (ms)
+    const SchedPolicy *policy = ctx->groups ? ctx->groups->inner : ctx->policy; // Policy named by -alg (within the groups)
+
+    // Print metrics
+    fprintf(out, "Input File Name              : %s\n", ctx->args.service_path ? ctx->args.service_path : ctx->args.input_file);
+    if (ctx->args.workload) {
+        const WorkloadHeader *header = ctx->args.workload->header; // Image the run replayed
+        fprintf(out, "Workload image               : %lld processes, %lld records, %.1f KiB (%s)\n", (long long)header->processes, (long long)header->record_count,
+                ctx->args.workload->size / 1024.0, ctx->args.workload->mapped ? "mapped" : "parsed");
+    }
+    fprintf(out, "CPU Scheduling Alg           : %s\n", policy ? policy->name : ctx->args.algorithm);
+    if (policy == &rr_policy) {
+        fprintf(out, "Quantum                      : %.3f ms\n", SIM_TIME_TO_MS(ctx->args.quantum));
+    }
+    if (policy && policy->on_enqueue == soa_index) {
+        fprintf(out, "Ready set search kernel      : %s\n", rs_kernel_name());
+    }
+    if (ctx->policy_switches > 0) {
+        fprintf(out, "Policy switches              : %llu (started with %s)\n", ctx->policy_switches, ctx->args.policy ? ctx->args.policy->name : ctx->args.algorithm);
+    }
+    if (ctx->cpu_count > 1 || ctx->args.fiber_threads > 0) {
+        fprintf(out, "Simulated CPUs               : %d (%s)\n", ctx->cpu_count, ctx->args.fiber_threads > 0 ? "fibers" : "threads");
+    }
+    if (ctx->args.des_threads > 0) {
+        fprintf(out, "Virtual-time engine          : %d partitions, %d threads, lookahead %.3f ms, %lld windows, %lld messages\n",
+                ctx->args.des_partitions > 0 ? ctx->args.des_partitions : 1, ctx->args.des_threads, SIM_TIME_TO_MS(ctx->des_lookahead), ctx->des_windows, ctx->des_messages);
+        fprintf(out, "Load balancing               : %s", des_balance_name(ctx->args.balance));
+        if (ctx->args.balance == SCHED_BALANCE_LOAD) {
+            fprintf(out, " (every %.3f ms)", SIM_TIME_TO_MS(ctx->args.balance_every));
         }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "I/O Scheduling Alg           : %s\n", ctx->io_policy ? ctx->io_policy->name : ctx->args.io_algorithm);
+    if (ctx->io_policy == &io_deadline_policy) {
+        fprintf(out, "Read / write expiry          : %.3f / %.3f ms\n", SIM_TIME_TO_MS(ctx->args.io_read_expire), SIM_TIME_TO_MS(ctx->args.io_write_expire));
+    }
+    fprintf(out, "CPU utilization              : %.3f%%\n", cpu_utilization);
+    int costed = ctx->args.switch_cost > 0 || ctx->args.warmup_cost > 0 || ctx->args.migrate_cost > 0; // Dispatches cost CPU time
+    if (costed) {
+        fprintf(out, "CPU overhead                 : %.3f%% (switch %.3f ms, warmup %.3f ms, migrate %.3f ms)\n",
+                (double)ctx->overhead_time / ctx->total_time / (ctx->cpu_count ? ctx->cpu_count : 1) * 100,
+                SIM_TIME_TO_MS(ctx->args.switch_cost), SIM_TIME_TO_MS(ctx->args.warmup_cost), SIM_TIME_TO_MS(ctx->args.migrate_cost));
+    }
+    fprintf(out, "Throughput                   : %.3f processes / ms\n", throughput);
+    fprintf(out, "Avg. Turnaround time         : %.3fms\n", avg_turnaround_time);
+    fprintf(out, "Avg. Waiting time in R queue : %.3fms\n", avg_waiting_time);
+    const char *io_wait_labels[] = {"Avg. I/O wait (reads)", "Avg. I/O wait (writes)"}; // One line per request direction
+    for (int write = 0; write < 2; write++) { // Loop through each direction
+        if (ctx->io_requests[write] > 0) { // If the trace issued requests of this direction
+            fprintf(out, "%-29s: %.3fms (max %.3fms, %llu requests)\n", io_wait_labels[write],
+                    SIM_TIME_TO_MS(ctx->io_wait_total[write]) / ctx->io_requests[write], SIM_TIME_TO_MS(ctx->io_wait_max[write]), ctx->io_requests[write]);
+        }
+    }
 
-        int burst_time = pcb->bursts[pcb->current_burst]; // Get the burst time of the current burst
-        if (burst_time > quantum) { // If the burst time is greater than the quantum
-            printf("Running process with priority %d for quantum %d ms\n", pcb->priority, quantum); // Print debug info
-            usleep(quantum * 1000); // Sleep for the quantum time
-            pcb->bursts[pcb->current_burst] -= quantum; // Decrement the burst time
-            busy_time += quantum; // Update the busy time
-            current_time += quantum; // Update the current time
-            enqueue(&ready_queue, pcb); // Enqueue the PCB back to the ready queue
-        } else {
-            printf("Running process with priority %d for %d ms\n", pcb->priority, burst_time); // Print debug info
-            usleep(burst_time * 1000); // Sleep for the burst time
-            busy_time += burst_time; // Update the busy time
-            current_time += burst_time; // Update the current time
-            pcb->current_burst++; // Increment the current burst index
-            if (pcb->current_burst < pcb->burst_count) { // If there are more bursts
-                enqueue(&io_queue, pcb); // Enqueue the PCB to the IO queue
-            } else {
-                printf("Process finished with priority %d\n", pcb->priority); // Print debug info
-                pcb->turnaround_time = current_time - pcb->arrival_time; // Calculate turnaround time
-                total_turnaround_time += pcb->turnaround_time; // Update total turnaround time
-                total_waiting_time += pcb->waiting_time; // Update total waiting time
-                process_count++; // Increment process count
-                free(pcb->bursts); // Free the bursts array
-                free(pcb); // Free the PCB
-            }
+    unsigned long long migrations = 0; // Migrations over every CPU
+    for (int i = 0; ctx->cpu_count > 1 && i < ctx->cpu_count; i++) { // One line per CPU
+        Cpu *cpu = &ctx->cpus[i]; // CPU to report
+        migrations += cpu->migrations; // Add its migrations
+        if (i < CPU_REPORT_MAX) { // Keep the report readable for large fleets
+            char label[32]; // Name and speed of the CPU
+            snprintf(label, sizeof(label), "CPU %d (x%.2f)", i, cpu->speed);
+            fprintf(out, "%-29s: %.3f%% busy, %.3f%% overhead, %llu migrations in\n", label, (double)cpu->busy_time / ctx->total_time * 100,
+                    (double)cpu->overhead_time / ctx->total_time * 100, cpu->migrations);
         }
     }
+    if (ctx->cpu_count > 1) {
+        fprintf(out, "Migrations                   : %llu\n", migrations);
+    }
+    if (ctx->groups) { // If processes shared the CPUs by group
+        group_report(ctx, out); // Print the utilization and throttling of every group
+    }
+    if (ctx->args.results) { // If per-process rows were written
+        fprintf(out, "Per-process results          : %llu rows (%llu waits on a full ring)\n", ctx->args.results->head, ctx->args.results->stalls);
+    }
+
+    // Debug prints to verify calculations
+    fprintf(out, "Time resolution: 1 %s\n", SIM_TIME_UNIT);
+    fprintf(out, "Total time: %.3f ms\n", SIM_TIME_TO_MS(ctx->total_time));
+    fprintf(out, "Busy time: %.3f ms\n", SIM_TIME_TO_MS(ctx->busy_time));
+    if (costed) {
+        fprintf(out, "Overhead time: %.3f ms\n", SIM_TIME_TO_MS(ctx->overhead_time));
+    }
+    fprintf(out, "Total turnaround time: %.3f ms\n", SIM_TIME_TO_MS(ctx->total_turnaround_time));
+    fprintf(out, "Total waiting time: %.3f ms\n", SIM_TIME_TO_MS(ctx->total_waiting_time));
+    fprintf(out, "Process count: %d\n", ctx->process_count);
+    if (ctx->args.des_threads == 0) { // Virtual time has no real clock to drift from
+        sim_clock_report(&ctx->clock, out, ctx->total_time); // Print the measured clock drift
+    }
+    pcb_report(out); // Print the PCB layout and memory per process
+#ifdef SCHED_LOCK_STATS
+    lock_stats_report(out, "ready", &ctx->ready_queue.lock_stats); // Print the ready queue lock summary
+    lock_stats_report(out, "io", &ctx->io_queue.lock_stats); // Print the IO queue lock summary
+#endif
 }
@@ -9,19 +9,18 @@
 #include <string.h> // Include string handling library
 #include <pthread.h> // Include pthread library for threading
 #include <unistd.h> // Include POSIX standard library
-
-// Define the PCB (Process Control Block) structure
-typedef struct PCB {
-    int priority; // Process priority
-    int burst_count; // Number of bursts
-    int *bursts; // Array of bursts
-    int current_burst; // Index of the current burst
-    int arrival_time; // Arrival time of the process
-    int waiting_time; // Waiting time of the process
-    int turnaround_time; // Turnaround time of the process
-    struct PCB *next; // Pointer to the next PCB in the queue
-    struct PCB *prev; // Pointer to the previous PCB in the queue
-} PCB;
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+#include "pcb.h" // Include the process control block header file
+#include "timing_wheel.h" // Include the timing wheel header file
+#include "policy.h" // Include the scheduling policy header file
+#include "io_policy.h" // Include the I/O scheduling policy header file
+#include "ready_set.h" // Include the structure-of-arrays ready set header file
+#include "metrics.h" // Include the metrics exporter header file
+#include "lock_stats.h" // Include the lock statistics header file
+#include "fiber.h" // Include the fiber header file
+#include "group.h" // Include the fair-share group header file
+#include "workload.h" // Include the workload image header file
+#include "results.h" // Include the per-process results header file
 
 // Define the Queue structure
 typedef struct Queue {
@@ -29,35 +28,185 @@ typedef struct Queue {
     PCB *tail; // Pointer to the tail of the queue
     pthread_mutex_t mutex; // Mutex for thread synchronization
     pthread_cond_t cond; // Condition variable for thread synchronization
+    FiberWaitList fiber_waiters; // Fibers blocked on the queue (fiber backend, guarded by mutex)
+    int length; // Number of PCBs in the queue (written under mutex, readable without it)
+    unsigned long long lock_wait_ns; // Real time spent blocked acquiring mutex (written under mutex, readable without it)
+    LOCK_STATS_FIELD // Detailed lock statistics (SCHED_LOCK_STATS builds only)
 } Queue;
 
+// Load-balancing policies of the virtual-time engine
+enum {
+    SCHED_BALANCE_NONE, // Processes are dealt round-robin to the partitions and stay there
+    SCHED_BALANCE_SPEED, // Processes are dealt in proportion to the partitions' total CPU speed
+    SCHED_BALANCE_LOAD // As SPEED, plus I/O completions and periodic migrations go to the least loaded partition per unit of speed
+};
+
 // Define the SchedulerArgs structure
 typedef struct SchedulerArgs {
+    char *input_file; // Trace file to replay
+    const Workload *workload; // Parsed image of the trace, shared read-only by every run (NULL = parse input_file)
+    int parse_threads; // Threads pre-parsing the trace in parallel (0 = read line by line)
+    char *service_path; // FIFO or socket to serve commands from instead of a trace file (NULL = trace file)
+    int service_fifo; // The service path is a named pipe rather than a UNIX domain socket
     char *algorithm; // Scheduling algorithm
-    int quantum; // Time quantum for round-robin scheduling
+    sim_time_t quantum; // Time quantum for round-robin scheduling
+    sim_time_t switch_cost; // CPU time every dispatch spends switching context
+    sim_time_t warmup_cost; // Extra CPU time the first run after a preemption spends refilling caches
+    sim_time_t migrate_cost; // Extra CPU time a run on another CPU than the last one spends moving state
+    int cpus; // Simulated CPUs dispatching from the shared ready queue (0 = 1)
+    int fiber_threads; // Carrier threads running the reader, CPUs and I/O device as fibers (0 = an OS thread each)
+    int des_threads; // Worker threads of the virtual-time engine (0 = real-time engine)
+    int des_partitions; // CPU partitions of the virtual-time engine, each with its own ready queue (0 = 1)
+    double *cpu_speeds; // Work each CPU does per unit of time, indexed by CPU (NULL = 1.0 for every CPU)
+    int balance; // How the virtual-time engine places and migrates processes across partitions (SCHED_BALANCE_*)
+    sim_time_t balance_every; // Simulated time between migration passes (SCHED_BALANCE_LOAD)
+    const SchedGroup *groups; // Fair-share group definitions, "default" first (NULL = every process competes on its own)
+    int group_count; // Number of group definitions
+    int io_depth; // Number of I/O bursts the device serves concurrently (0 = unlimited)
+    char *io_algorithm; // I/O scheduling algorithm (NULL = FIFO)
+    sim_time_t io_read_expire; // How long a read may wait before DEADLINE serves it first
+    sim_time_t io_write_expire; // How long a write may wait before DEADLINE serves it first
+    sim_time_t io_tick; // Length of one I/O timing wheel tick
+    double speed; // Time-dilation factor (simulated ms per real ms)
+    char *checkpoint_file; // Snapshot file written periodically (NULL = no checkpoints)
+    sim_time_t checkpoint_every; // Simulated time between snapshots
+    long resume_offset; // Trace offset (or workload record) to resume reading from
+    sim_time_t resume_time; // Trace time to resume from
+    sim_time_t sample_every; // Simulated time between metric samples (0 = no sampling)
+    int sample_json; // Emit samples as JSON records instead of text lines
+    FILE *sample_out; // Stream the samples are written to
+    int metrics_port; // Localhost port serving Prometheus metrics (0 = off)
+    char *metrics_file; // Prometheus textfile rewritten periodically (NULL = off)
+    sim_time_t metrics_every; // Simulated time between textfile rewrites
+    ResultsWriter *results; // Writer receiving a row per finished process (NULL = off)
+    sim_time_t measure_from; // Start of the interval completions are also counted in (measured_completions)
+    sim_time_t measure_until; // End of that interval (0 = not counted)
+    int verbose; // Print a line for every scheduling event
+    const SchedPolicy *policy; // Custom scheduling policy (NULL = the built-in named by algorithm)
 } SchedulerArgs;
 
-extern Queue ready_queue; // Declare the ready queue as an external variable
-extern Queue io_queue; // Declare the IO queue as an external variable
-extern int file_read_done; // Declare the file read done flag as an external variable
+// Define the Cpu structure (one simulated CPU; written only by the thread or fiber running it)
+typedef struct Cpu {
+    struct SchedulerContext *ctx; // Simulation the CPU belongs to
+    int id; // Index of the CPU
+    sim_time_t cpu_time; // Simulated time at which the CPU finished its last burst
+    sim_time_t busy_time; // Time this CPU was busy
+    double speed; // Work done per unit of time (1.0 = nominal, bursts are given in nominal time)
+    sim_time_t overhead_time; // Time this CPU spent switching, warming caches and migrating (not in busy_time)
+    unsigned long long migrations; // Dispatches of a PCB that last ran on another CPU
+
+    // Burst in progress, published for lock-free readers through a sequence counter
+    unsigned seq; // Odd while the CPU is updating the fields below
+    sim_time_t burst_start; // Start of the burst on the CPU
+    sim_time_t burst_end; // End of the burst on the CPU (equal to start when idle)
+} Cpu;
+
+// Time a CPU needs for an amount of work (rounded up)
+static inline sim_time_t cpu_run_time(const Cpu *cpu, sim_time_t work) {
+    if (cpu->speed == 1.0) { // Nominal CPUs need no rounding
+        return work;
+    }
+    sim_time_t time = (sim_time_t)(work / cpu->speed); // Truncated time
+    return time * cpu->speed < work ? time + 1 : time; // Round up so the work always completes
+}
+
+// Record that a CPU dispatches a PCB, counting a migration when it last ran elsewhere; returns the CPU time the dispatch costs
+static inline sim_time_t cpu_take(Cpu *cpu, PCB *pcb, const SchedulerArgs *args) {
+    sim_time_t overhead = args->switch_cost; // Every dispatch switches context
+    if (pcb->last_cpu != 0 && pcb->last_cpu != cpu->id + 1) { // If the PCB ran on another CPU before
+        cpu->migrations++; // Count the migration on the receiving CPU
+        overhead += args->migrate_cost; // Its state has to move
+    }
+    if (pcb->flags & PCB_FLAG_PREEMPTED) { // If it was cut off last time
+        overhead += args->warmup_cost; // Its caches are cold
+        pcb->flags &= ~PCB_FLAG_PREEMPTED;
+    }
+    pcb->last_cpu = cpu->id + 1; // Remember where it ran
+    return overhead; // Return the cost of the dispatch
+}
+
+// Work a CPU does in an amount of time (rounded down, at least one unit so slices always progress)
+static inline sim_time_t cpu_work_in(const Cpu *cpu, sim_time_t time) {
+    sim_time_t work = cpu->speed == 1.0 ? time : (sim_time_t)(time * cpu->speed); // Truncated work
+    return work > 0 ? work : 1;
+}
+
+// Define the SchedulerContext structure (everything one simulation owns)
+typedef struct SchedulerContext {
+    SchedulerArgs args; // Configuration of the simulation
+    const SchedPolicy *policy; // Policy driving the CPU thread (NULL = unknown algorithm)
+    const IoPolicy *io_policy; // Policy ordering the I/O queue (NULL = unknown algorithm)
+    Queue ready_queue; // Ready queue
+    Queue io_queue; // IO queue
+    ReadySet ready_set; // SoA index of the ready queue (SJF-SOA and PR-SOA only, guarded by the ready queue mutex)
+    int file_read_done; // Flag to indicate file read completion
+    int read_failed; // Flag set when the trace or service endpoint could not be opened
+    int aborted; // Flag set when a worker could not start, so the started ones stop at their next check
+    int active_processes; // Number of processes admitted but not yet finished
+    SimClock clock; // Monotonic clock the simulation is paced by
+    TimingWheel io_wheel; // Wheel holding the in-flight I/O bursts
+    Cpu *cpus; // Simulated CPUs
+    int cpu_count; // Number of simulated CPUs
+    GroupTable *groups; // Fair-share groups the policy picks through (NULL = flat ready queue)
+
+    // Metrics
+    sim_time_t total_time; // Total time taken
+    sim_time_t busy_time; // Time when CPU is busy (summed over every CPU)
+    sim_time_t overhead_time; // Time CPUs spent on dispatch overhead (summed over every CPU, not in busy_time)
+    int process_count; // Number of processes
+    int measured_completions; // Processes that finished between args.measure_from and args.measure_until
+    sim_time_t total_turnaround_time; // Sum of turnaround times of all processes
+    sim_time_t total_waiting_time; // Sum of waiting times of all processes
+    sim_time_t current_time; // Latest simulated time reached
+    pthread_mutex_t metrics_mutex; // Mutex protecting the completion metrics
+    unsigned long long dispatches; // PCBs dispatched to the CPU
+    unsigned long long preemptions; // Time slices that expired before the burst ended
+    unsigned long long policy_switches; // Policy lines applied while the simulation ran
+    Histogram turnaround_hist; // Distribution of turnaround times
+    Histogram waiting_hist; // Distribution of ready-queue waiting times
+
+    // I/O queue waits, indexed by direction (0 = read, 1 = write); written by the I/O thread, readable without locks
+    unsigned long long io_requests[2]; // I/O bursts admitted to the device
+    sim_time_t io_wait_total[2]; // Sum of the time requests waited in the I/O queue
+    sim_time_t io_wait_max[2]; // Longest time a request waited in the I/O queue
+    Histogram io_wait_hist; // Distribution of I/O queue waiting times
+
+    // Virtual-time engine
+    sim_time_t des_lookahead; // Window length: the shortest time between a send and its delivery
+    long long des_windows; // Windows simulated
+    long long des_messages; // Messages exchanged between partitions and the I/O device
+
+    // Checkpoint pause protocol
+    pthread_mutex_t pause_mutex; // Mutex protecting the pause state
+    pthread_cond_t pause_cond; // Condition variable for parking and resuming
+    int pause_requested; // Flag asking the worker threads to park
+    int parked_workers; // Number of worker threads currently parked
+} SchedulerContext;
+
+// Print a scheduling event when the simulation is verbose
+#define SCHED_LOG(ctx, ...) do { if ((ctx)->args.verbose) printf(__VA_ARGS__); } while (0)
 
-// Declare global metrics variables as external variables
-extern int total_time;
-extern int busy_time;
-extern int process_count;
-extern int total_turnaround_time;
-extern int total_waiting_time;
-extern int current_time;
+void scheduler_init(SchedulerContext *ctx, const SchedulerArgs *args); // Function prototype for initializing an empty simulation
+void scheduler_destroy(SchedulerContext *ctx); // Function prototype for releasing a simulation and any PCBs it still holds
+int scheduler_run(SchedulerContext *ctx); // Function prototype for running a simulation to completion
+void scheduler_print_metrics(SchedulerContext *ctx, FILE *out); // Function prototype for printing the end-of-run metrics
+int scheduler_switch_policy(SchedulerContext *ctx, const SchedPolicy *policy, sim_time_t quantum); // Function prototype for switching the policy (and RR quantum, 0 = keep) while the simulation runs
 
 void enqueue(Queue *queue, PCB *pcb); // Function prototype for enqueueing a PCB to a queue
-PCB *dequeue(Queue *queue); // Function prototype for dequeueing a PCB from a queue
+void enqueue_ready(SchedulerContext *ctx, PCB *pcb); // Function prototype for enqueueing a PCB to the ready queue through the active policy
+PCB *dequeue(SchedulerContext *ctx, Queue *queue); // Function prototype for dequeueing a PCB from a queue
+void enqueue_batch(Queue *queue, PCB *chain); // Function prototype for enqueueing a chain of PCBs under one lock acquisition
+void enqueue_ready_batch(SchedulerContext *ctx, PCB *chain); // Function prototype for enqueueing a chain of PCBs to the ready queue under one lock acquisition
+PCB *dequeue_batch(SchedulerContext *ctx, Queue *queue, int max); // Function prototype for dequeueing up to max PCBs (0 = all) as a chain
+int simulation_done(SchedulerContext *ctx); // Function prototype for checking whether every process has finished
+sim_time_t cpu_busy_at(SchedulerContext *ctx, sim_time_t time); // Function prototype for reading the busy time of every CPU up to a simulated time without locks
 void *file_read_thread(void *arg); // Function prototype for the file read thread
-void *cpu_scheduler_thread(void *arg); // Function prototype for the CPU scheduler thread
+void *cpu_scheduler_thread(void *arg); // Function prototype for the CPU scheduler thread (the argument is its Cpu)
 void *io_system_thread(void *arg); // Function prototype for the IO system thread
 
-void run_fifo(); // Function prototype for FIFO scheduling algorithm
-void run_sjf(); // Function prototype for SJF scheduling algorithm
-void run_pr(); // Function prototype for priority scheduling algorithm
-void run_rr(int quantum); // Function prototype for round-robin scheduling algorithm
+void run_fifo(Cpu *cpu); // Function prototype for FIFO scheduling algorithm
+void run_sjf(Cpu *cpu); // Function prototype for SJF scheduling algorithm
+void run_pr(Cpu *cpu); // Function prototype for priority scheduling algorithm
+void run_rr(Cpu *cpu); // Function prototype for round-robin scheduling algorithm
 
 #endif // SCHEDULER_H // End of include guard
@@ -0,0 +1,105 @@
+//
+// Long-running service mode: trace commands arrive on a FIFO or a UNIX domain socket
+//
+#include "service.h" // Include the service header file
+#include <errno.h> // Include errno
+#include <signal.h> // Include signal for SIGPIPE
+#include <string.h> // Include string handling library
+#include <unistd.h> // Include POSIX standard library
+#include <sys/socket.h> // Include socket
+#include <sys/stat.h> // Include mkfifo
+#include <sys/un.h> // Include sockaddr_un
+
+#define SERVICE_BACKLOG 4 // Clients that may wait to connect
+
+// Create the FIFO or the listening socket
+int service_open(Service *service, const char *path, int fifo) {
+    service->path = path; // Remember the endpoint
+    service->fifo = fifo;
+    service->listen_fd = -1; // No socket yet
+    service->in = service->reply = NULL; // No client yet
+    signal(SIGPIPE, SIG_IGN); // A client hanging up mid-reply must not kill the simulation
+    if (fifo) { // If reading from a named pipe
+        if (mkfifo(path, 0600) != 0 && errno != EEXIST) { // Create it unless it already exists
+            perror("Failed to create FIFO"); // Print an error message
+            return -1;
+        }
+        return 0; // The FIFO is opened per writer
+    }
+
+    struct sockaddr_un addr; // Socket address
+    memset(&addr, 0, sizeof(addr)); // Clear the address
+    addr.sun_family = AF_UNIX; // UNIX domain socket
+    if (strlen(path) >= sizeof(addr.sun_path)) { // If the path does not fit
+        fprintf(stderr, "Socket path too long: %s\n", path); // Print an error message
+        return -1;
+    }
+    strcpy(addr.sun_path, path); // Copy the path
+    service->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0); // Create the socket
+    if (service->listen_fd < 0) { // If the socket cannot be created
+        perror("Failed to create socket"); // Print an error message
+        return -1;
+    }
+    unlink(path); // Remove a stale socket left by an earlier run
+    if (bind(service->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(service->listen_fd, SERVICE_BACKLOG) != 0) { // Bind and listen
+        perror("Failed to listen on socket"); // Print an error message
+        close(service->listen_fd); // Close the socket
+        service->listen_fd = -1;
+        return -1;
+    }
+    return 0; // Success
+}
+
+// Wait for the next client (a connection, or a writer opening the FIFO)
+int service_accept(Service *service) {
+    if (service->fifo) { // If reading from a named pipe
+        service->in = fopen(service->path, "r"); // Blocks until a writer opens the FIFO
+        if (service->in == NULL) { // If the FIFO cannot be opened
+            perror("Failed to open FIFO"); // Print an error message
+            return -1;
+        }
+        return 0; // Replies go to stdout
+    }
+    int fd; // Connected socket
+    while ((fd = accept(service->listen_fd, NULL, NULL)) < 0) { // Wait for a connection
+        if (errno != EINTR) { // Retry only after a signal
+            perror("Failed to accept connection"); // Print an error message
+            return -1;
+        }
+    }
+    int reply_fd = dup(fd); // Separate descriptor so both streams can be closed
+    if ((service->in = fdopen(fd, "r")) == NULL) { // Commands from the client
+        close(fd); // Close the unwrapped descriptor
+    }
+    if (reply_fd >= 0 && (service->reply = fdopen(reply_fd, "w")) == NULL) { // Replies to the client
+        close(reply_fd); // Close the unwrapped descriptor
+    }
+    if (service->in == NULL || service->reply == NULL) { // If the streams cannot be created
+        perror("Failed to open connection streams"); // Print an error message
+        service_hangup(service); // Drop the client
+        return -1;
+    }
+    return 0; // Success
+}
+
+// Close the current client
+void service_hangup(Service *service) {
+    if (service->in) { // If commands were being read
+        fclose(service->in); // Close the command stream
+    }
+    if (service->reply) { // If replies were being written
+        fclose(service->reply); // Close the reply stream
+    }
+    service->in = service->reply = NULL; // No client
+}
+
+// Close and remove the endpoint
+void service_close(Service *service) {
+    service_hangup(service); // Drop the current client
+    if (service->listen_fd >= 0) { // If a socket was listening
+        close(service->listen_fd); // Close the socket
+        service->listen_fd = -1;
+    }
+    unlink(service->path); // Remove the FIFO or socket file
+}
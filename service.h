@@ -0,0 +1,23 @@
+//
+// Long-running service mode: trace commands arrive on a FIFO or a UNIX domain socket
+//
+#ifndef SERVICE_H // If not defined, define SERVICE_H to prevent multiple inclusions
+#define SERVICE_H // Define SERVICE_H
+
+#include <stdio.h> // Include standard I/O library
+
+// Define the Service structure (one endpoint, one client at a time)
+typedef struct Service {
+    const char *path; // FIFO or socket path
+    int fifo; // Read from a named pipe instead of a socket
+    int listen_fd; // Listening socket (-1 for a FIFO)
+    FILE *in; // Commands from the current client
+    FILE *reply; // Replies to the current client (NULL for a FIFO: replies go to stdout)
+} Service;
+
+int service_open(Service *service, const char *path, int fifo); // Function prototype for creating the FIFO or listening socket
+int service_accept(Service *service); // Function prototype for waiting for the next client
+void service_hangup(Service *service); // Function prototype for closing the current client
+void service_close(Service *service); // Function prototype for closing and removing the endpoint
+
+#endif // SERVICE_H // End of include guard
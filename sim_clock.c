@@ -0,0 +1,108 @@
+//
+// Monotonic simulation clock with absolute-deadline sleeping and time dilation
+//
+#include "sim_clock.h" // Include the simulation clock header file
+#include "fiber.h" // Include the fiber header file
+#include <errno.h> // Include EINTR
+#include <stdlib.h> // Include standard library for strtod
+#include <string.h> // Include string handling library
+
+#define NSEC_PER_SEC 1000000000LL // Nanoseconds per second
+#define NSEC_PER_MSEC 1000000LL // Nanoseconds per millisecond
+
+// Convert a timespec to nanoseconds
+static long long timespec_to_ns(const struct timespec *ts) {
+    return (long long)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec; // Combine seconds and nanoseconds
+}
+
+// Real nanoseconds elapsed since the epoch
+static long long real_elapsed_ns(SimClock *clock) {
+    struct timespec now; // Current monotonic time
+    clock_gettime(CLOCK_MONOTONIC, &now); // Read the monotonic clock
+    return timespec_to_ns(&now) - timespec_to_ns(&clock->epoch); // Subtract the epoch
+}
+
+// Parse a duration such as "10", "1.5ms", "250us", "800ns" or "2s"; a bare number is in ms. Returns 0 on success
+int sim_time_parse(const char *text, sim_time_t *out) {
+    char *unit; // First character after the number
+    double value = strtod(text, &unit); // Parse the numeric part
+    if (unit == text || value < 0) { // If there is no number or it is negative
+        return -1; // Report a parse error
+    }
+    double scale; // Ticks per unit of the suffix
+    size_t len = strcspn(unit, " \t\r\n"); // Length of the suffix up to whitespace
+    if (len == 0 || (len == 2 && strncmp(unit, "ms", 2) == 0)) { // Milliseconds (default)
+        scale = SIM_TIME_PER_MS;
+    } else if (len == 2 && strncmp(unit, "us", 2) == 0) { // Microseconds
+        scale = SIM_TIME_PER_US;
+    } else if (len == 2 && strncmp(unit, "ns", 2) == 0) { // Nanoseconds
+        scale = SIM_TIME_PER_US / 1000.0;
+    } else if (len == 1 && unit[0] == 's') { // Seconds
+        scale = SIM_TIME_PER_SEC;
+    } else { // Unknown suffix
+        return -1; // Report a parse error
+    }
+    *out = (sim_time_t)(value * scale + 0.5); // Round to the nearest tick
+    return 0; // Success
+}
+
+// Start the clock at simulated time start; speed is the time-dilation factor (10 replays ten times faster than real time)
+void sim_clock_init(SimClock *clock, double speed, sim_time_t start) {
+    clock->speed = speed > 0 ? speed : 1.0; // Fall back to real time for invalid factors
+    pthread_mutex_init(&clock->drift_mutex, NULL); // Initialize the drift mutex
+    clock->wakeups = clock->total_lateness = clock->max_lateness = 0; // Clear the drift statistics
+    clock->sleep_error = 0; // No sleep has failed yet
+    clock_gettime(CLOCK_MONOTONIC, &clock->epoch); // Simulated time start is now
+    long long offset = (long long)(start * 1000.0 / SIM_TIME_PER_US / clock->speed); // Real ns that start corresponds to
+    long long shifted = timespec_to_ns(&clock->epoch) - offset; // Move the epoch back so that now reads as start
+    clock->epoch.tv_sec = shifted / NSEC_PER_SEC; // Seconds part of the epoch
+    clock->epoch.tv_nsec = shifted % NSEC_PER_SEC; // Nanoseconds part of the epoch
+}
+
+// Release the clock
+void sim_clock_destroy(SimClock *clock) {
+    pthread_mutex_destroy(&clock->drift_mutex); // Destroy the drift mutex
+}
+
+// Elapsed simulated time in ticks
+sim_time_t sim_clock_now(SimClock *clock) {
+    return (sim_time_t)(real_elapsed_ns(clock) * clock->speed * SIM_TIME_PER_US / 1000.0); // Scale real time by the dilation factor
+}
+
+// Sleep until an absolute simulated time; deadlines never accumulate oversleep
+void sim_clock_sleep_until(SimClock *clock, sim_time_t deadline) {
+    long long target = (long long)(deadline * 1000.0 / SIM_TIME_PER_US / clock->speed); // Real deadline (ns) relative to the epoch
+    long long absolute = timespec_to_ns(&clock->epoch) + target; // Real deadline on the monotonic clock
+    struct timespec ts = {absolute / NSEC_PER_SEC, absolute % NSEC_PER_SEC}; // Deadline as a timespec
+    if (fiber_current()) { // If running as a fiber
+        fiber_sleep_until(&ts); // Park the fiber and let its carrier run the others
+    } else {
+        int error; // Result of the sleep
+        while ((error = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR) { // Sleep, restarting only after signals
+        }
+        if (error != 0 && __atomic_exchange_n(&clock->sleep_error, error, __ATOMIC_RELAXED) == 0) { // If the deadline cannot be slept to (report the first failure)
+            fprintf(stderr, "Failed to sleep until %.3f ms: %s\n", SIM_TIME_TO_MS(deadline), strerror(error)); // Print an error message
+        }
+    }
+    long long lateness = real_elapsed_ns(clock) - target; // How far past the deadline we woke up
+    if (lateness < 0) { // If the deadline had not yet come (cannot happen with TIMER_ABSTIME)
+        lateness = 0; // Do not count early wake-ups
+    }
+    pthread_mutex_lock(&clock->drift_mutex); // Lock the drift statistics
+    clock->wakeups++; // Count the wake-up
+    clock->total_lateness += lateness; // Accumulate the lateness
+    if (lateness > clock->max_lateness) { // If this is the worst wake-up so far
+        clock->max_lateness = lateness; // Remember it
+    }
+    pthread_mutex_unlock(&clock->drift_mutex); // Unlock the drift statistics
+}
+
+// Print the measured drift between the nominal timeline and the wall clock
+void sim_clock_report(SimClock *clock, FILE *out, sim_time_t nominal_end) {
+    double elapsed = real_elapsed_ns(clock) * clock->speed / NSEC_PER_MSEC; // Simulated ms measured on the wall clock
+    fprintf(out, "Time dilation                : %.2fx\n", clock->speed);
+    fprintf(out, "Avg. wake-up lateness        : %.3f ms (real)\n",
+            clock->wakeups ? (double)clock->total_lateness / clock->wakeups / NSEC_PER_MSEC : 0.0);
+    fprintf(out, "Max. wake-up lateness        : %.3f ms (real)\n", (double)clock->max_lateness / NSEC_PER_MSEC);
+    fprintf(out, "Drift (measured - nominal)   : %.3f ms (simulated)\n", elapsed - SIM_TIME_TO_MS(nominal_end));
+}
@@ -0,0 +1,44 @@
+//
+// Monotonic simulation clock with absolute-deadline sleeping and time dilation
+//
+#ifndef SIM_CLOCK_H // If not defined, define SIM_CLOCK_H to prevent multiple inclusions
+#define SIM_CLOCK_H // Define SIM_CLOCK_H
+
+#include <stdio.h> // Include standard I/O library
+#include <stdint.h> // Include fixed-width integer types
+#include <pthread.h> // Include pthread library for threading
+#include <time.h> // Include time library for clock_gettime and clock_nanosleep
+
+// Simulated time is a 64-bit count of ticks; build with -DSIM_TIME_NS for nanosecond ticks (microseconds otherwise)
+typedef int64_t sim_time_t;
+
+#ifdef SIM_TIME_NS
+#define SIM_TIME_PER_US 1000LL // Ticks per microsecond
+#define SIM_TIME_UNIT "ns" // Name of the tick unit
+#else
+#define SIM_TIME_PER_US 1LL // Ticks per microsecond
+#define SIM_TIME_UNIT "us" // Name of the tick unit
+#endif
+#define SIM_TIME_PER_MS (SIM_TIME_PER_US * 1000LL) // Ticks per millisecond
+#define SIM_TIME_PER_SEC (SIM_TIME_PER_MS * 1000LL) // Ticks per second
+#define SIM_TIME_TO_MS(t) ((double)(t) / SIM_TIME_PER_MS) // Convert ticks to (fractional) milliseconds
+
+// Define the SimClock structure (one per simulation)
+typedef struct SimClock {
+    struct timespec epoch; // Monotonic time at which simulated time 0 started
+    double speed; // Simulated ms elapsing per real ms
+    pthread_mutex_t drift_mutex; // Mutex protecting the drift statistics
+    long long wakeups; // Number of deadline sleeps
+    long long total_lateness; // Sum of real wake-up lateness (ns)
+    long long max_lateness; // Worst real wake-up lateness (ns)
+    int sleep_error; // First error a deadline sleep returned (0 = none; reported once)
+} SimClock;
+
+int sim_time_parse(const char *text, sim_time_t *out); // Function prototype for parsing a duration with an optional unit suffix
+void sim_clock_init(SimClock *clock, double speed, sim_time_t start); // Function prototype for starting the clock at a simulated time with a time-dilation factor
+void sim_clock_destroy(SimClock *clock); // Function prototype for releasing the clock
+sim_time_t sim_clock_now(SimClock *clock); // Function prototype for reading the elapsed simulated time
+void sim_clock_sleep_until(SimClock *clock, sim_time_t deadline); // Function prototype for sleeping until an absolute simulated time
+void sim_clock_report(SimClock *clock, FILE *out, sim_time_t nominal_end); // Function prototype for printing the measured drift
+
+#endif // SIM_CLOCK_H // End of include guard
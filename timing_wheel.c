@@ -0,0 +1,80 @@
+//
+// Hierarchical timing wheel holding in-flight I/O PCBs keyed by completion tick
+//
+#include "scheduler.h" // Include the scheduler header file (which includes the timing wheel header)
+
+// Append a PCB to the tail of a slot
+static void slot_append(TimingWheelSlot *slot, PCB *pcb) {
+    PCB_SET_NEXT(pcb, NULL); // The PCB becomes the new tail
+    PCB_SET_PREV(pcb, slot->tail); // Link back to the previous tail
+    if (slot->tail) { // If the slot is not empty
+        PCB_SET_NEXT(slot->tail, pcb); // Link the old tail to the PCB
+    } else {
+        slot->head = pcb; // The PCB is the only entry
+    }
+    slot->tail = pcb; // Update the tail pointer
+}
+
+// Place a PCB in the level and slot matching its distance from the current tick
+static void tw_place(TimingWheel *wheel, PCB *pcb) {
+    long expire = pcb->io_done_time; // Tick at which the PCB is due
+    if (expire <= wheel->now) { // If the PCB is already due
+        expire = wheel->now + 1; // Release it on the next tick
+        pcb->io_done_time = expire; // Keep the stored due tick consistent
+    }
+    long delta = expire - wheel->now; // Distance to the due tick
+    if (delta >= TW_RANGE) { // If the PCB lies beyond the whole wheel
+        expire = wheel->now + TW_RANGE - 1; // Park it in the farthest slot; it is re-placed on cascade
+        delta = TW_RANGE - 1; // Clamp the distance accordingly
+    }
+    int level = 0; // Level the PCB belongs to
+    while (delta >= (1L << ((level + 1) * TW_SLOT_BITS))) { // Find the lowest level whose span covers delta
+        level++; // Move one level up
+    }
+    int index = (int)((expire >> (level * TW_SLOT_BITS)) & TW_SLOT_MASK); // Slot index within the level
+    slot_append(&wheel->slots[level][index], pcb); // Append to the slot
+}
+
+// Move every PCB of a higher level slot down to the level matching its remaining distance
+static void tw_cascade(TimingWheel *wheel, int level) {
+    int index = (int)((wheel->now >> (level * TW_SLOT_BITS)) & TW_SLOT_MASK); // Slot that just came into range
+    PCB *pcb = wheel->slots[level][index].head; // First PCB of the slot
+    wheel->slots[level][index].head = wheel->slots[level][index].tail = NULL; // Empty the slot
+    while (pcb) { // Walk the detached list
+        PCB *next = PCB_NEXT(pcb); // Remember the next PCB before relinking
+        tw_place(wheel, pcb); // Re-place the PCB relative to the current tick
+        pcb = next; // Move to the next PCB
+    }
+}
+
+// Initialize an empty wheel starting at the given tick
+void tw_init(TimingWheel *wheel, long start_tick) {
+    memset(wheel->slots, 0, sizeof(wheel->slots)); // Clear all slots
+    wheel->now = start_tick; // Set the current tick
+    wheel->count = 0; // The wheel starts empty
+}
+
+// Insert a PCB that completes at expire_tick (O(1))
+void tw_insert(TimingWheel *wheel, PCB *pcb, long expire_tick) {
+    pcb->io_done_time = expire_tick; // Remember the due tick for cascading
+    tw_place(wheel, pcb); // Place the PCB in its slot
+    wheel->count++; // Count the new entry
+}
+
+// Advance the wheel by one tick and return the chain of PCBs due at the new tick
+PCB *tw_advance(TimingWheel *wheel) {
+    wheel->now++; // Move to the next tick
+    for (int level = TW_LEVELS - 1; level > 0; level--) { // Cascade from the highest level down
+        long span = 1L << (level * TW_SLOT_BITS); // Ticks per slot at this level
+        if ((wheel->now & (span - 1)) == 0) { // If a slot boundary of this level was reached
+            tw_cascade(wheel, level); // Bring the slot's PCBs closer
+        }
+    }
+    TimingWheelSlot *slot = &wheel->slots[0][wheel->now & TW_SLOT_MASK]; // Level 0 slot due now
+    PCB *expired = slot->head; // The whole slot expires as one batch
+    slot->head = slot->tail = NULL; // Empty the slot
+    for (PCB *pcb = expired; pcb != NULL; pcb = PCB_NEXT(pcb)) { // Count the released PCBs
+        wheel->count--; // Update the number of held PCBs
+    }
+    return expired; // Return the expired chain (linked through next)
+}
@@ -0,0 +1,32 @@
+//
+// Hierarchical timing wheel holding in-flight I/O PCBs keyed by completion tick
+//
+#ifndef TIMING_WHEEL_H // If not defined, define TIMING_WHEEL_H to prevent multiple inclusions
+#define TIMING_WHEEL_H // Define TIMING_WHEEL_H
+
+struct PCB; // PCBs are linked into the slots through their next/prev links
+
+#define TW_LEVELS 4 // Number of wheel levels
+#define TW_SLOT_BITS 6 // Bits of the tick consumed by each level
+#define TW_SLOTS (1 << TW_SLOT_BITS) // Number of slots per level
+#define TW_SLOT_MASK (TW_SLOTS - 1) // Mask selecting a slot index within a level
+#define TW_RANGE (1L << (TW_LEVELS * TW_SLOT_BITS)) // Ticks covered by the whole wheel
+
+// Define the TimingWheelSlot structure (FIFO list of PCBs linked through next/prev)
+typedef struct TimingWheelSlot {
+    struct PCB *head; // Pointer to the first PCB in the slot
+    struct PCB *tail; // Pointer to the last PCB in the slot
+} TimingWheelSlot;
+
+// Define the TimingWheel structure
+typedef struct TimingWheel {
+    TimingWheelSlot slots[TW_LEVELS][TW_SLOTS]; // Slots for every level
+    long now; // Current tick of the wheel
+    int count; // Number of PCBs held by the wheel
+} TimingWheel;
+
+void tw_init(TimingWheel *wheel, long start_tick); // Function prototype for initializing an empty wheel
+void tw_insert(TimingWheel *wheel, struct PCB *pcb, long expire_tick); // Function prototype for inserting a PCB due at expire_tick
+struct PCB *tw_advance(TimingWheel *wheel); // Function prototype for advancing one tick and returning the expired chain
+
+#endif // TIMING_WHEEL_H // End of include guard
@@ -0,0 +1,284 @@
+//
+// Trace line parsing and parallel pre-parsing of trace files
+//
+#include "trace.h" // Include the trace header file
+#include "scheduler.h" // Include the scheduler header file for the PCB
+#include <fcntl.h> // Include open
+#include <sys/mman.h> // Include mmap
+#include <sys/stat.h> // Include fstat
+
+#define TRACE_CHUNK_MIN (64 * 1024) // Smallest chunk handed to a worker
+#define TRACE_CHUNK_MAX (4 * 1024 * 1024) // Largest chunk handed to a worker
+#define TRACE_CHUNKS_PER_THREAD 2 // Chunks each worker may parse ahead of the reader
+
+// Parse a proc line into a new PCB and note its optional trailing "group <name>" (NULL if the line is malformed)
+static PCB *parse_proc(char *line, TraceEvent *event) {
+    int priority = 0, burst_count = 0; // Priority and number of bursts
+    if (sscanf(line, "proc %d %d", &priority, &burst_count) != 2 || burst_count <= 0 || burst_count > TRACE_LINE_MAX / 2 || burst_count > PCB_BURSTS_MAX ||
+        priority < PCB_PRIORITY_MIN || priority > PCB_PRIORITY_MAX) { // Parse the priority and burst count (a line holds at most TRACE_LINE_MAX / 2 bursts)
+        return NULL; // Malformed line
+    }
+    sim_time_t bursts[TRACE_LINE_MAX / 2]; // Bursts of the line
+    unsigned char writes[TRACE_LINE_MAX / 16] = {0}; // Bitmap of the I/O bursts marked as writes
+    char *save = NULL; // strtok_r state (workers parse concurrently)
+    char *token = strtok_r(line + 4, " \t\r\n", &save); // Skip past the priority token
+    token = strtok_r(NULL, " \t\r\n", &save); // Skip past the burst count token
+    int parsed = 0; // Number of bursts parsed
+    while (parsed < burst_count && (token = strtok_r(NULL, " \t\r\n", &save)) != NULL) { // Loop through each burst
+        if (token[0] == 'w' && parsed % 2 == 1) { // If an I/O burst is marked as a write
+            writes[parsed >> 3] |= 1 << (parsed & 7); // Mark the burst
+            token++; // Parse the length after the marker
+        }
+        if (sim_time_parse(token, &bursts[parsed]) != 0) { // Convert token (with optional unit suffix) to ticks
+            break; // Stop at the first malformed burst
+        }
+        parsed++; // Count the parsed burst
+    }
+    if (parsed != burst_count) { // If the line has missing or malformed bursts
+        return NULL;
+    }
+    if ((token = strtok_r(NULL, " \t\r\n", &save)) != NULL && strcmp(token, "group") == 0) { // If the process names its group
+        if ((token = strtok_r(NULL, " \t\r\n", &save)) == NULL) { // The name is missing
+            return NULL;
+        }
+        event->group = event->text + (token - line); // Point into the original line (the copy is gone once parsing returns)
+        event->group_length = (int)strlen(token);
+    }
+    PCB *pcb = pcb_alloc(); // Allocate a zeroed PCB
+    if (pcb == NULL || pcb_set_bursts(pcb, bursts, writes, burst_count) != 0) { // Store the bursts
+        pcb_free(pcb); // Free the PCB memory
+        return NULL;
+    }
+    pcb->priority = priority; // Set the priority
+    return pcb; // Arrival and ready times are set when the reader admits it
+}
+
+// Parse one trace line (without needing a terminating NUL) into an event
+TraceEventKind trace_parse_line(const char *line, size_t length, TraceEvent *event) {
+    char buffer[TRACE_LINE_MAX]; // Writable, NUL-terminated copy of the line
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) { // Drop the line terminator
+        length--;
+    }
+    event->pcb = NULL; // No process unless this is a proc line
+    event->sleep_time = 0; // No sleep unless this is a sleep line
+    event->policy = NULL; // No switch unless this is a policy line
+    event->quantum = 0;
+    event->text = line; // Keep the line for diagnostics
+    event->text_length = (int)length;
+    event->group = NULL; // No group unless the proc line names one
+    event->group_length = 0;
+    if (length >= sizeof(buffer)) { // If the line is too long to be a valid command
+        return event->kind = TRACE_MALFORMED;
+    }
+    memcpy(buffer, line, length); // Copy the line
+    buffer[length] = '\0'; // Terminate the copy
+
+    if (strncmp(buffer, "proc", 4) == 0) { // If the line starts with "proc"
+        event->pcb = parse_proc(buffer, event); // Build the PCB
+        return event->kind = event->pcb ? TRACE_PROC : TRACE_MALFORMED;
+    } else if (strncmp(buffer, "sleep", 5) == 0) { // If the line starts with "sleep"
+        if (sim_time_parse(buffer + 5 + strspn(buffer + 5, " \t"), &event->sleep_time) != 0) { // Parse the sleep time
+            return event->kind = TRACE_MALFORMED;
+        }
+        return event->kind = TRACE_SLEEP;
+    } else if (strncmp(buffer, "stop", 4) == 0) { // If the line starts with "stop"
+        return event->kind = TRACE_STOP;
+    } else if (strncmp(buffer, "policy", 6) == 0) { // If the line starts with "policy"
+        char *save = NULL; // strtok_r state (workers parse concurrently)
+        char *name = strtok_r(buffer + 6, " \t\r\n", &save); // Name of the policy
+        char *quantum = name ? strtok_r(NULL, " \t\r\n", &save) : NULL; // Optional RR quantum
+        if (!(event->policy = policy_find(name)) || (quantum && (sim_time_parse(quantum, &event->quantum) != 0 || event->quantum <= 0))) { // Look them up
+            return event->kind = TRACE_MALFORMED;
+        }
+        return event->kind = TRACE_POLICY;
+    }
+    return event->kind = TRACE_UNKNOWN; // Unrecognized line
+}
+
+// Parse every line of a claimed chunk
+static void parse_chunk(TraceReader *reader, TraceChunk *chunk) {
+    size_t offset = chunk->start; // Start of the current line
+    while (offset < chunk->end) { // Loop through each line
+        const char *line = reader->map + offset; // Current line
+        const char *newline = memchr(line, '\n', chunk->end - offset); // End of the line
+        size_t length = newline ? (size_t)(newline - line) + 1 : chunk->end - offset; // Length including the newline
+        if (chunk->count == chunk->capacity) { // If the event array is full
+            int capacity = chunk->capacity ? chunk->capacity * 2 : 256; // Double it
+            TraceEvent *events = realloc(chunk->events, capacity * sizeof(TraceEvent)); // Grow the array
+            if (events == NULL) { // If memory allocation fails
+                perror("Failed to allocate memory for trace events"); // Print an error message
+                break; // Drop the rest of the chunk
+            }
+            chunk->events = events;
+            chunk->capacity = capacity;
+        }
+        TraceEvent *event = &chunk->events[chunk->count++]; // Next event slot
+        trace_parse_line(line, length, event); // Parse the line
+        offset += length; // Move past the line
+        event->end_offset = (long)offset; // Where a resume would continue
+    }
+}
+
+// Parser thread: claim chunks in file order, at most window ahead of the reader
+static void *trace_worker(void *arg) {
+    TraceReader *reader = (TraceReader *)arg; // Get the reader from the argument
+    pthread_mutex_lock(&reader->mutex); // Lock the claim counters
+    while (1) { // Infinite loop
+        while (!reader->closing && reader->next_start < reader->size &&
+               reader->claimed >= reader->released + reader->window) { // Wait while the reader is a full window behind
+            pthread_cond_wait(&reader->cond, &reader->mutex); // Wait for a condition signal
+        }
+        if (reader->closing || reader->next_start >= reader->size) { // If there is nothing left to claim
+            break; // Exit the loop
+        }
+        TraceChunk *chunk = &reader->ring[reader->claimed % reader->window]; // Slot of the next chunk
+        chunk->start = reader->next_start; // The chunk starts where the previous one ended
+        chunk->end = chunk->start + reader->chunk_size; // Tentative end
+        if (chunk->end >= reader->size) { // If the chunk reaches the end of the file
+            chunk->end = reader->size; // Take the rest of the file
+        } else {
+            const char *newline = memchr(reader->map + chunk->end, '\n', reader->size - chunk->end); // Finish the line in progress
+            chunk->end = newline ? (size_t)(newline - reader->map) + 1 : reader->size; // Split just past the newline
+        }
+        chunk->count = 0; // The slot was emptied by the reader
+        chunk->ready = 0; // Not parsed yet
+        reader->next_start = chunk->end; // The next chunk starts here
+        reader->claimed++; // Count the claim
+        pthread_mutex_unlock(&reader->mutex); // Parse without holding the lock
+
+        parse_chunk(reader, chunk); // Parse the chunk
+
+        pthread_mutex_lock(&reader->mutex); // Lock the claim counters
+        chunk->ready = 1; // Hand the chunk to the reader
+        pthread_cond_broadcast(&reader->cond); // Wake the reader
+    }
+    pthread_mutex_unlock(&reader->mutex); // Unlock the claim counters
+    return NULL;
+}
+
+// Map a trace and start parsing it from start_offset on a pool of threads
+TraceReader *trace_reader_open(const char *path, long start_offset, int threads) {
+    int fd = open(path, O_RDONLY); // Open the file for reading
+    if (fd < 0) { // If the file cannot be opened
+        perror("Failed to open input file"); // Print an error message
+        return NULL;
+    }
+    struct stat st; // File status
+    if (fstat(fd, &st) != 0) { // Read the file size
+        perror("Failed to stat input file"); // Print an error message
+        close(fd); // Close the file
+        return NULL;
+    }
+    TraceReader *reader = calloc(1, sizeof(TraceReader)); // Allocate the reader
+    if (reader == NULL) { // If memory allocation fails
+        perror("Failed to allocate memory for trace reader"); // Print an error message
+        close(fd); // Close the file
+        return NULL;
+    }
+    reader->size = (size_t)st.st_size; // Size of the file
+    if (reader->size > 0) { // An empty file has nothing to map
+        void *map = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0); // Map the whole file
+        if (map == MAP_FAILED) { // If the file cannot be mapped
+            perror("Failed to map input file"); // Print an error message
+            close(fd); // Close the file
+            free(reader); // Free the reader
+            return NULL;
+        }
+        madvise(map, reader->size, MADV_SEQUENTIAL); // The file is read front to back
+        reader->map = map;
+    }
+    close(fd); // The mapping keeps the file alive
+
+    reader->next_start = start_offset <= 0 ? 0 : (size_t)start_offset < reader->size ? (size_t)start_offset : reader->size; // Skip already replayed lines
+    reader->threads = threads > 0 ? threads : 1; // At least one parser
+    reader->window = reader->threads * TRACE_CHUNKS_PER_THREAD; // Bound the events held in memory
+    reader->chunk_size = (reader->size - reader->next_start) / ((size_t)reader->threads * 8); // Several chunks per thread
+    if (reader->chunk_size < TRACE_CHUNK_MIN) {
+        reader->chunk_size = TRACE_CHUNK_MIN;
+    } else if (reader->chunk_size > TRACE_CHUNK_MAX) {
+        reader->chunk_size = TRACE_CHUNK_MAX;
+    }
+    reader->ring = calloc(reader->window, sizeof(TraceChunk)); // Allocate the chunk slots
+    reader->workers = calloc(reader->threads, sizeof(pthread_t)); // Allocate the thread handles
+    if (reader->ring == NULL || reader->workers == NULL) { // If memory allocation fails
+        perror("Failed to allocate memory for trace reader"); // Print an error message
+        free(reader->ring);
+        free(reader->workers);
+        if (reader->map) {
+            munmap((void *)reader->map, reader->size); // Unmap the file
+        }
+        free(reader);
+        return NULL;
+    }
+    pthread_mutex_init(&reader->mutex, NULL); // Initialize the reader mutex
+    pthread_cond_init(&reader->cond, NULL); // Initialize the reader condition variable
+    for (int i = 0; i < reader->threads; i++) { // Loop through each parser
+        int error = pthread_create(&reader->workers[i], NULL, trace_worker, reader); // Create parser thread
+        if (error != 0) { // If it did not start
+            fprintf(stderr, "Failed to start trace parser threads: %s\n", strerror(error)); // Print an error message
+            reader->threads = i; // Close joins only the parsers that started
+            trace_reader_close(reader); // Stop them and release the reader
+            return NULL;
+        }
+    }
+    return reader; // Return the running reader
+}
+
+// Wait for the next chunk in file order (NULL once the whole file was replayed)
+TraceChunk *trace_reader_next(TraceReader *reader) {
+    TraceChunk *chunk = &reader->ring[reader->released % reader->window]; // Slot of the next chunk
+    pthread_mutex_lock(&reader->mutex); // Lock the claim counters
+    while (!(reader->released < reader->claimed && chunk->ready)) { // Wait until the next chunk is parsed
+        if (reader->released == reader->claimed && reader->next_start >= reader->size) { // If every chunk was replayed
+            pthread_mutex_unlock(&reader->mutex); // Unlock the claim counters
+            return NULL; // End of the trace
+        }
+        pthread_cond_wait(&reader->cond, &reader->mutex); // Wait for a condition signal
+    }
+    pthread_mutex_unlock(&reader->mutex); // Unlock the claim counters
+    return chunk; // Return the parsed chunk
+}
+
+// Free the PCBs of events the reader did not consume
+static void free_chunk_pcbs(TraceChunk *chunk) {
+    for (int i = 0; i < chunk->count; i++) { // Loop through each event
+        if (chunk->events[i].pcb) { // If the PCB was never admitted
+            pcb_free(chunk->events[i].pcb); // Free the PCB
+            chunk->events[i].pcb = NULL;
+        }
+    }
+    chunk->count = 0; // The slot is empty
+}
+
+// Hand a replayed chunk's slot back to the parsers
+void trace_reader_release(TraceReader *reader, TraceChunk *chunk) {
+    free_chunk_pcbs(chunk); // Drop anything the reader skipped
+    pthread_mutex_lock(&reader->mutex); // Lock the claim counters
+    chunk->ready = 0; // The slot is free
+    reader->released++; // Count the release
+    pthread_cond_broadcast(&reader->cond); // Let a parser claim the slot
+    pthread_mutex_unlock(&reader->mutex); // Unlock the claim counters
+}
+
+// Stop the parsers, free PCBs parsed ahead of the reader and unmap the file
+void trace_reader_close(TraceReader *reader) {
+    pthread_mutex_lock(&reader->mutex); // Lock the claim counters
+    reader->closing = 1; // Ask the parsers to stop claiming
+    pthread_cond_broadcast(&reader->cond); // Wake parsers waiting for a slot
+    pthread_mutex_unlock(&reader->mutex); // Unlock the claim counters
+    for (int i = 0; i < reader->threads; i++) { // Loop through each parser
+        pthread_join(reader->workers[i], NULL); // Wait for the parser to finish its chunk
+    }
+    for (int i = 0; i < reader->window; i++) { // Loop through each slot
+        free_chunk_pcbs(&reader->ring[i]); // Free PCBs that were parsed ahead
+        free(reader->ring[i].events); // Free the event array
+    }
+    if (reader->map) {
+        munmap((void *)reader->map, reader->size); // Unmap the file
+    }
+    pthread_mutex_destroy(&reader->mutex); // Destroy the reader mutex
+    pthread_cond_destroy(&reader->cond); // Destroy the reader condition variable
+    free(reader->ring); // Free the chunk slots
+    free(reader->workers); // Free the thread handles
+    free(reader); // Free the reader
+}
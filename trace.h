@@ -0,0 +1,73 @@
+//
+// Trace line parsing and parallel pre-parsing of trace files
+//
+#ifndef TRACE_H // If not defined, define TRACE_H to prevent multiple inclusions
+#define TRACE_H // Define TRACE_H
+
+#include <stddef.h> // Include size_t
+#include <pthread.h> // Include pthread library for threading
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+
+#define TRACE_LINE_MAX 4096 // Longest trace line accepted (including the newline)
+
+struct PCB; // proc events carry a freshly allocated PCB
+struct SchedPolicy; // policy events carry the policy to switch to
+
+// Kinds of trace lines
+typedef enum TraceEventKind {
+    TRACE_PROC, // proc line: a new process arrives
+    TRACE_SLEEP, // sleep line: the trace time advances
+    TRACE_STOP, // stop line: the trace ends
+    TRACE_POLICY, // policy line: the CPU scheduling policy (and RR quantum) changes
+    TRACE_MALFORMED, // proc, sleep or policy line that could not be parsed
+    TRACE_UNKNOWN // Any other line
+} TraceEventKind;
+
+// Define the TraceEvent structure (one parsed trace line)
+typedef struct TraceEvent {
+    TraceEventKind kind; // Kind of line
+    struct PCB *pcb; // New process (TRACE_PROC; NULL once the reader took ownership)
+    sim_time_t sleep_time; // Time the trace advances (TRACE_SLEEP)
+    const struct SchedPolicy *policy; // Policy to switch to (TRACE_POLICY)
+    sim_time_t quantum; // New RR quantum (TRACE_POLICY; 0 = keep the current one)
+    long end_offset; // File offset just past the line (where a resume continues)
+    const char *text; // Start of the line, for diagnostics (not NUL-terminated)
+    int text_length; // Length of the line without the newline
+    const char *group; // Fair-share group named by a proc line, within text (NULL = none)
+    int group_length; // Length of the group name
+} TraceEvent;
+
+// Define the TraceChunk structure (events of a run of whole lines, in file order)
+typedef struct TraceChunk {
+    size_t start; // Offset of the first byte of the chunk
+    size_t end; // Offset just past the last byte of the chunk
+    TraceEvent *events; // Parsed events
+    int count; // Number of events
+    int capacity; // Number of events the array can hold
+    int ready; // Set once a worker finished parsing the chunk
+} TraceChunk;
+
+// Define the TraceReader structure (a memory-mapped trace parsed ahead by a thread pool)
+typedef struct TraceReader {
+    const char *map; // Mapping of the whole file
+    size_t size; // Size of the file
+    size_t chunk_size; // Target bytes per chunk (rounded up to the next newline)
+    size_t next_start; // Offset of the first byte not yet claimed by a worker
+    long claimed; // Number of chunks claimed by workers
+    long released; // Number of chunks replayed and released by the reader
+    int window; // Chunks that may be parsed ahead of the reader
+    TraceChunk *ring; // Chunk slots, indexed by chunk number modulo window
+    pthread_t *workers; // Parser threads
+    int threads; // Number of parser threads
+    int closing; // Set to stop the workers early
+    pthread_mutex_t mutex; // Mutex protecting the claim and release counters
+    pthread_cond_t cond; // Condition variable for chunk hand-off in both directions
+} TraceReader;
+
+TraceEventKind trace_parse_line(const char *line, size_t length, TraceEvent *event); // Function prototype for parsing one trace line
+TraceReader *trace_reader_open(const char *path, long start_offset, int threads); // Function prototype for mapping a trace and starting its parser threads
+TraceChunk *trace_reader_next(TraceReader *reader); // Function prototype for waiting for the next chunk in file order (NULL at the end)
+void trace_reader_release(TraceReader *reader, TraceChunk *chunk); // Function prototype for handing a replayed chunk back to the pool
+void trace_reader_close(TraceReader *reader); // Function prototype for stopping the parsers and freeing unreplayed PCBs
+
+#endif // TRACE_H // End of include guard
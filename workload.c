@@ -0,0 +1,311 @@
+//
+// Immutable parsed workload images: a trace parsed once into a read-only arena that any number of runs replay
+//
+#include "workload.h" // Include the workload header file
+#include "scheduler.h" // Include the scheduler header file for the PCB and policies
+#include <fcntl.h> // Include open
+#include <sys/mman.h> // Include mmap
+#include <sys/stat.h> // Include fstat
+
+// Define the WorkloadBuilder structure (growing sections while a text trace is parsed)
+typedef struct WorkloadBuilder {
+    WorkloadRecord *records; // Records so far
+    size_t record_count, record_capacity;
+    sim_time_t *bursts; // Bursts so far
+    size_t burst_count, burst_capacity;
+    unsigned char *bytes; // Byte pool so far
+    size_t byte_count, byte_capacity;
+    int64_t processes; // Proc records so far
+} WorkloadBuilder;
+
+// Make room for count more elements in a growing section (capacity doubles)
+static int builder_reserve(void **array, size_t *capacity, size_t used, size_t count, size_t element) {
+    if (used + count <= *capacity) { // If they fit already
+        return 0;
+    }
+    size_t grown = *capacity ? *capacity : 256; // New capacity
+    while (grown < used + count) { // Double until they fit
+        grown *= 2;
+    }
+    void *larger = realloc(*array, grown * element); // Grow the section
+    if (!larger) { // If the allocation failed
+        perror("Failed to allocate memory for workload image"); // Print an error message
+        return -1;
+    }
+    *array = larger;
+    *capacity = grown;
+    return 0;
+}
+
+// Append bytes to the byte pool; returns their offset (-1 on failure)
+static int64_t builder_bytes(WorkloadBuilder *builder, const void *data, size_t length) {
+    if (builder_reserve((void **)&builder->bytes, &builder->byte_capacity, builder->byte_count, length, 1) != 0) { // Make room
+        return -1;
+    }
+    memcpy(builder->bytes + builder->byte_count, data, length); // Copy the bytes
+    builder->byte_count += length;
+    return (int64_t)(builder->byte_count - length); // Offset of the copy
+}
+
+// Append a name to the byte pool, NUL-terminated; returns its offset (-1 on failure)
+static int64_t builder_name(WorkloadBuilder *builder, const char *name, size_t length) {
+    int64_t offset = builder_bytes(builder, name, length); // Copy the name
+    return offset >= 0 && builder_bytes(builder, "", 1) >= 0 ? offset : -1; // Terminate it
+}
+
+// Turn one parsed trace line into a record (takes ownership of the event's PCB)
+static int builder_add(WorkloadBuilder *builder, TraceEvent *event) {
+    static __thread sim_time_t bursts[TRACE_LINE_MAX / 2]; // Bursts of the process (a trace line holds fewer)
+    static __thread unsigned char writes[TRACE_LINE_MAX / 16]; // Write bitmap of the process
+    if (builder_reserve((void **)&builder->records, &builder->record_capacity, builder->record_count, 1, sizeof(WorkloadRecord)) != 0) { // Make room
+        pcb_free(event->pcb); // Drop the parsed process
+        return -1;
+    }
+    WorkloadRecord *record = &builder->records[builder->record_count]; // Record of the line
+    *record = (WorkloadRecord){event->kind, 0, 0, 0, 0, -1, -1, -1}; // No bursts, names or text unless set below
+    int rc = 0; // Status of the byte pool appends
+    int keep_text = event->kind != TRACE_SLEEP && event->kind != TRACE_STOP && (event->kind != TRACE_PROC || event->group); // Lines a diagnostic may quote
+    if (keep_text && (record->text = builder_bytes(builder, event->text, event->text_length)) < 0) { // Keep the line
+        rc = -1;
+    }
+    record->text_length = keep_text ? event->text_length : 0;
+    if (event->kind == TRACE_PROC) { // A new process arrives
+        PCB *pcb = event->pcb; // Parsed process
+        pcb_get_bursts(pcb, bursts, writes); // Decode its bursts
+        record->priority = pcb->priority;
+        record->burst_count = pcb->burst_count;
+        record->value = (int64_t)builder->burst_count; // Its bursts start here
+        if (rc == 0 && builder_reserve((void **)&builder->bursts, &builder->burst_capacity, builder->burst_count, pcb->burst_count, sizeof(sim_time_t)) == 0) { // Make room
+            memcpy(builder->bursts + builder->burst_count, bursts, pcb->burst_count * sizeof(sim_time_t)); // Copy them
+            builder->burst_count += pcb->burst_count;
+        } else {
+            rc = -1;
+        }
+        int any_write = 0; // Whether any burst is a write
+        for (int i = 0; i < (pcb->burst_count + 7) / 8; i++) { // Loop through the bitmap
+            any_write |= writes[i];
+        }
+        if (rc == 0 && any_write && (record->writes = builder_bytes(builder, writes, (pcb->burst_count + 7) / 8)) < 0) { // Keep the bitmap
+            rc = -1;
+        }
+        if (rc == 0 && event->group && (record->name = builder_name(builder, event->group, event->group_length)) < 0) { // Keep the group name
+            rc = -1;
+        }
+        builder->processes++; // Count the process
+        pcb_free(pcb); // Runs get PCBs of their own
+        event->pcb = NULL;
+    } else if (event->kind == TRACE_SLEEP) { // The trace time advances
+        record->value = event->sleep_time;
+    } else if (event->kind == TRACE_POLICY) { // The policy changes
+        record->value = event->quantum;
+        if (rc == 0 && (record->name = builder_name(builder, event->policy->name, strlen(event->policy->name))) < 0) { // Keep the policy name
+            rc = -1;
+        }
+    }
+    builder->record_count++; // Count the record
+    return rc; // Return the status
+}
+
+// Point the sections of a workload into an arena and check every record stays inside it
+static int workload_attach(Workload *workload, void *base, size_t size) {
+    const WorkloadHeader *header = base; // Header of the arena
+    if (size < sizeof(WorkloadHeader) || memcmp(header->magic, WORKLOAD_MAGIC, 4) != 0 || header->version != WORKLOAD_VERSION ||
+        header->ticks_per_us != SIM_TIME_PER_US || header->record_count < 0 || header->burst_count < 0 || header->byte_count < 0 ||
+        header->record_count > (int64_t)(size / sizeof(WorkloadRecord)) || header->burst_count > (int64_t)(size / sizeof(sim_time_t)) || header->byte_count > (int64_t)size) { // Check the header
+        return -1;
+    }
+    size_t records = sizeof(WorkloadHeader) + header->record_count * sizeof(WorkloadRecord); // End of the record section
+    size_t bursts = records + header->burst_count * sizeof(sim_time_t); // End of the burst section
+    if (bursts + header->byte_count > size || bursts < records) { // If the sections do not fit
+        return -1;
+    }
+    workload->header = header;
+    workload->records = (const WorkloadRecord *)((const char *)base + sizeof(WorkloadHeader));
+    workload->bursts = (const sim_time_t *)((const char *)base + records);
+    workload->bytes = (const unsigned char *)base + bursts;
+    workload->base = base;
+    workload->size = size;
+    for (int64_t i = 0; i < header->record_count; i++) { // Loop through each record
+        const WorkloadRecord *record = &workload->records[i]; // Record to check
+        int64_t bytes = header->byte_count; // Size of the byte pool
+        if (record->burst_count < 0 || record->text_length < 0 || (record->kind == TRACE_PROC && (record->burst_count == 0 || record->burst_count > TRACE_LINE_MAX / 2 || record->value < 0 || record->value > header->burst_count - record->burst_count)) ||
+            (record->writes >= 0 && record->writes > bytes - (record->burst_count + 7) / 8) || (record->text >= 0 && record->text > bytes - record->text_length) ||
+            (record->name >= 0 && (record->name >= bytes || memchr(workload->bytes + record->name, '\0', bytes - record->name) == NULL))) { // If anything points outside the arena or has more bursts than a trace line (the decode buffers hold TRACE_LINE_MAX / 2)
+            return -1;
+        }
+        if (record->kind == TRACE_PROC && (record->priority < PCB_PRIORITY_MIN || record->priority > PCB_PRIORITY_MAX || record->burst_count > PCB_BURSTS_MAX)) { // If the process does not fit a PCB of this build (as a trace line or snapshot is checked)
+            return -1;
+        }
+        if (record->kind == TRACE_SLEEP && record->value < 0) { // If the trace time would go backwards
+            return -1;
+        }
+    }
+    for (int64_t i = 0; i < header->burst_count; i++) { // Loop through each burst
+        if (workload->bursts[i] < 0) { // If a burst has a negative length
+            return -1;
+        }
+    }
+    return 0; // Success
+}
+
+// Parse a text trace into a new arena, then make the arena read-only
+static Workload *workload_build(Workload *workload, const char *path) {
+    FILE *file = fopen(path, "r"); // Open the file for reading
+    if (!file) { // If the file cannot be opened
+        perror("Failed to open input file"); // Print an error message
+        return NULL;
+    }
+    WorkloadBuilder builder = {0}; // Growing sections
+    char line[TRACE_LINE_MAX]; // Buffer to store each line of the file
+    int rc = 0; // Status of the build
+    while (rc == 0 && fgets(line, sizeof(line), file)) { // Read each line of the file
+        TraceEvent event; // Parsed line
+        TraceEventKind kind = trace_parse_line(line, strlen(line), &event); // Parse the line
+        rc = builder_add(&builder, &event); // Record it
+        if (kind == TRACE_STOP) { // Nothing after stop is replayed
+            break;
+        }
+    }
+    fclose(file); // Close the file
+    size_t size = sizeof(WorkloadHeader) + builder.record_count * sizeof(WorkloadRecord) + builder.burst_count * sizeof(sim_time_t) + builder.byte_count; // Size of the arena
+    char *base = rc == 0 ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) : MAP_FAILED; // Page-aligned arena
+    if (base != MAP_FAILED) { // If the arena was allocated
+        WorkloadHeader header = {WORKLOAD_MAGIC, WORKLOAD_VERSION, SIM_TIME_PER_US, builder.record_count, builder.burst_count, builder.byte_count, builder.processes}; // Header of the image
+        memcpy(base, &header, sizeof(header)); // Lay the sections out back to back
+        size_t offset = sizeof(header); // Write position
+        memcpy(base + offset, builder.records, builder.record_count * sizeof(WorkloadRecord));
+        offset += builder.record_count * sizeof(WorkloadRecord);
+        memcpy(base + offset, builder.bursts, builder.burst_count * sizeof(sim_time_t));
+        offset += builder.burst_count * sizeof(sim_time_t);
+        memcpy(base + offset, builder.bytes, builder.byte_count);
+        mprotect(base, size, PROT_READ); // Runs can only read it
+    } else if (rc == 0) { // If only the arena failed
+        perror("Failed to allocate memory for workload image"); // Print an error message
+    }
+    free(builder.records); // Free the growing sections
+    free(builder.bursts);
+    free(builder.bytes);
+    if (base == MAP_FAILED) { // If the build failed
+        return NULL;
+    }
+    workload_attach(workload, base, size); // Point the sections into the arena (built images are always valid)
+    return workload; // Return the image
+}
+
+// Check whether a file starts with the magic bytes of a saved image
+int workload_is_image(const char *path) {
+    char magic[4] = {0}; // First bytes of the file
+    FILE *file = fopen(path, "rb"); // Open the file for reading
+    if (!file) { // If the file cannot be opened
+        return 0; // Let the trace reader report it
+    }
+    int image = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, WORKLOAD_MAGIC, 4) == 0; // Compare the magic bytes
+    fclose(file); // Close the file
+    return image;
+}
+
+// Map a saved image (detected by its magic bytes), or parse a text trace into a new one
+Workload *workload_open(const char *path) {
+    Workload *workload = calloc(1, sizeof(Workload)); // The image
+    if (!workload) { // If the allocation failed
+        perror("Failed to allocate memory for workload image"); // Print an error message
+        return NULL;
+    }
+    int fd = open(path, O_RDONLY); // Open the file
+    char magic[4] = {0}; // First bytes of the file
+    struct stat info; // Size of the file
+    if (fd >= 0 && read(fd, magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, WORKLOAD_MAGIC, 4) == 0 && fstat(fd, &info) == 0) { // If it is a saved image
+        void *base = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0); // Share the file's pages with every other run mapping it
+        close(fd); // The mapping stays valid
+        if (base == MAP_FAILED || workload_attach(workload, base, info.st_size) != 0) { // If it is unusable
+            fprintf(stderr, "Workload image %s is truncated or from an incompatible build\n", path); // Print an error message
+            if (base != MAP_FAILED) {
+                munmap(base, info.st_size);
+            }
+            free(workload);
+            return NULL;
+        }
+        workload->mapped = 1; // Unmapped, not freed
+        return workload; // Return the image
+    }
+    if (fd >= 0) { // If it is a text trace
+        close(fd);
+    }
+    if (!workload_build(workload, path)) { // Parse it
+        free(workload);
+        return NULL;
+    }
+    return workload; // Return the image
+}
+
+// Write an image next to the target and rename it into place
+int workload_save(const Workload *workload, const char *path) {
+    char tmp_path[4096]; // Image is written next to the target and renamed into place
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path); // Build the temporary file name
+    FILE *file = fopen(tmp_path, "wb"); // Open the temporary file for writing
+    if (!file) { // If the file cannot be opened
+        perror("Failed to open workload image"); // Print an error message
+        return -1; // Report the failure
+    }
+    int rc = fwrite(workload->base, workload->size, 1, file) == 1 ? 0 : -1; // The arena is position-independent
+    if (fclose(file) != 0) { // Flush and close the file
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp_path, path) != 0) { // Atomically replace the previous image
+        rc = -1;
+    }
+    if (rc != 0) { // If anything went wrong
+        fprintf(stderr, "Failed to write workload image %s\n", path); // Print an error message
+        remove(tmp_path); // Drop the partial image
+    }
+    return rc; // Return the status
+}
+
+// Unmap an image (every run replaying it must have finished)
+void workload_close(Workload *workload) {
+    if (!workload) { // If there is nothing to release
+        return;
+    }
+    munmap(workload->base, workload->size); // Release the arena
+    free(workload); // Free the handle
+}
+
+// Replay one record as the trace event its line parsed to; proc events get a fresh PCB that borrows the image's bursts
+TraceEventKind workload_event(const Workload *workload, long index, TraceEvent *event) {
+    memset(event, 0, sizeof(*event)); // No PCB, sleep, policy or group unless set below
+    event->text = ""; // Lines are only kept where a diagnostic may quote them
+    if (index < 0 || index >= workload->header->record_count) { // Past the last record
+        return event->kind = TRACE_STOP;
+    }
+    const WorkloadRecord *record = &workload->records[index]; // Record to replay
+    if (record->text >= 0) { // If the line was kept
+        event->text = (const char *)workload->bytes + record->text;
+        event->text_length = record->text_length;
+    }
+    const char *name = record->name >= 0 ? (const char *)workload->bytes + record->name : NULL; // Group or policy name
+    switch (record->kind) {
+    case TRACE_PROC: { // A new process arrives
+        PCB *pcb = pcb_alloc(); // Only the mutable state is per run
+        if (pcb == NULL || pcb_bind_bursts(pcb, workload->bursts + record->value, record->writes >= 0 ? workload->bytes + record->writes : NULL, record->burst_count) != 0) { // Borrow the bursts
+            pcb_free(pcb); // Free the PCB memory
+            return event->kind = TRACE_MALFORMED;
+        }
+        pcb->priority = record->priority; // Set the priority
+        event->pcb = pcb;
+        event->group = name;
+        event->group_length = name ? (int)strlen(name) : 0;
+        return event->kind = TRACE_PROC;
+    }
+    case TRACE_SLEEP: // The trace time advances
+        event->sleep_time = record->value;
+        return event->kind = TRACE_SLEEP;
+    case TRACE_POLICY: // The policy changes
+        event->quantum = record->value;
+        return event->kind = (event->policy = policy_find(name)) ? TRACE_POLICY : TRACE_MALFORMED;
+    case TRACE_STOP:
+    case TRACE_MALFORMED:
+        return event->kind = record->kind;
+    default: // Any other line
+        return event->kind = TRACE_UNKNOWN;
+    }
+}
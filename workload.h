@@ -0,0 +1,55 @@
+//
+// Immutable parsed workload images: a trace parsed once into a read-only arena that any number of runs replay
+//
+#ifndef WORKLOAD_H // If not defined, define WORKLOAD_H to prevent multiple inclusions
+#define WORKLOAD_H // Define WORKLOAD_H
+
+#include <stddef.h> // Include size_t
+#include <stdint.h> // Include fixed-width integer types
+#include "sim_clock.h" // Include the simulation clock header file for sim_time_t
+#include "trace.h" // Include the trace header file for TraceEvent
+
+#define WORKLOAD_MAGIC "SWKL" // Magic bytes at the start of every saved image
+#define WORKLOAD_VERSION 1 // Image format version
+
+// Define the WorkloadHeader structure (first bytes of the arena; sections follow in this order, each 8-byte aligned)
+typedef struct WorkloadHeader {
+    char magic[4]; // WORKLOAD_MAGIC
+    uint32_t version; // WORKLOAD_VERSION
+    int64_t ticks_per_us; // Tick resolution the times are stored in
+    int64_t record_count; // Number of records (trace lines up to and including stop)
+    int64_t burst_count; // Number of bursts in the burst pool
+    int64_t byte_count; // Size of the byte pool (write bitmaps, names and kept lines)
+    int64_t processes; // Number of proc records
+} WorkloadHeader;
+
+// Define the WorkloadRecord structure (one trace line, in file order)
+typedef struct WorkloadRecord {
+    int32_t kind; // TraceEventKind of the line
+    int32_t priority; // Process priority (TRACE_PROC)
+    int32_t burst_count; // Number of bursts (TRACE_PROC)
+    int32_t text_length; // Length of the kept line
+    int64_t value; // First burst in the burst pool (TRACE_PROC), sleep time (TRACE_SLEEP) or quantum (TRACE_POLICY)
+    int64_t writes; // Write bitmap in the byte pool (-1 = every burst is a read)
+    int64_t text; // Line in the byte pool, kept for diagnostics (-1 = not kept)
+    int64_t name; // NUL-terminated group or policy name in the byte pool (-1 = none)
+} WorkloadRecord;
+
+// Define the Workload structure (a mapped or built image; every pointer is read-only)
+typedef struct Workload {
+    const WorkloadHeader *header; // Header of the arena
+    const WorkloadRecord *records; // Records in file order
+    const sim_time_t *bursts; // Bursts of every process, back to back
+    const unsigned char *bytes; // Byte pool
+    void *base; // Start of the arena
+    size_t size; // Size of the arena
+    int mapped; // Set when the arena maps a saved image
+} Workload;
+
+int workload_is_image(const char *path); // Function prototype for checking whether a file is a saved image rather than a text trace
+Workload *workload_open(const char *path); // Function prototype for mapping a saved image, or parsing a text trace into a new one (NULL on failure)
+int workload_save(const Workload *workload, const char *path); // Function prototype for writing an image so later runs can map it
+void workload_close(Workload *workload); // Function prototype for unmapping an image
+TraceEventKind workload_event(const Workload *workload, long index, TraceEvent *event); // Function prototype for replaying one record as a trace event (proc events get a PCB borrowing the image's bursts)
+
+#endif // WORKLOAD_H // End of include guard